@@ -0,0 +1,35 @@
+#!/bin/sh
+# Round trip and load time of binary AST images (`main.exe ast`).
+#
+# First every tests/*.aw program that compiles is written to an image,
+# loaded back through a read-only mapping and checked to dump and compile
+# exactly like the parsed tree. Then a generated program of STATEMENTS
+# declarations and interpolated stdout lines is parsed and checked RUNS
+# times and its image loaded RUNS times.
+#
+# Usage: bench/ast_image.sh [path/to/main.exe] [statements] [runs]
+
+EXE=$(cd "$(dirname "${1:-build/main.exe}")" && pwd)/$(basename "${1:-build/main.exe}")
+STATEMENTS=${2:-20000}
+RUNS=${3:-50}
+TESTS=$(cd "$(dirname "$0")/../tests" && pwd)
+DIR=${TMPDIR:-/tmp}/aw_ast_image_bench
+PROGRAM=$DIR/program.aw
+
+mkdir -p "$DIR" && cd "$DIR" || exit 1
+
+# Programs with deliberate errors have no tree to write
+for file in "$TESTS"/*.aw; do
+    "$EXE" "$file" > /dev/null 2>&1 || continue
+    "$EXE" ast --check -o "$DIR/check.awast" "$file" || exit 1
+done
+
+awk -v n="$STATEMENTS" 'BEGIN {
+    print "new name string = \"AwLang\""
+    for (i = 0; i < n; i++) {
+        printf "new n%d int = %d * 3 + %d\n", i, i, i % 7
+        printf "stdout [{name} line %d: {n%d}]\n", i, i
+    }
+}' > "$PROGRAM"
+
+"$EXE" ast --bench="$RUNS" -o "$DIR/program.awast" "$PROGRAM"
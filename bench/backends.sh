@@ -0,0 +1,40 @@
+#!/bin/sh
+# Output throughput of the bytecode VM against the two executable backends
+# (native assembly and C through the host compiler).
+#
+# The generated program declares a few variables of each type and then
+# prints STATEMENTS interpolated lines, each with a fresh int and float.
+# The C backend compiles each line's text into literal segments. `run`
+# times include parsing.
+#
+# Usage: bench/backends.sh [path/to/main.exe] [statements]
+
+EXE=${1:-build/main.exe}
+STATEMENTS=${2:-20000}
+DIR=${TMPDIR:-/tmp}
+PROGRAM=$DIR/aw_backends_bench.aw
+
+awk -v n="$STATEMENTS" 'BEGIN {
+    print "new name string = \"AwLang\""
+    print "new count int = 1234567"
+    print "new ratio float = 0.125"
+    print "bl ready = true"
+    for (i = 0; i < n; i++) {
+        printf "new n%d int = count + %d\n", i, i
+        printf "new r%d float = ratio * %d.5\n", i, i % 100
+        printf "stdout [line %d: {name} has {n%d} items at {r%d} and ready is {ready}]\n", i, i, i
+    }
+}' > "$PROGRAM"
+
+elapsed() {
+    start=$(date +%s%N)
+    "$@" > /dev/null || exit 1
+    end=$(date +%s%N)
+    echo "$(( (end - start) / 1000000 )) ms"
+}
+
+echo "build native: $(elapsed "$EXE" build -o "$DIR/aw_bench_native" "$PROGRAM")"
+echo "build c:      $(elapsed "$EXE" build --backend=c -o "$DIR/aw_bench_c" "$PROGRAM")"
+echo "run (vm):     $(elapsed "$EXE" run "$PROGRAM")"
+echo "native:       $(elapsed "$DIR/aw_bench_native")"
+echo "c:            $(elapsed "$DIR/aw_bench_c")"
@@ -0,0 +1,67 @@
+#!/bin/sh
+# Request latency of the compile server against starting main.exe per file.
+#
+# A generated program of STATEMENTS declarations and interpolated stdout
+# lines is compiled (bytecode IR returned) three ways:
+#   - process: `main.exe <file>` started for every compile, as without a server
+#   - client:  `main.exe client <file>` started for every compile
+#   - server:  REQUESTS requests from the built-in load generator, over 1 and
+#              CONNECTIONS persistent connections
+# The first two are timed from the shell over 500 runs each.
+#
+# Usage: bench/daemon.sh [path/to/main.exe] [statements] [requests] [connections]
+
+EXE=$(cd "$(dirname "${1:-build/main.exe}")" && pwd)/$(basename "${1:-build/main.exe}")
+STATEMENTS=${2:-200}
+REQUESTS=${3:-20000}
+CONNECTIONS=${4:-4}
+DIR=${TMPDIR:-/tmp}/aw_daemon_bench
+PROGRAM=$DIR/program.aw
+SOCKET=$DIR/server.sock
+RUNS=500
+
+mkdir -p "$DIR" && cd "$DIR" || exit 1
+
+awk -v n="$STATEMENTS" 'BEGIN {
+    print "new name string = \"AwLang\""
+    for (i = 0; i < n; i++) {
+        printf "new n%d int = %d * 3 + %d\n", i, i, i % 7
+        printf "stdout [{name} line %d: {n%d}]\n", i, i
+    }
+}' > "$PROGRAM"
+
+# Prints p50 and p99 of the millisecond timings on stdin
+percentiles() {
+    sort -n | awk '{ t[NR] = $1 } END {
+        p50 = int(NR * 0.50 + 0.999); p99 = int(NR * 0.99 + 0.999)
+        printf "p50 %.3f ms, p99 %.3f ms\n", t[p50] / 1e6, t[p99] / 1e6
+    }'
+}
+
+time_runs() {
+    i=0
+    while [ $i -lt $RUNS ]; do
+        start=$(date +%s%N)
+        "$@" > /dev/null 2>&1
+        end=$(date +%s%N)
+        echo $((end - start))
+        i=$((i + 1))
+    done | percentiles
+}
+
+printf "process  "
+time_runs "$EXE" "$PROGRAM"
+
+"$EXE" serve --socket="$SOCKET" > /dev/null &
+while [ ! -S "$SOCKET" ]; do sleep 0.05; done
+
+printf "client   "
+time_runs "$EXE" client --socket="$SOCKET" --emit=bytecode "$PROGRAM"
+
+for connections in 1 "$CONNECTIONS"; do
+    printf "server   "
+    "$EXE" client --socket="$SOCKET" --emit=bytecode --bench="$REQUESTS" --connections="$connections" "$PROGRAM"
+done
+
+"$EXE" client --socket="$SOCKET" --stop > /dev/null
+wait
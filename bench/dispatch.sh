@@ -0,0 +1,34 @@
+#!/bin/sh
+# Compares the VM's switch and threaded (computed goto) dispatch loops.
+#
+# AwLang has no loops yet, so the "loop" is the driver's --repeat flag: a
+# generated straight-line program of integer and float arithmetic is run
+# REPEAT times by one process, which keeps the time in the dispatch loop
+# rather than in parsing.
+#
+# Usage: bench/dispatch.sh [path/to/main.exe] [statements] [repeat]
+
+EXE=${1:-build/main.exe}
+STATEMENTS=${2:-20000}
+REPEAT=${3:-200}
+PROGRAM=${TMPDIR:-/tmp}/aw_dispatch_bench.aw
+
+awk -v n="$STATEMENTS" 'BEGIN {
+    print "new a int = 3"
+    print "new b int = 7"
+    print "new c float = 0.5"
+    for (i = 0; i < n; i++) {
+        printf "new i%d int = (a * %d + b) %% 97 - a / 2 + b * 3\n", i, i % 50 + 1
+        printf "new f%d float = c * %d.25 + a - b / 4.0\n", i, i % 10
+        printf "bl k%d = i%d < f%d\n", i, i, i
+    }
+    printf "stdout [{i%d} {f%d} {k%d}]\n", n - 1, n - 1, n - 1
+}' > "$PROGRAM"
+
+for dispatch in switch threaded; do
+    printf "%-9s" "$dispatch"
+    start=$(date +%s%N)
+    "$EXE" run --dispatch=$dispatch --repeat="$REPEAT" "$PROGRAM" > /dev/null || exit 1
+    end=$(date +%s%N)
+    echo " $(( (end - start) / 1000000 )) ms"
+done
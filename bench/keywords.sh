@@ -0,0 +1,27 @@
+#!/bin/sh
+# Keyword lookup in the lexer (`main.exe keywords`): the compile-time
+# perfect hash against the std::unordered_map lookups it replaced.
+#
+# The words come from a generated program of 3 * STATEMENTS lines in which
+# a bit under half of the words are keywords. Every word is looked up
+# ROUNDS times with each method.
+#
+# Usage: bench/keywords.sh [path/to/main.exe] [statements] [rounds]
+
+EXE=${1:-build/main.exe}
+STATEMENTS=${2:-100000}
+ROUNDS=${3:-10}
+DIR=${TMPDIR:-/tmp}/aw_keywords_bench
+PROGRAM=$DIR/program.aw
+
+mkdir -p "$DIR" || exit 1
+
+awk -v n="$STATEMENTS" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        printf "new count_%d int = total_%d + offset\n", i, i
+        printf "bl flag_%d = true\n", i
+        printf "stdout [{name_%d} {value}]\n", i
+    }
+}' > "$PROGRAM"
+
+"$EXE" keywords --bench="$ROUNDS" "$PROGRAM"
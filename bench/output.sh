@@ -0,0 +1,37 @@
+#!/bin/sh
+# Throughput of the runtime output layer used by `run` and `run --jit`.
+#
+# The generated program prints STATEMENTS interpolated lines mixing text,
+# ints, floats, bools and strings, and is run REPEAT times by one process
+# (STATEMENTS * REPEAT lines in total, 10M by default). It is compiled with
+# -O0 so every value is formatted at run time instead of being folded into
+# text at compile time.
+#
+# Usage: bench/output.sh [path/to/main.exe] [statements] [repeat]
+
+EXE=${1:-build/main.exe}
+STATEMENTS=${2:-10000}
+REPEAT=${3:-1000}
+PROGRAM=${TMPDIR:-/tmp}/aw_output_bench.aw
+
+awk -v n="$STATEMENTS" 'BEGIN {
+    print "new name string = \"AwLang\""
+    print "new ratio float = 0.125"
+    print "bl ready = true"
+    for (i = 0; i < n; i++) {
+        printf "new n%d int = %d\n", i, i * 7919
+        printf "stdout [line %d: {name} has {n%d} items at {ratio} and ready is {ready}]\n", i, i
+    }
+}' > "$PROGRAM"
+
+LINES=$((STATEMENTS * REPEAT))
+for mode in vm jit; do
+    flag=
+    [ "$mode" = jit ] && flag=--jit
+    printf "%-4s" "$mode"
+    start=$(date +%s%N)
+    "$EXE" run -O0 $flag --repeat="$REPEAT" "$PROGRAM" > /dev/null || exit 1
+    end=$(date +%s%N)
+    ms=$(( (end - start) / 1000000 ))
+    echo " $ms ms, $(( LINES / (ms > 0 ? ms : 1) ))k lines/s"
+done
@@ -34,6 +34,28 @@ int main(int argc, char** argv) {
       "src/ast.cpp",
       "src/error.cpp",
       "src/semantic.cpp",
+      "src/source.cpp",
+      "src/session.cpp",
+      "src/arena.cpp",
+      "src/flat_ast.cpp",
+      "src/interner.cpp",
+      "src/scan.cpp",
+      "src/lines.cpp",
+      "src/ir.cpp",
+      "src/passes.cpp",
+      "src/codegen.cpp",
+      "src/output.cpp",
+      "src/vm.cpp",
+      "src/jit.cpp",
+      "src/native.cpp",
+      "src/native_runtime.cpp",
+      "src/transpiler.cpp",
+      "src/transpiler_runtime.cpp",
+      "src/thread_pool.cpp",
+      "src/server.cpp",
+      "src/cache.cpp",
+      "src/ast_image.cpp",
+      "src/stats.cpp",
       // "src/lexer.cpp"
     };
 
@@ -45,7 +67,7 @@ int main(int argc, char** argv) {
         }
     }
 
-    nob_cmd_append(&cmd, "g++", "-Wall", "-Wextra", "-std=c++20");
+    nob_cmd_append(&cmd, "g++", "-Wall", "-Wextra", "-std=c++20", "-pthread");
 
     for (int i = 0; i < (int)(sizeof(filenames)/sizeof(filenames[0])); i++) {
         nob_cmd_append(&cmd, filenames[i]);
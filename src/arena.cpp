@@ -0,0 +1,56 @@
+#include "arena.hpp"
+#include <cstdlib>
+#include <new>
+
+Arena::Arena(size_t blockSize)
+    : head(nullptr), spare(nullptr), cursor(nullptr), limit(nullptr), blockSize(blockSize) {}
+
+Arena::~Arena() {
+    reset();
+}
+
+void Arena::grow(size_t minSize) {
+    // Oversized requests get a dedicated block so they don't waste the default size
+    size_t size = minSize + sizeof(Block) > blockSize ? minSize + sizeof(Block) : blockSize;
+    Block* block;
+    if (size == blockSize && spare) {
+        block = spare;
+        spare = spare->next;
+    } else {
+        block = static_cast<Block*>(std::malloc(size));
+        if (!block) throw std::bad_alloc();
+    }
+
+    block->next = head;
+    block->size = size;
+    head = block;
+
+    cursor = reinterpret_cast<char*>(block) + sizeof(Block);
+    limit = reinterpret_cast<char*>(block) + size;
+}
+
+void Arena::reset() {
+    rewind();
+    while (spare) {
+        Block* next = spare->next;
+        std::free(spare);
+        spare = next;
+    }
+}
+
+void Arena::rewind() {
+    Block* block = head;
+    while (block) {
+        Block* next = block->next;
+        if (block->size == blockSize) {
+            block->next = spare;
+            spare = block;
+        } else {
+            std::free(block);
+        }
+        block = next;
+    }
+    head = nullptr;
+    cursor = nullptr;
+    limit = nullptr;
+}
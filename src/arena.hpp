@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Bump allocator behind the interned identifier text of a StringInterner and
+// the array storage of the VM. Memory is handed out from large blocks and
+// released all at once by reset(), rewind() or the destructor; nothing placed
+// in it is ever destroyed, so it only holds raw bytes and trivial values.
+class Arena {
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    Block* head;
+    Block* spare;  // default-size blocks kept by rewind() for reuse
+    char* cursor;
+    char* limit;
+    size_t blockSize;
+
+    void grow(size_t minSize);
+
+public:
+    explicit Arena(size_t blockSize = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + (align - 1)) & ~(uintptr_t)(align - 1);
+        if (cursor == nullptr || p + size > reinterpret_cast<uintptr_t>(limit)) {
+            grow(size + align);
+            p = (reinterpret_cast<uintptr_t>(cursor) + (align - 1)) & ~(uintptr_t)(align - 1);
+        }
+        cursor = reinterpret_cast<char*>(p + size);
+        return reinterpret_cast<void*>(p);
+    }
+
+    // Copies `text` into the arena; the view stays valid until reset()
+    std::string_view copyString(std::string_view text) {
+        if (text.empty()) return std::string_view();
+        char* dst = static_cast<char*>(allocate(text.size(), 1));
+        std::memcpy(dst, text.data(), text.size());
+        return std::string_view(dst, text.size());
+    }
+
+    // Frees every block; all pointers handed out become invalid
+    void reset();
+
+    // Like reset(), but keeps the default-size blocks to allocate from
+    // again, so an arena reused for one compilation after another stops
+    // calling malloc once it has grown to the largest one
+    void rewind();
+};
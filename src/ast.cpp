@@ -1,29 +1,47 @@
 #include "ast.hpp"
-#include <iostream>
-#include <sstream>
+#include "flat_ast.hpp"
+#include <charconv>
 
-std::unique_ptr<ProgramNode> ASTParser::parseProgram(Parser& parser) {
-    auto program = std::make_unique<ProgramNode>(1, 1);
+namespace {
+
+// Copies the entries of the innermost list, which start at `mark`, into
+// FlatAST::lists and returns the index of the first one
+uint32_t commitList(Parser& parser, size_t mark) {
+    std::vector<uint32_t>& lists = parser.ast->lists;
+    uint32_t first = (uint32_t)lists.size();
+    lists.insert(lists.end(), parser.listItems.begin() + mark, parser.listItems.end());
+    parser.listItems.resize(mark);
+    return first;
+}
+
+} // namespace
+
+NodeId ASTParser::parseProgram(Parser& parser, FlatAST& ast) {
+    parser.ast = &ast;
+    ast.symbols = parser.lexer.interner;
+    size_t mark = parser.listItems.size();
     
     // Parse statements until EOF
     while (ParserEngine::currentToken(parser) && 
            ParserEngine::currentToken(parser)->type != END_OF_FILE) {
         
-        auto stmt = parseStatement(parser);
-        if (stmt) {
-            program->statements.push_back(std::move(stmt));
+        NodeId stmt = parseStatement(parser);
+        if (stmt != NO_NODE) {
+            parser.listItems.push_back(stmt);
         } else {
             // Better error recovery: skip to next statement boundary
             synchronizeParser(parser);
         }
     }
     
-    return program;
+    uint32_t count = (uint32_t)(parser.listItems.size() - mark);
+    ast.root = ast.addNode(ASTNodeType::PROGRAM, 0, commitList(parser, mark), count);
+    return ast.root;
 }
 
-std::unique_ptr<ASTNode> ASTParser::parseStatement(Parser& parser) {
+NodeId ASTParser::parseStatement(Parser& parser) {
     TokenData* token = ParserEngine::currentToken(parser);
-    if (!token) return nullptr;
+    if (!token) return NO_NODE;
     
     // Skip comments
     while (token && token->type == COMMENT) {
@@ -31,23 +49,19 @@ std::unique_ptr<ASTNode> ASTParser::parseStatement(Parser& parser) {
         token = ParserEngine::currentToken(parser);
     }
     
-    if (!token) return nullptr;
+    if (!token) return NO_NODE;
     
     switch (token->type) {
-        case NEW:
-            // Check if it's array declaration
-            if (ParserEngine::peekToken(parser) && 
-                ParserEngine::peekToken(parser)->type == IDENTIFIER) {
-                // Look ahead further to see if it's array syntax
-                Parser tempParser = parser;
-                ParserEngine::advanceParser(tempParser); // skip 'new'
-                ParserEngine::advanceParser(tempParser); // skip identifier
-                TokenData* nextToken = ParserEngine::currentToken(tempParser);
-                if (nextToken && (nextToken->type == ARRAY_OPEN || nextToken->type == TYPE_OPEN)) {
-                    return parseArrayDeclaration(parser);
-                }
+        case NEW: {
+            // Check if it's array declaration: new name[...] or new name{type}[...]
+            TokenData* nameToken = ParserEngine::peekToken(parser, 1);
+            TokenData* nextToken = ParserEngine::peekToken(parser, 2);
+            if (nameToken && nameToken->type == IDENTIFIER &&
+                nextToken && (nextToken->type == ARRAY_OPEN || nextToken->type == TYPE_OPEN)) {
+                return parseArrayDeclaration(parser);
             }
             return parseVariableDeclaration(parser);
+        }
         
         case BL:
             return parseBoolDeclaration(parser);
@@ -57,27 +71,27 @@ std::unique_ptr<ASTNode> ASTParser::parseStatement(Parser& parser) {
             
         default:
             ParserEngine::parserError(parser, "Unexpected token at start of statement");
-            return nullptr;
+            return NO_NODE;
     }
 }
 
-std::unique_ptr<VariableDeclarationNode> ASTParser::parseVariableDeclaration(Parser& parser) {
+NodeId ASTParser::parseVariableDeclaration(Parser& parser) {
     TokenData* token = ParserEngine::currentToken(parser);
-    int line = token->line, column = token->column;
+    uint32_t offset = token->offset;
     
     // Consume 'new'
     if (!ParserEngine::consumeToken(parser, NEW)) {
         ParserEngine::parserError(parser, "Expected 'new' keyword");
-        return nullptr;
+        return NO_NODE;
     }
     
     // Get variable name
     token = ParserEngine::currentToken(parser);
     if (!token || token->type != IDENTIFIER) {
         ParserEngine::parserError(parser, "Expected variable name after 'new'");
-        return nullptr;
+        return NO_NODE;
     }
-    std::string varName = token->value;
+    SymbolId varName = token->symbol;
     ParserEngine::advanceParser(parser);
     
     // Get variable type
@@ -85,7 +99,7 @@ std::unique_ptr<VariableDeclarationNode> ASTParser::parseVariableDeclaration(Par
     if (!token || (token->type != STRING && token->type != INTEGER && 
                    token->type != FLOAT && token->type != BOOL)) {
         ParserEngine::parserError(parser, "Expected type (string, int, float, bool) after variable name");
-        return nullptr;
+        return NO_NODE;
     }
     Token varType = token->type;
     ParserEngine::advanceParser(parser);
@@ -93,100 +107,106 @@ std::unique_ptr<VariableDeclarationNode> ASTParser::parseVariableDeclaration(Par
     // Expect '='
     if (!ParserEngine::consumeToken(parser, ASSIGNMENT)) {
         ParserEngine::parserError(parser, "Expected '=' after variable type");
-        return nullptr;
+        return NO_NODE;
     }
     
     // Parse the value expression
-    auto value = parseExpression(parser);
-    if (!value) {
+    NodeId value = parseExpression(parser);
+    if (value == NO_NODE) {
         ParserEngine::parserError(parser, "Expected value after '='");
-        return nullptr;
+        return NO_NODE;
     }
     
-    return std::make_unique<VariableDeclarationNode>(varName, varType, std::move(value), line, column);
+    return parser.ast->addNode(ASTNodeType::VARIABLE_DECLARATION, offset, varName, value, varType);
 }
 
-std::unique_ptr<VariableDeclarationNode> ASTParser::parseBoolDeclaration(Parser& parser) {
+NodeId ASTParser::parseBoolDeclaration(Parser& parser) {
     TokenData* token = ParserEngine::currentToken(parser);
-    int line = token->line, column = token->column;
+    uint32_t offset = token->offset;
     
     // Consume 'bl'
     if (!ParserEngine::consumeToken(parser, BL)) {
         ParserEngine::parserError(parser, "Expected 'bl' keyword");
-        return nullptr;
+        return NO_NODE;
     }
     
     // Get variable name
     token = ParserEngine::currentToken(parser);
     if (!token || token->type != IDENTIFIER) {
         ParserEngine::parserError(parser, "Expected variable name after 'bl'");
-        return nullptr;
+        return NO_NODE;
     }
-    std::string varName = token->value;
+    SymbolId varName = token->symbol;
     ParserEngine::advanceParser(parser);
     
     // Expect '='
     if (!ParserEngine::consumeToken(parser, ASSIGNMENT)) {
         ParserEngine::parserError(parser, "Expected '=' after variable name");
-        return nullptr;
+        return NO_NODE;
     }
     
     // Parse the value expression
-    auto value = parseExpression(parser);
-    if (!value) {
+    NodeId value = parseExpression(parser);
+    if (value == NO_NODE) {
         ParserEngine::parserError(parser, "Expected value after '='");
-        return nullptr;
+        return NO_NODE;
     }
     
-    return std::make_unique<VariableDeclarationNode>(varName, BOOL, std::move(value), line, column);
+    return parser.ast->addNode(ASTNodeType::VARIABLE_DECLARATION, offset, varName, value, BOOL);
 }
 
-std::unique_ptr<StdoutStatementNode> ASTParser::parseStdoutStatement(Parser& parser) {
+NodeId ASTParser::parseStdoutStatement(Parser& parser) {
     TokenData* token = ParserEngine::currentToken(parser);
-    int line = token->line, column = token->column;
+    uint32_t offset = token->offset;
     
     // Consume 'stdout'
     if (!ParserEngine::consumeToken(parser, STDOUT)) {
         ParserEngine::parserError(parser, "Expected 'stdout' keyword");
-        return nullptr;
+        return NO_NODE;
     }
     
     // Expect '['
     token = ParserEngine::currentToken(parser);
     if (!token || token->type != ARRAY_OPEN) {
         ParserEngine::parserError(parser, "Expected '[' after 'stdout'");
-        return nullptr;
+        return NO_NODE;
     }
+    uint32_t contentStart = token->offset + token->length;
     ParserEngine::advanceParser(parser); // consume '['
     
     // Parse string interpolation content
-    auto interpolationNode = parseStringInterpolation(parser);
-    if (!interpolationNode) {
+    NodeId interpolationNode = parseStringInterpolation(parser, contentStart);
+    if (interpolationNode == NO_NODE) {
         ParserEngine::parserError(parser, "Failed to parse stdout content");
-        return nullptr;
+        return NO_NODE;
     }
     
     // Expect ']'
     if (!ParserEngine::consumeToken(parser, ARRAY_CLOSE)) {
         ParserEngine::parserError(parser, "Expected ']' after stdout content");
-        return nullptr;
+        return NO_NODE;
     }
     
-    return std::make_unique<StdoutStatementNode>(std::move(interpolationNode), line, column);
+    return parser.ast->addNode(ASTNodeType::STDOUT_STATEMENT, offset, interpolationNode);
 }
 
-std::unique_ptr<StringInterpolationNode> ASTParser::parseStringInterpolation(Parser& parser) {
+// Text parts are the raw source between the delimiters ('[' or '}' up to
+// '{' or ']'), spacing and punctuation included, so printing the parts and
+// values in order reproduces the written line.
+NodeId ASTParser::parseStringInterpolation(Parser& parser, uint32_t textStart) {
     TokenData* token = ParserEngine::currentToken(parser);
-    int line = token->line, column = token->column;
+    uint32_t offset = token->offset;
+    std::string_view source = parser.lexer.source;
+    FlatAST& ast = *parser.ast;
     
-    auto interpolationNode = std::make_unique<StringInterpolationNode>(line, column);
-    std::string currentTextPart;
+    // Entries alternate text part and expression, starting and ending with a part
+    size_t mark = parser.listItems.size();
+    uint32_t expressionCount = 0;
     
     while (token && token->type != ARRAY_CLOSE && token->type != END_OF_FILE) {
         if (token->type == TYPE_OPEN) { // '{'
-            // Save current text part if any (even if empty, to maintain order)
-            interpolationNode->parts.push_back(currentTextPart);
-            currentTextPart.clear();
+            // Save current text part (even if empty, to maintain order)
+            parser.listItems.push_back(ast.addString(source.substr(textStart, token->offset - textStart)));
             
             ParserEngine::advanceParser(parser); // consume '{'
             
@@ -194,114 +214,188 @@ std::unique_ptr<StringInterpolationNode> ASTParser::parseStringInterpolation(Par
             token = ParserEngine::currentToken(parser);
             if (!token || token->type != IDENTIFIER) {
                 ParserEngine::parserError(parser, "Expected variable name inside {}");
-                return nullptr;
+                parser.listItems.resize(mark);
+                return NO_NODE;
             }
             
-            auto varNode = std::make_unique<IdentifierNode>(token->value, token->line, token->column);
-            interpolationNode->expressions.push_back(std::move(varNode));
+            parser.listItems.push_back(ast.addNode(ASTNodeType::IDENTIFIER, token->offset, token->symbol));
+            expressionCount++;
             ParserEngine::advanceParser(parser);
             
             // Expect '}'
+            token = ParserEngine::currentToken(parser);
             if (!ParserEngine::consumeToken(parser, TYPE_CLOSE)) {
                 ParserEngine::parserError(parser, "Expected '}' after variable name");
-                return nullptr;
+                parser.listItems.resize(mark);
+                return NO_NODE;
             }
+            textStart = token->offset + token->length;
             
             token = ParserEngine::currentToken(parser);
         } else {
-            // Collect regular text
-            if (!currentTextPart.empty()) currentTextPart += " ";
-            currentTextPart += token->value;
+            // Regular text is taken from the source once the part ends
             ParserEngine::advanceParser(parser);
             token = ParserEngine::currentToken(parser);
         }
     }
     
     // Always save the final text part (even if empty) to maintain proper interleaving
-    interpolationNode->parts.push_back(currentTextPart);
+    uint32_t textEnd = token ? token->offset : textStart;
+    parser.listItems.push_back(ast.addString(source.substr(textStart, textEnd - textStart)));
     
-    return interpolationNode;
+    return ast.addNode(ASTNodeType::STRING_INTERPOLATION, offset, commitList(parser, mark), expressionCount);
 }
 
-std::unique_ptr<ASTNode> ASTParser::parseExpression(Parser& parser) {
-    auto left = parsePrimary(parser);
-    if (!left) return nullptr;
-    
-    TokenData* token = ParserEngine::currentToken(parser);
-    if (!token) return left;
-    
-    // Handle binary operators
-    if (token->type == ADD || token->type == SUB || token->type == MUL || 
-        token->type == DIV || token->type == EQUAL || token->type == NOT_EQUAL ||
-        token->type == GREATER || token->type == LESSER || 
-        token->type == GREATER_EQUAL || token->type == LESSER_EQUAL) {
+namespace {
+
+// Binding power of binary operators; 0 means the token does not continue an expression
+uint8_t binaryPrecedence(Token type) {
+    switch (type) {
+        case MUL: case DIV: case MOD:
+            return 3;
+        case ADD: case SUB:
+            return 2;
+        case EQUAL: case NOT_EQUAL: case GREATER: case LESSER:
+        case GREATER_EQUAL: case LESSER_EQUAL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+} // namespace
+
+// Precedence climbing over explicit operand/operator stacks rather than
+// recursion, so neither long operator chains nor deeply nested parentheses
+// grow the C++ call stack. All binary operators are left-associative.
+NodeId ASTParser::parseExpression(Parser& parser) {
+    std::vector<NodeId>& operands = parser.operands;
+    std::vector<PendingOperator>& operators = parser.operators;
+    size_t operandBase = operands.size();
+    size_t operatorBase = operators.size();
+    int openParens = 0;
+    
+    // Replaces the top two operands with the top operator applied to them
+    auto reduce = [&]() {
+        PendingOperator pending = operators.back();
+        operators.pop_back();
+        NodeId right = operands.back();
+        operands.pop_back();
+        operands.back() = parser.ast->addNode(ASTNodeType::BINARY_OPERATION, pending.offset, operands.back(), right,
+                                              pending.op);
+    };
+    auto fail = [&]() -> NodeId {
+        operands.resize(operandBase);
+        operators.resize(operatorBase);
+        return NO_NODE;
+    };
+    
+    while (true) {
+        // Operand position: any number of '(' followed by a primary
+        TokenData* token = ParserEngine::currentToken(parser);
+        while (token && token->type == LPAREN) {
+            operators.push_back(PendingOperator{LPAREN, 0, token->offset});
+            openParens++;
+            ParserEngine::advanceParser(parser);
+            token = ParserEngine::currentToken(parser);
+        }
         
-        Token op = token->type;
-        int line = token->line, column = token->column;
-        ParserEngine::advanceParser(parser);
+        NodeId operand = parsePrimary(parser);
+        if (operand == NO_NODE) {
+            if (operators.size() > operatorBase && operators.back().op != LPAREN) {
+                ParserEngine::parserError(parser, "Expected right operand");
+            }
+            return fail();
+        }
+        operands.push_back(operand);
         
-        auto right = parseExpression(parser);
-        if (!right) {
-            ParserEngine::parserError(parser, "Expected right operand");
-            return nullptr;
+        // Operator position: close any parentheses, then continue or stop
+        token = ParserEngine::currentToken(parser);
+        while (token && token->type == RPAREN && openParens > 0) {
+            while (operators.back().op != LPAREN) reduce();
+            operators.pop_back();
+            openParens--;
+            ParserEngine::advanceParser(parser);
+            token = ParserEngine::currentToken(parser);
         }
         
-        return std::make_unique<BinaryOperationNode>(std::move(left), std::move(right), op, line, column);
+        uint8_t precedence = token ? binaryPrecedence(token->type) : 0;
+        if (precedence == 0) break;
+        
+        while (operators.size() > operatorBase && operators.back().precedence >= precedence) {
+            reduce();
+        }
+        operators.push_back(PendingOperator{token->type, precedence, token->offset});
+        ParserEngine::advanceParser(parser);
+    }
+    
+    if (openParens > 0) {
+        ParserEngine::parserError(parser, "Expected ')' after expression");
+        return fail();
+    }
+    while (operators.size() > operatorBase) {
+        reduce();
     }
     
-    return left;
+    NodeId result = operands.back();
+    operands.pop_back();
+    return result;
 }
 
-std::unique_ptr<ASTNode> ASTParser::parsePrimary(Parser& parser) {
+NodeId ASTParser::parsePrimary(Parser& parser) {
     TokenData* token = ParserEngine::currentToken(parser);
     if (!token) {
         ParserEngine::parserError(parser, "Unexpected end of input");
-        return nullptr;
+        return NO_NODE;
     }
+    std::string_view text = ParserEngine::tokenText(parser, token);
+    FlatAST& ast = *parser.ast;
     
     switch (token->type) {
         case INTEGER: {
-            int value = std::stoi(token->value);
+            int value = 0;
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (result.ec != std::errc()) {
+                ParserEngine::parserError(parser, "Integer literal out of range");
+                return NO_NODE;
+            }
             ParserEngine::advanceParser(parser);
-            return std::make_unique<LiteralIntNode>(value, token->line, token->column);
+            ast.ints.push_back(value);
+            return ast.addNode(ASTNodeType::LITERAL_INT, token->offset, (uint32_t)(ast.ints.size() - 1));
         }
         
         case FLOAT: {
-            float value = std::stof(token->value);
+            float value = 0.0f;
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (result.ec != std::errc()) {
+                ParserEngine::parserError(parser, "Float literal out of range");
+                return NO_NODE;
+            }
             ParserEngine::advanceParser(parser);
-            return std::make_unique<LiteralFloatNode>(value, token->line, token->column);
+            ast.floats.push_back(value);
+            return ast.addNode(ASTNodeType::LITERAL_FLOAT, token->offset, (uint32_t)(ast.floats.size() - 1));
         }
         
         case STRING: {
-            auto node = std::make_unique<LiteralStringNode>(token->value, token->line, token->column);
+            NodeId node = ast.addNode(ASTNodeType::LITERAL_STRING, token->offset, ast.addString(text));
             ParserEngine::advanceParser(parser);
-            return std::move(node);
+            return node;
         }
         
         case TRUE_VAL: {
             ParserEngine::advanceParser(parser);
-            return std::make_unique<LiteralBoolNode>(true, token->line, token->column);
+            return ast.addNode(ASTNodeType::LITERAL_BOOL, token->offset, 1);
         }
         
         case FALSE_VAL: {
             ParserEngine::advanceParser(parser);
-            return std::make_unique<LiteralBoolNode>(false, token->line, token->column);
+            return ast.addNode(ASTNodeType::LITERAL_BOOL, token->offset, 0);
         }
         
         case IDENTIFIER: {
-            auto node = std::make_unique<IdentifierNode>(token->value, token->line, token->column);
+            NodeId node = ast.addNode(ASTNodeType::IDENTIFIER, token->offset, token->symbol);
             ParserEngine::advanceParser(parser);
-            return std::move(node);
-        }
-        
-        case LPAREN: {
-            ParserEngine::advanceParser(parser); // consume '('
-            auto expr = parseExpression(parser);
-            if (!ParserEngine::consumeToken(parser, RPAREN)) {
-                ParserEngine::parserError(parser, "Expected ')' after expression");
-                return nullptr;
-            }
-            return expr;
+            return node;
         }
         
         case ARRAY_OPEN: {
@@ -310,7 +404,7 @@ std::unique_ptr<ASTNode> ASTParser::parsePrimary(Parser& parser) {
         
         default:
             ParserEngine::parserError(parser, "Expected primary expression");
-            return nullptr;
+            return NO_NODE;
     }
 }
 
@@ -332,308 +426,29 @@ std::string ASTParser::astTypeToString(ASTNodeType type) {
     }
 }
 
-void ASTParser::printAST(const ASTNode* node, int indent) {
-    if (!node) return;
-    
-    for (int i = 0; i < indent; i++) std::cout << "  ";
-    std::cout << astTypeToString(node->type);
-    
-    switch (node->type) {
-        case ASTNodeType::PROGRAM: {
-            const ProgramNode* program = static_cast<const ProgramNode*>(node);
-            std::cout << " (" << program->statements.size() << " statements)" << std::endl;
-            for (const auto& stmt : program->statements) {
-                printAST(stmt.get(), indent + 1);
-            }
-            break;
-        }
-        
-        case ASTNodeType::VARIABLE_DECLARATION: {
-            const VariableDeclarationNode* varDecl = static_cast<const VariableDeclarationNode*>(node);
-            std::cout << " '" << varDecl->varName << "' type=" 
-                      << LexerEngine::tokenTypeToString(varDecl->varType) << std::endl;
-            printAST(varDecl->value.get(), indent + 1);
-            break;
-        }
-        
-        case ASTNodeType::STDOUT_STATEMENT: {
-            const StdoutStatementNode* stdoutStmt = static_cast<const StdoutStatementNode*>(node);
-            std::cout << std::endl;
-            printAST(stdoutStmt->content.get(), indent + 1);
-            break;
-        }
-        
-        case ASTNodeType::STRING_INTERPOLATION: {
-            const StringInterpolationNode* stringInterp = static_cast<const StringInterpolationNode*>(node);
-            std::cout << " [" << stringInterp->parts.size() << " parts, " 
-                      << stringInterp->expressions.size() << " expressions]" << std::endl;
-            
-            // Print text parts and expressions properly interleaved
-            // Pattern: TEXT_PART, EXPR, TEXT_PART, EXPR, TEXT_PART...
-            size_t exprIndex = 0;
-            for (size_t i = 0; i < stringInterp->parts.size(); i++) {
-                // Print text part (even if empty)
-                if (!stringInterp->parts[i].empty()) {
-                    for (int j = 0; j < indent + 1; j++) std::cout << "  ";
-                    std::cout << "TEXT_PART \"" << stringInterp->parts[i] << "\"" << std::endl;
-                }
-                
-                // Print expression if available
-                if (exprIndex < stringInterp->expressions.size()) {
-                    printAST(stringInterp->expressions[exprIndex].get(), indent + 1);
-                    exprIndex++;
-                }
-            }
-            break;
-        }
-        
-        case ASTNodeType::BINARY_OPERATION: {
-            const BinaryOperationNode* binaryOp = static_cast<const BinaryOperationNode*>(node);
-            std::cout << " " << LexerEngine::tokenTypeToString(binaryOp->op) << std::endl;
-            printAST(binaryOp->left.get(), indent + 1);
-            printAST(binaryOp->right.get(), indent + 1);
-            break;
-        }
-        
-        case ASTNodeType::IDENTIFIER: {
-            const IdentifierNode* identifier = static_cast<const IdentifierNode*>(node);
-            std::cout << " '" << identifier->name << "'" << std::endl;
-            break;
-        }
-        
-        case ASTNodeType::LITERAL_INT: {
-            const LiteralIntNode* intLiteral = static_cast<const LiteralIntNode*>(node);
-            std::cout << " " << intLiteral->value << std::endl;
-            break;
-        }
-        
-        case ASTNodeType::LITERAL_FLOAT: {
-            const LiteralFloatNode* floatLiteral = static_cast<const LiteralFloatNode*>(node);
-            std::cout << " " << floatLiteral->value << std::endl;
-            break;
-        }
-        
-        case ASTNodeType::LITERAL_STRING: {
-            const LiteralStringNode* stringLiteral = static_cast<const LiteralStringNode*>(node);
-            std::cout << " \"" << stringLiteral->value << "\"" << std::endl;
-            break;
-        }
-        
-        case ASTNodeType::LITERAL_BOOL: {
-            const LiteralBoolNode* boolLiteral = static_cast<const LiteralBoolNode*>(node);
-            std::cout << " " << (boolLiteral->value ? "true" : "false") << std::endl;
-            break;
-        }
-        
-        case ASTNodeType::ARRAY_LITERAL: {
-            const ArrayLiteralNode* arrayLiteral = static_cast<const ArrayLiteralNode*>(node);
-            std::cout << " [" << arrayLiteral->elements.size() << " elements]" << std::endl;
-            for (const auto& element : arrayLiteral->elements) {
-                printAST(element.get(), indent + 1);
-            }
-            break;
-        }
-        
-        case ASTNodeType::ARRAY_DECLARATION: {
-            const ArrayDeclarationNode* arrayDecl = static_cast<const ArrayDeclarationNode*>(node);
-            std::cout << " '" << arrayDecl->varName << "'";
-            if (arrayDecl->hasType) {
-                std::cout << " type=" << LexerEngine::tokenTypeToString(arrayDecl->elementType);
-            } else if (arrayDecl->initializer) {
-                // Show inferred type from first element
-                std::cout << " type=inferred";
-            }
-            if (arrayDecl->hasSize) {
-                std::cout << " size=" << arrayDecl->size;
-            }
-            std::cout << std::endl;
-            if (arrayDecl->initializer) {
-                printAST(arrayDecl->initializer.get(), indent + 1);
-            }
-            break;
-        }
-        
-        default:
-            std::cout << std::endl;
-            break;
-    }
-}
-
-std::string ASTParser::astToString(const ASTNode* node, int indent) {
-    std::string out;
-    out.reserve(1024); // pre-reserve to reduce reallocs for medium trees
-    buildASTString(node, indent, out);
-    return out;
-}
-
-// the worker that actually builds the string
-void ASTParser::buildASTString(const ASTNode* node, int indent, std::string &out) {
-    if (!node) return;
-
-    // indentation: two spaces per indent level (matches your current print)
-    out.append(static_cast<size_t>(indent) * 2, ' ');
-
-    // node type name
-    out += astTypeToString(node->type);
-
-    switch (node->type) {
-        case ASTNodeType::PROGRAM: {
-            const ProgramNode* program = static_cast<const ProgramNode*>(node);
-            out += " (" + std::to_string(program->statements.size()) + " statements)\n";
-            for (const auto& stmt : program->statements) {
-                buildASTString(stmt.get(), indent + 1, out);
-            }
-            break;
-        }
-
-        case ASTNodeType::VARIABLE_DECLARATION: {
-            const VariableDeclarationNode* varDecl = static_cast<const VariableDeclarationNode*>(node);
-            out += " '";
-            out += varDecl->varName;
-            out += "' type=";
-            out += LexerEngine::tokenTypeToString(varDecl->varType);
-            out += '\n';
-            buildASTString(varDecl->value.get(), indent + 1, out);
-            break;
-        }
-
-        case ASTNodeType::STDOUT_STATEMENT: {
-            const StdoutStatementNode* stdoutStmt = static_cast<const StdoutStatementNode*>(node);
-            out += '\n'; // print had a newline here
-            buildASTString(stdoutStmt->content.get(), indent + 1, out);
-            break;
-        }
-
-        case ASTNodeType::STRING_INTERPOLATION: {
-            const StringInterpolationNode* stringInterp = static_cast<const StringInterpolationNode*>(node);
-            out += " [" + std::to_string(stringInterp->parts.size()) + " parts, "
-                        + std::to_string(stringInterp->expressions.size()) + " expressions]\n";
-
-            size_t maxItems = std::max(stringInterp->parts.size(), stringInterp->expressions.size());
-            for (size_t i = 0; i < maxItems; ++i) {
-                if (i < stringInterp->parts.size()) {
-                    out.append(static_cast<size_t>(indent + 1) * 2, ' ');
-                    out += "TEXT_PART \"";
-                    out += stringInterp->parts[i];
-                    out += "\"\n";
-                }
-                if (i < stringInterp->expressions.size()) {
-                    buildASTString(stringInterp->expressions[i].get(), indent + 1, out);
-                }
-            }
-            break;
-        }
-
-        case ASTNodeType::BINARY_OPERATION: {
-            const BinaryOperationNode* binaryOp = static_cast<const BinaryOperationNode*>(node);
-            out += " ";
-            out += LexerEngine::tokenTypeToString(binaryOp->op);
-            out += '\n';
-            buildASTString(binaryOp->left.get(), indent + 1, out);
-            buildASTString(binaryOp->right.get(), indent + 1, out);
-            break;
-        }
-
-        case ASTNodeType::IDENTIFIER: {
-            const IdentifierNode* identifier = static_cast<const IdentifierNode*>(node);
-            out += " '";
-            out += identifier->name;
-            out += "'\n";
-            break;
-        }
-
-        case ASTNodeType::LITERAL_INT: {
-            const LiteralIntNode* intLiteral = static_cast<const LiteralIntNode*>(node);
-            out += " ";
-            out += std::to_string(intLiteral->value);
-            out += '\n';
-            break;
-        }
-
-        case ASTNodeType::LITERAL_FLOAT: {
-            const LiteralFloatNode* floatLiteral = static_cast<const LiteralFloatNode*>(node);
-            out += " ";
-            out += std::to_string(floatLiteral->value);
-            out += '\n';
-            break;
-        }
-
-        case ASTNodeType::LITERAL_STRING: {
-            const LiteralStringNode* stringLiteral = static_cast<const LiteralStringNode*>(node);
-            out += " \"";
-            out += stringLiteral->value;
-            out += "\"\n";
-            break;
-        }
-
-        case ASTNodeType::LITERAL_BOOL: {
-            const LiteralBoolNode* boolLiteral = static_cast<const LiteralBoolNode*>(node);
-            out += " ";
-            out += (boolLiteral->value ? "true" : "false");
-            out += '\n';
-            break;
-        }
-
-        case ASTNodeType::ARRAY_LITERAL: {
-            const ArrayLiteralNode* arrayLiteral = static_cast<const ArrayLiteralNode*>(node);
-            out += " [" + std::to_string(arrayLiteral->elements.size()) + " elements]\n";
-            for (const auto& element : arrayLiteral->elements) {
-                buildASTString(element.get(), indent + 1, out);
-            }
-            break;
-        }
-
-        case ASTNodeType::ARRAY_DECLARATION: {
-            const ArrayDeclarationNode* arrayDecl = static_cast<const ArrayDeclarationNode*>(node);
-            out += " '";
-            out += arrayDecl->varName;
-            out += "'";
-            if (arrayDecl->hasType) {
-                out += " type=";
-                out += LexerEngine::tokenTypeToString(arrayDecl->elementType);
-            } else if (arrayDecl->initializer) {
-                // Show inferred type from first element
-                out += " type=inferred";
-            }
-            if (arrayDecl->hasSize) {
-                out += " size=";
-                out += std::to_string(arrayDecl->size);
-            }
-            out += '\n';
-            if (arrayDecl->initializer) {
-                buildASTString(arrayDecl->initializer.get(), indent + 1, out);
-            }
-            break;
-        }
-
-        default:
-            out += '\n';
-            break;
-    }
-}
-
-std::unique_ptr<ArrayLiteralNode> ASTParser::parseArrayLiteral(Parser& parser) {
+NodeId ASTParser::parseArrayLiteral(Parser& parser) {
     TokenData* token = ParserEngine::currentToken(parser);
-    int line = token->line, column = token->column;
+    uint32_t offset = token->offset;
     
     // Consume '['
     if (!ParserEngine::consumeToken(parser, ARRAY_OPEN)) {
         ParserEngine::parserError(parser, "Expected '[' for array literal");
-        return nullptr;
+        return NO_NODE;
     }
     
-    auto arrayNode = std::make_unique<ArrayLiteralNode>(line, column);
+    size_t mark = parser.listItems.size();
     
     // Parse elements
     token = ParserEngine::currentToken(parser);
     if (token && token->type != ARRAY_CLOSE) {
         do {
-            auto element = parseExpression(parser);
-            if (!element) {
+            NodeId element = parseExpression(parser);
+            if (element == NO_NODE) {
                 ParserEngine::parserError(parser, "Expected array element");
-                return nullptr;
+                parser.listItems.resize(mark);
+                return NO_NODE;
             }
-            arrayNode->elements.push_back(std::move(element));
+            parser.listItems.push_back(element);
             
             token = ParserEngine::currentToken(parser);
             if (token && token->type == COMMA) {
@@ -647,32 +462,35 @@ std::unique_ptr<ArrayLiteralNode> ASTParser::parseArrayLiteral(Parser& parser) {
     // Consume ']'
     if (!ParserEngine::consumeToken(parser, ARRAY_CLOSE)) {
         ParserEngine::parserError(parser, "Expected ']' after array elements");
-        return nullptr;
+        parser.listItems.resize(mark);
+        return NO_NODE;
     }
     
-    return arrayNode;
+    uint32_t count = (uint32_t)(parser.listItems.size() - mark);
+    return parser.ast->addNode(ASTNodeType::ARRAY_LITERAL, offset, commitList(parser, mark), count);
 }
 
-std::unique_ptr<ArrayDeclarationNode> ASTParser::parseArrayDeclaration(Parser& parser) {
+NodeId ASTParser::parseArrayDeclaration(Parser& parser) {
     TokenData* token = ParserEngine::currentToken(parser);
-    int line = token->line, column = token->column;
+    uint32_t offset = token->offset;
     
     // Consume 'new'
     if (!ParserEngine::consumeToken(parser, NEW)) {
         ParserEngine::parserError(parser, "Expected 'new' keyword");
-        return nullptr;
+        return NO_NODE;
     }
     
     // Get variable name
     token = ParserEngine::currentToken(parser);
     if (!token || token->type != IDENTIFIER) {
         ParserEngine::parserError(parser, "Expected variable name after 'new'");
-        return nullptr;
+        return NO_NODE;
     }
-    std::string varName = token->value;
+    SymbolId varName = token->symbol;
     ParserEngine::advanceParser(parser);
     
-    auto arrayDecl = std::make_unique<ArrayDeclarationNode>(varName, line, column);
+    FlatArrayDecl arrayDecl{UNKNOWN, false, false, 0};
+    NodeId initializer = NO_NODE;
     
     token = ParserEngine::currentToken(parser);
     
@@ -682,23 +500,21 @@ std::unique_ptr<ArrayDeclarationNode> ASTParser::parseArrayDeclaration(Parser& p
         
         if (!ParserEngine::consumeToken(parser, ARRAY_CLOSE)) {
             ParserEngine::parserError(parser, "Expected ']' after '['");
-            return nullptr;
+            return NO_NODE;
         }
         
         // Expect '='
         if (!ParserEngine::consumeToken(parser, ASSIGNMENT)) {
             ParserEngine::parserError(parser, "Expected '=' after array declaration");
-            return nullptr;
+            return NO_NODE;
         }
         
         // Parse array literal
-        auto initializer = parseArrayLiteral(parser);
-        if (!initializer) {
+        initializer = parseArrayLiteral(parser);
+        if (initializer == NO_NODE) {
             ParserEngine::parserError(parser, "Expected array literal after '='");
-            return nullptr;
+            return NO_NODE;
         }
-        
-        arrayDecl->initializer = std::move(initializer);
     }
     // Case 2: new some_undeclared_array{int}[10]
     else if (token && token->type == TYPE_OPEN) {
@@ -709,46 +525,53 @@ std::unique_ptr<ArrayDeclarationNode> ASTParser::parseArrayDeclaration(Parser& p
         if (!token || (token->type != STRING && token->type != INTEGER && 
                        token->type != FLOAT && token->type != BOOL)) {
             ParserEngine::parserError(parser, "Expected type inside {}");
-            return nullptr;
+            return NO_NODE;
         }
-        arrayDecl->elementType = token->type;
-        arrayDecl->hasType = true;
+        arrayDecl.elementType = token->type;
+        arrayDecl.hasType = true;
         ParserEngine::advanceParser(parser);
         
         // Consume '}'
         if (!ParserEngine::consumeToken(parser, TYPE_CLOSE)) {
             ParserEngine::parserError(parser, "Expected '}' after type");
-            return nullptr;
+            return NO_NODE;
         }
         
         // Expect '['
         if (!ParserEngine::consumeToken(parser, ARRAY_OPEN)) {
             ParserEngine::parserError(parser, "Expected '[' after type specification");
-            return nullptr;
+            return NO_NODE;
         }
         
         // Get size
         token = ParserEngine::currentToken(parser);
         if (!token || token->type != INTEGER) {
             ParserEngine::parserError(parser, "Expected array size");
-            return nullptr;
+            return NO_NODE;
+        }
+        std::string_view text = ParserEngine::tokenText(parser, token);
+        auto result = std::from_chars(text.data(), text.data() + text.size(), arrayDecl.size);
+        if (result.ec != std::errc()) {
+            ParserEngine::parserError(parser, "Array size out of range");
+            return NO_NODE;
         }
-        arrayDecl->size = std::stoi(token->value);
-        arrayDecl->hasSize = true;
+        arrayDecl.hasSize = true;
         ParserEngine::advanceParser(parser);
         
         // Consume ']'
         if (!ParserEngine::consumeToken(parser, ARRAY_CLOSE)) {
             ParserEngine::parserError(parser, "Expected ']' after array size");
-            return nullptr;
+            return NO_NODE;
         }
     }
     else {
         ParserEngine::parserError(parser, "Expected array syntax after variable name");
-        return nullptr;
+        return NO_NODE;
     }
     
-    return arrayDecl;
+    FlatAST& ast = *parser.ast;
+    ast.arrays.push_back(arrayDecl);
+    return ast.addNode(ASTNodeType::ARRAY_DECLARATION, offset, varName, initializer, (uint32_t)(ast.arrays.size() - 1));
 }
 
 void ASTParser::synchronizeParser(Parser& parser) {
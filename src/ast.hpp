@@ -1,8 +1,8 @@
 #pragma once
 #include "parser.hpp"
 #include "error.hpp"
-#include <memory>
-#include <vector>
+#include <cstdint>
+#include <string>
 
 enum class ASTNodeType {
     PROGRAM,
@@ -19,139 +19,31 @@ enum class ASTNodeType {
     ARRAY_DECLARATION,
 };
 
-class ASTNode {
-public:
-    ASTNodeType type;
-    int line, column;
-    
-    ASTNode(ASTNodeType t, int l, int c) : type(t), line(l), column(c) {}
-    virtual ~ASTNode() = default;
-};
-
-class ProgramNode : public ASTNode {
-public:
-    std::vector<std::unique_ptr<ASTNode>> statements;
-    
-    ProgramNode(int line, int column) : ASTNode(ASTNodeType::PROGRAM, line, column) {}
-};
-
-class VariableDeclarationNode : public ASTNode {
-public:
-    std::string varName;
-    Token varType;
-    std::unique_ptr<ASTNode> value;
-    
-    VariableDeclarationNode(const std::string& name, Token type, std::unique_ptr<ASTNode> val, int line, int column)
-        : ASTNode(ASTNodeType::VARIABLE_DECLARATION, line, column), varName(name), varType(type), value(std::move(val)) {}
-};
-
-class StdoutStatementNode : public ASTNode {
-public:
-    std::unique_ptr<ASTNode> content;
-    
-    StdoutStatementNode(std::unique_ptr<ASTNode> cont, int line, int column)
-        : ASTNode(ASTNodeType::STDOUT_STATEMENT, line, column), content(std::move(cont)) {}
-};
-
-class BinaryOperationNode : public ASTNode {
-public:
-    std::unique_ptr<ASTNode> left;
-    std::unique_ptr<ASTNode> right;
-    Token op;
-    
-    BinaryOperationNode(std::unique_ptr<ASTNode> l, std::unique_ptr<ASTNode> r, Token operation, int line, int column)
-        : ASTNode(ASTNodeType::BINARY_OPERATION, line, column), left(std::move(l)), right(std::move(r)), op(operation) {}
-};
-
-class IdentifierNode : public ASTNode {
-public:
-    std::string name;
-    
-    IdentifierNode(const std::string& n, int line, int column)
-        : ASTNode(ASTNodeType::IDENTIFIER, line, column), name(n) {}
-};
-
-class LiteralIntNode : public ASTNode {
-public:
-    int value;
-    
-    LiteralIntNode(int val, int line, int column)
-        : ASTNode(ASTNodeType::LITERAL_INT, line, column), value(val) {}
-};
+using NodeId = uint32_t;
+constexpr NodeId NO_NODE = UINT32_MAX;
 
-class LiteralFloatNode : public ASTNode {
-public:
-    float value;
-    
-    LiteralFloatNode(float val, int line, int column)
-        : ASTNode(ASTNodeType::LITERAL_FLOAT, line, column), value(val) {}
-};
-
-class LiteralStringNode : public ASTNode {
-public:
-    std::string value;
-    
-    LiteralStringNode(const std::string& val, int line, int column)
-        : ASTNode(ASTNodeType::LITERAL_STRING, line, column), value(val) {}
-};
-
-class LiteralBoolNode : public ASTNode {
-public:
-    bool value;
-    
-    LiteralBoolNode(bool val, int line, int column)
-        : ASTNode(ASTNodeType::LITERAL_BOOL, line, column), value(val) {}
-};
-
-class StringInterpolationNode : public ASTNode {
-public:
-    std::vector<std::string> parts;
-    std::vector<std::unique_ptr<ASTNode>> expressions;
-    
-    StringInterpolationNode(int line, int column)
-        : ASTNode(ASTNodeType::STRING_INTERPOLATION, line, column) {}
-};
-
-class ArrayLiteralNode : public ASTNode {
-public:
-    std::vector<std::unique_ptr<ASTNode>> elements;
-    
-    ArrayLiteralNode(int line, int column)
-        : ASTNode(ASTNodeType::ARRAY_LITERAL, line, column) {}
-};
-
-class ArrayDeclarationNode : public ASTNode {
-public:
-    std::string varName;
-    Token elementType;  // Type for uninitialized arrays
-    bool hasType;       // Whether type is explicitly specified
-    bool hasSize;       // Whether size is specified
-    int size;           // Size for uninitialized arrays
-    std::unique_ptr<ASTNode> initializer;  // For initialized arrays
-    
-    ArrayDeclarationNode(const std::string& name, int line, int column)
-        : ASTNode(ASTNodeType::ARRAY_DECLARATION, line, column), 
-          varName(name), elementType(UNKNOWN), hasType(false), hasSize(false), size(0) {}
-};
+class FlatAST;
 
-// AST Parser class
+// AST Parser class. Nodes are appended to the FlatAST as rows the moment
+// they are complete, children before their parent, so parsing produces the
+// flat encoding directly. Each function returns the id of the node it
+// parsed, or NO_NODE after reporting an error; rows of a statement that
+// failed are left unreferenced, and a program with errors is not used past
+// parsing.
 class ASTParser {
 public:
-    static std::unique_ptr<ProgramNode> parseProgram(Parser& parser);
-    static std::unique_ptr<ASTNode> parseStatement(Parser& parser);
-    static std::unique_ptr<VariableDeclarationNode> parseVariableDeclaration(Parser& parser);
-    static std::unique_ptr<VariableDeclarationNode> parseBoolDeclaration(Parser& parser);
-    static std::unique_ptr<StdoutStatementNode> parseStdoutStatement(Parser& parser);
-    static std::unique_ptr<StringInterpolationNode> parseStringInterpolation(Parser& parser);
-    static std::unique_ptr<ASTNode> parseExpression(Parser& parser);
-    static std::unique_ptr<ASTNode> parsePrimary(Parser& parser);
-    static std::unique_ptr<ArrayLiteralNode> parseArrayLiteral(Parser& parser);
-    static std::unique_ptr<ArrayDeclarationNode> parseArrayDeclaration(Parser& parser);
+    static NodeId parseProgram(Parser& parser, FlatAST& ast);
+    static NodeId parseStatement(Parser& parser);
+    static NodeId parseVariableDeclaration(Parser& parser);
+    static NodeId parseBoolDeclaration(Parser& parser);
+    static NodeId parseStdoutStatement(Parser& parser);
+    static NodeId parseStringInterpolation(Parser& parser, uint32_t textStart);
+    static NodeId parseExpression(Parser& parser);
+    static NodeId parsePrimary(Parser& parser);
+    static NodeId parseArrayLiteral(Parser& parser);
+    static NodeId parseArrayDeclaration(Parser& parser);
     
     // Utility functions
     static std::string astTypeToString(ASTNodeType type);
-    static void printAST(const ASTNode* node, int indent = 0);
-    static std::string astToString(const ASTNode* node, int indent);
-    static void buildASTString(const ASTNode* node, int indent, std::string &out);
     static void synchronizeParser(Parser& parser);
 };
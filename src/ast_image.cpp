@@ -0,0 +1,363 @@
+#include "ast_image.hpp"
+#include "cache.hpp"
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace {
+
+enum Section : uint32_t {
+    KINDS, OFFSETS, COLUMN_A, COLUMN_B, COLUMN_C, INTS, FLOATS, LISTS,
+    STRINGS, SYMBOLS, ARRAYS, TEXT,
+    SECTION_COUNT,
+};
+
+struct SectionRange {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t root;
+    uint32_t sectionCount;
+    SectionRange sections[SECTION_COUNT];
+};
+
+struct StringRecord {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct ArrayRecord {
+    uint64_t size;
+    uint8_t elementType;
+    uint8_t hasType;
+    uint8_t hasSize;
+    uint8_t padding[5];
+};
+
+const char IMAGE_MAGIC[8] = {'A', 'W', 'A', 'S', 'T', '\0', '\0', '\0'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Columns are copied byte for byte, so their in-memory layout is the format
+static_assert(sizeof(ASTNodeType) == 4 && sizeof(int) == 4 && sizeof(float) == 4);
+static_assert(sizeof(Header) == 40 + 16 * SECTION_COUNT);
+static_assert(sizeof(StringRecord) == 8 && sizeof(ArrayRecord) == 16);
+static_assert(std::is_trivially_copyable_v<Header>);
+
+const size_t ELEMENT_SIZES[SECTION_COUNT] = {4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 16, 1};
+
+void appendSection(std::string& image, Section section, const void* data, size_t count) {
+    image.resize((image.size() + 7) & ~size_t(7), '\0');
+    SectionRange range{image.size(), count};
+    std::memcpy(image.data() + offsetof(Header, sections) + section * sizeof(SectionRange), &range, sizeof(range));
+    image.append(static_cast<const char*>(data), count * ELEMENT_SIZES[section]);
+}
+
+template <typename T>
+void appendColumn(std::string& image, Section section, const std::vector<T>& column) {
+    appendSection(image, section, column.data(), column.size());
+}
+
+StringRecord addText(std::string& text, std::string_view value) {
+    StringRecord record{(uint32_t)text.size(), (uint32_t)value.size()};
+    text += value;
+    return record;
+}
+
+Header readHeader(std::string_view image) {
+    Header header;
+    std::memcpy(&header, image.data(), sizeof(header));
+    return header;
+}
+
+template <typename T>
+void copyColumn(std::string_view image, const SectionRange& range, std::vector<T>& column) {
+    column.resize(range.count);
+    if (range.count > 0) std::memcpy(column.data(), image.data() + range.offset, range.count * sizeof(T));
+}
+
+bool isStatement(ASTNodeType kind) {
+    return kind == ASTNodeType::VARIABLE_DECLARATION || kind == ASTNodeType::ARRAY_DECLARATION ||
+           kind == ASTNodeType::STDOUT_STATEMENT;
+}
+
+bool isExpression(ASTNodeType kind) {
+    switch (kind) {
+        case ASTNodeType::BINARY_OPERATION:
+        case ASTNodeType::IDENTIFIER:
+        case ASTNodeType::LITERAL_INT:
+        case ASTNodeType::LITERAL_FLOAT:
+        case ASTNodeType::LITERAL_STRING:
+        case ASTNodeType::LITERAL_BOOL:
+        case ASTNodeType::ARRAY_LITERAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The later passes trust the tree to look like one the parser built: every
+// operand refers to something that exists, each node has one parent that
+// comes after it (ASTParser appends in post-order), children are of
+// the kinds the grammar allows there, and source offsets lie within the
+// source. A loaded image is held to the same shape before anything walks it.
+bool checkNodes(const FlatAST& ast, size_t symbolCount, uint64_t sourceSize, std::string& error) {
+    size_t count = ast.nodeCount();
+    std::vector<bool> hasParent(count, false);
+    auto listFits = [&](uint64_t first, uint64_t length) { return first + length <= ast.lists.size(); };
+
+    for (NodeId id = 0; id < count; id++) {
+        // Claims `child` for this node if it is an earlier, unclaimed node
+        // of an allowed kind
+        auto adopt = [&](uint32_t child, bool (*allowed)(ASTNodeType)) {
+            if (child >= id || hasParent[child] || !allowed(ast.kinds[child])) return false;
+            hasParent[child] = true;
+            return true;
+        };
+        auto isIdentifier = [](ASTNodeType kind) { return kind == ASTNodeType::IDENTIFIER; };
+        auto isInterpolation = [](ASTNodeType kind) { return kind == ASTNodeType::STRING_INTERPOLATION; };
+        auto isArrayLiteral = [](ASTNodeType kind) { return kind == ASTNodeType::ARRAY_LITERAL; };
+
+        uint32_t a = ast.a[id], b = ast.b[id], c = ast.c[id];
+        bool valid = true;
+        switch (ast.kinds[id]) {
+            case ASTNodeType::PROGRAM:
+                valid = id == count - 1 && listFits(a, b);
+                for (uint32_t i = 0; valid && i < b; i++) valid = adopt(ast.lists[a + i], isStatement);
+                break;
+            case ASTNodeType::ARRAY_LITERAL:
+                valid = listFits(a, b);
+                for (uint32_t i = 0; valid && i < b; i++) valid = adopt(ast.lists[a + i], isExpression);
+                break;
+            case ASTNodeType::VARIABLE_DECLARATION:
+                valid = a < symbolCount && adopt(b, isExpression) && c <= UINT8_MAX;
+                break;
+            case ASTNodeType::STDOUT_STATEMENT:
+                valid = adopt(a, isInterpolation);
+                break;
+            case ASTNodeType::BINARY_OPERATION:
+                valid = adopt(a, isExpression) && adopt(b, isExpression) && c <= UINT8_MAX;
+                break;
+            case ASTNodeType::IDENTIFIER:
+                valid = a < symbolCount;
+                break;
+            case ASTNodeType::LITERAL_INT:
+                valid = a < ast.ints.size();
+                break;
+            case ASTNodeType::LITERAL_FLOAT:
+                valid = a < ast.floats.size();
+                break;
+            case ASTNodeType::LITERAL_STRING:
+                valid = a < ast.strings.size();
+                break;
+            case ASTNodeType::LITERAL_BOOL:
+                valid = a <= 1;
+                break;
+            case ASTNodeType::STRING_INTERPOLATION:
+                // Text parts alternate with identifiers: part, id, ..., part
+                valid = listFits(a, 2 * (uint64_t)b + 1);
+                for (uint32_t i = 0; valid && i <= b; i++) {
+                    valid = ast.lists[a + 2 * i] < ast.strings.size() &&
+                            (i == b || adopt(ast.lists[a + 2 * i + 1], isIdentifier));
+                }
+                break;
+            case ASTNodeType::ARRAY_DECLARATION:
+                valid = a < symbolCount && (b == NO_NODE || adopt(b, isArrayLiteral)) && c < ast.arrays.size();
+                break;
+            default:
+                valid = false;
+                break;
+        }
+
+        if (!valid || ast.offsets[id] > sourceSize) {
+            error = "corrupt AST image: bad node " + std::to_string(id);
+            return false;
+        }
+    }
+
+    if (count == 0 || ast.root != count - 1 || ast.kinds[ast.root] != ASTNodeType::PROGRAM) {
+        error = "corrupt AST image: no program root";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t ASTImage::hashSource(std::string_view source) {
+    return hashBytes(source).low;
+}
+
+std::string ASTImage::serialize(const FlatAST& ast, std::string_view source) {
+    Header header = {};
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.sourceHash = hashSource(source);
+    header.sourceSize = source.size();
+    header.root = ast.root;
+    header.sectionCount = SECTION_COUNT;
+
+    // Literal text and names share one table
+    std::string text;
+    std::vector<StringRecord> strings, symbols;
+    strings.reserve(ast.strings.size());
+    for (std::string_view value : ast.strings) strings.push_back(addText(text, value));
+    size_t symbolCount = ast.symbols ? ast.symbols->size() : 0;
+    symbols.reserve(symbolCount);
+    for (SymbolId id = 0; id < symbolCount; id++) symbols.push_back(addText(text, ast.symbols->name(id)));
+
+    std::vector<ArrayRecord> arrays;
+    arrays.reserve(ast.arrays.size());
+    for (const FlatArrayDecl& array : ast.arrays) {
+        arrays.push_back(ArrayRecord{array.size, (uint8_t)array.elementType, array.hasType, array.hasSize, {}});
+    }
+
+    std::string image(reinterpret_cast<const char*>(&header), sizeof(header));
+    image.reserve(sizeof(header) + ast.nodeCount() * 20 + ast.lists.size() * 4 + text.size() +
+                  (strings.size() + symbols.size()) * 8 + SECTION_COUNT * 8);
+    appendColumn(image, KINDS, ast.kinds);
+    appendColumn(image, OFFSETS, ast.offsets);
+    appendColumn(image, COLUMN_A, ast.a);
+    appendColumn(image, COLUMN_B, ast.b);
+    appendColumn(image, COLUMN_C, ast.c);
+    appendColumn(image, INTS, ast.ints);
+    appendColumn(image, FLOATS, ast.floats);
+    appendColumn(image, LISTS, ast.lists);
+    appendColumn(image, STRINGS, strings);
+    appendColumn(image, SYMBOLS, symbols);
+    appendColumn(image, ARRAYS, arrays);
+    appendSection(image, TEXT, text.data(), text.size());
+    return image;
+}
+
+bool ASTImage::write(const std::string& path, const FlatAST& ast, std::string_view source) {
+    std::string image = serialize(ast, source);
+    std::ofstream out(path, std::ios::binary);
+    return out && out.write(image.data(), (std::streamsize)image.size()) && out.flush();
+}
+
+bool ASTImage::open(const std::string& path, std::string& error) {
+    held.clear();
+    if (!file.open(path.c_str())) {
+        error = "could not read `" + path + "`";
+        return false;
+    }
+    image = file.view();
+    return check("`" + path + "`", error);
+}
+
+bool ASTImage::adopt(std::string bytes, std::string& error) {
+    file.close();
+    held = std::move(bytes);
+    image = held;
+    return check("cached image", error);
+}
+
+bool ASTImage::check(const std::string& name, std::string& error) {
+    if (image.size() < sizeof(Header) || std::memcmp(image.data(), IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0) {
+        error = name + " is not an AST image";
+        close();
+        return false;
+    }
+    Header header = readHeader(image);
+    if (header.version != VERSION || header.byteOrder != BYTE_ORDER_MARK || header.sectionCount != SECTION_COUNT) {
+        error = name + " is an AST image of another version or byte order";
+        close();
+        return false;
+    }
+    for (uint32_t section = 0; section < SECTION_COUNT; section++) {
+        const SectionRange& range = header.sections[section];
+        if (range.offset > image.size() || range.count > (image.size() - range.offset) / ELEMENT_SIZES[section]) {
+            error = name + " is a truncated AST image";
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ASTImage::close() {
+    file.close();
+    held.clear();
+    image = std::string_view();
+}
+
+bool ASTImage::load(FlatAST& ast, StringInterner& symbols, std::string& error) const {
+    if (image.size() < sizeof(Header) || symbols.size() != 0) {
+        error = "AST image loaded without being opened, or into a used interner";
+        return false;
+    }
+    Header header = readHeader(image);
+    const SectionRange* sections = header.sections;
+
+    size_t nodes = sections[KINDS].count;
+    for (Section column : {OFFSETS, COLUMN_A, COLUMN_B, COLUMN_C}) {
+        if (sections[column].count != nodes) {
+            error = "corrupt AST image: columns of different lengths";
+            return false;
+        }
+    }
+
+    ast = FlatAST();
+    copyColumn(image, sections[KINDS], ast.kinds);
+    copyColumn(image, sections[OFFSETS], ast.offsets);
+    copyColumn(image, sections[COLUMN_A], ast.a);
+    copyColumn(image, sections[COLUMN_B], ast.b);
+    copyColumn(image, sections[COLUMN_C], ast.c);
+    copyColumn(image, sections[INTS], ast.ints);
+    copyColumn(image, sections[FLOATS], ast.floats);
+    copyColumn(image, sections[LISTS], ast.lists);
+    ast.root = header.root;
+    ast.symbols = &symbols;
+
+    const char* text = image.data() + sections[TEXT].offset;
+    uint64_t textSize = sections[TEXT].count;
+    auto readText = [&](const char* record, std::string_view& value) {
+        StringRecord string;
+        std::memcpy(&string, record, sizeof(string));
+        if ((uint64_t)string.offset + string.length > textSize) return false;
+        value = std::string_view(text + string.offset, string.length);
+        return true;
+    };
+
+    const char* records = image.data() + sections[STRINGS].offset;
+    ast.strings.resize(sections[STRINGS].count);
+    for (size_t i = 0; i < ast.strings.size(); i++) {
+        if (!readText(records + i * sizeof(StringRecord), ast.strings[i])) {
+            error = "corrupt AST image: bad string " + std::to_string(i);
+            return false;
+        }
+    }
+
+    // Interning in id order gives every name its original id back
+    records = image.data() + sections[SYMBOLS].offset;
+    for (size_t i = 0; i < sections[SYMBOLS].count; i++) {
+        std::string_view name;
+        if (!readText(records + i * sizeof(StringRecord), name) || symbols.intern(name) != i) {
+            error = "corrupt AST image: bad symbol " + std::to_string(i);
+            return false;
+        }
+    }
+
+    records = image.data() + sections[ARRAYS].offset;
+    ast.arrays.reserve(sections[ARRAYS].count);
+    for (size_t i = 0; i < sections[ARRAYS].count; i++) {
+        ArrayRecord array;
+        std::memcpy(&array, records + i * sizeof(ArrayRecord), sizeof(array));
+        ast.arrays.push_back(FlatArrayDecl{(Token)array.elementType, array.hasType != 0, array.hasSize != 0, array.size});
+    }
+
+    return checkNodes(ast, symbols.size(), header.sourceSize, error);
+}
+
+uint64_t ASTImage::sourceHash() const {
+    return image.size() >= sizeof(Header) ? readHeader(image).sourceHash : 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "flat_ast.hpp"
+#include "interner.hpp"
+#include "source.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Binary form of a checked FlatAST that can be loaded back without the
+// front end. An image is one block: a fixed header, then one 8-byte aligned
+// section per FlatAST column and side table, then a string table holding
+// the literal text and the interned names. Every reference in it is an index
+// or an offset from the start of the image, so it is position independent
+// and is written with a single write and loaded from a read-only mapping.
+//
+//   header   magic "AWAST\0\0\0", version, byte order mark, source hash,
+//            root, section count, then {offset, count} per section
+//   kinds offsets a b c ints floats lists      raw columns (4 bytes each)
+//   strings symbols                            {offset, length} into text
+//   arrays                                     16-byte FlatArrayDecl records
+//   text                                       string bytes
+//
+// Loading copies the columns out with memcpy and interns the names in id
+// order, so SymbolIds come back unchanged; literal strings stay views into
+// the mapping. The image is checked before anything is used (node
+// references point at earlier rows, indices are in range), so a damaged or
+// foreign file is reported instead of being trusted.
+class ASTImage {
+private:
+    SourceBuffer file;         // a mapped image file
+    std::string held;          // or an image handed over in memory
+    std::string_view image;    // whichever of the two is open
+
+    bool check(const std::string& name, std::string& error);
+    void close();
+
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // Hash of the source an image was built from, for callers checking it
+    // still matches the file on disk
+    static uint64_t hashSource(std::string_view source);
+
+    static std::string serialize(const FlatAST& ast, std::string_view source);
+    static bool write(const std::string& path, const FlatAST& ast, std::string_view source);
+
+    // Maps an image file. Returns false, with a reason, if it cannot be read
+    // or is not a valid image of this version.
+    bool open(const std::string& path, std::string& error);
+
+    // Takes an image held in memory, such as one from the compile cache,
+    // and checks it like open()
+    bool adopt(std::string bytes, std::string& error);
+
+    // Fills `ast` and the empty `symbols` from the open image. Strings of
+    // `ast` point into the image, which must stay open as long as `ast` is used.
+    bool load(FlatAST& ast, StringInterner& symbols, std::string& error) const;
+
+    uint64_t sourceHash() const;
+};
@@ -0,0 +1,261 @@
+#include "cache.hpp"
+#include "source.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Bumped with any change to the entry layout or to what a compile writes
+// (IR formats, ASTImage::VERSION); where the executable cannot be hashed
+// it is all that tells builds apart
+constexpr uint32_t CACHE_VERSION = 2;
+
+// Identifies the compiler: CACHE_VERSION and, where the running executable
+// can be read, its hash. Rebuilding any part of the compiler then changes
+// every key, while a byte-identical rebuild keeps them.
+const std::string& compilerIdentity() {
+    static const std::string identity = [] {
+        std::string text = "awlang cache " + std::to_string(CACHE_VERSION);
+#ifdef __linux__
+        SourceBuffer executable;
+        if (executable.open("/proc/self/exe")) text += ' ' + hashBytes(executable.view()).hex();
+#endif
+        return text;
+    }();
+    return identity;
+}
+
+const char ENTRY_MAGIC[4] = {'A', 'W', 'C', '2'};
+const char* const ENTRY_EXTENSION = ".awc";
+
+const uint64_t P0 = 0xa0761d6478bd642full;
+const uint64_t P1 = 0xe7037ed1a0b428dbull;
+const uint64_t P2 = 0x8ebc6af09c88c6e3ull;
+const uint64_t P3 = 0x589965cc75374cc3ull;
+
+// Folds the full 128-bit product of a and b into 64 bits
+uint64_t mix(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t aHigh = a >> 32, aLow = static_cast<uint32_t>(a);
+    uint64_t bHigh = b >> 32, bLow = static_cast<uint32_t>(b);
+    uint64_t high = aHigh * bHigh, middle0 = aHigh * bLow, middle1 = aLow * bHigh, low = aLow * bLow;
+    uint64_t carry = ((low >> 32) + static_cast<uint32_t>(middle0) + static_cast<uint32_t>(middle1)) >> 32;
+    high += (middle0 >> 32) + (middle1 >> 32) + carry;
+    low += (middle0 << 32) + (middle1 << 32);
+    return low ^ high;
+#endif
+}
+
+uint64_t read64(const char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void writeRaw(std::string& out, uint64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeField(std::string& out, const std::string& field) {
+    writeRaw(out, field.size());
+    out += field;
+}
+
+// Reads from a whole entry file, failing on anything truncated
+struct EntryReader {
+    const std::string& data;
+    size_t position = 0;
+
+    bool raw(uint64_t& value) {
+        if (data.size() - position < sizeof(value)) return false;
+        std::memcpy(&value, data.data() + position, sizeof(value));
+        position += sizeof(value);
+        return true;
+    }
+
+    bool field(std::string& out) {
+        uint64_t length;
+        if (!raw(length) || data.size() - position < length) return false;
+        out.assign(data, position, length);
+        position += length;
+        return true;
+    }
+};
+
+} // namespace
+
+std::string CacheKey::hex() const {
+    char text[33];
+    std::snprintf(text, sizeof(text), "%016llx%016llx",
+                  static_cast<unsigned long long>(high), static_cast<unsigned long long>(low));
+    return text;
+}
+
+CacheKey hashBytes(std::string_view data, uint64_t seed) {
+    // Two independent lanes over the same 16-byte blocks
+    uint64_t low = seed ^ mix(seed ^ P0, P1);
+    uint64_t high = seed ^ mix(seed ^ P2, P3);
+    const char* p = data.data();
+    size_t remaining = data.size();
+    while (remaining > 16) {
+        uint64_t a = read64(p), b = read64(p + 8);
+        low = mix(a ^ P1, b ^ low);
+        high = mix(a ^ P3, b ^ high);
+        p += 16;
+        remaining -= 16;
+    }
+    // The last 1-16 bytes, zero padded; the length below keeps padding
+    // distinct from real zero bytes
+    char tail[16] = {};
+    std::memcpy(tail, p, remaining);
+    uint64_t a = read64(tail), b = read64(tail + 8);
+    uint64_t length = data.size();
+    low = mix(P1 ^ length, mix(a ^ P1, b ^ low));
+    high = mix(P3 ^ length, mix(a ^ P3, b ^ high));
+    return {low, high};
+}
+
+std::string CompilationCache::defaultDirectory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return std::string(xdg) + "/awlang";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::string(home) + "/.cache/awlang";
+    }
+    return ".awlang-cache";
+}
+
+CacheKey CompilationCache::key(std::string_view source, std::string_view context) {
+    std::string preamble = compilerIdentity();
+    preamble += '\0';
+    preamble += context;
+    return hashBytes(source, hashBytes(preamble).low);
+}
+
+std::string CompilationCache::entryPath(const CacheKey& key) const {
+    // Two-character fan-out keeps directories small with many entries
+    std::string name = key.hex();
+    return directory + "/" + name.substr(0, 2) + "/" + name + ENTRY_EXTENSION;
+}
+
+bool CompilationCache::load(const CacheKey& key, CacheEntry& entry) {
+    std::string path = entryPath(key);
+    std::ifstream file(path, std::ios::binary);
+    std::string data;
+    if (file) {
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        data = contents.str();
+    }
+
+    EntryReader reader{data};
+    uint64_t status, artifactCount;
+    bool valid = data.size() >= sizeof(ENTRY_MAGIC) &&
+                 std::memcmp(data.data(), ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0;
+    reader.position = sizeof(ENTRY_MAGIC);
+    valid = valid && reader.raw(status) && reader.field(entry.out) && reader.field(entry.err) &&
+            reader.raw(artifactCount) && artifactCount <= data.size();
+    if (valid) {
+        entry.status = static_cast<uint8_t>(status);
+        entry.artifacts.assign(artifactCount, std::string());
+        for (std::string& artifact : entry.artifacts) {
+            if (!(valid = reader.field(artifact))) break;
+        }
+    }
+    if (!valid) {
+        misses++;
+        return false;
+    }
+
+    // Marks the entry as recently used for eviction
+    std::error_code ignored;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ignored);
+    hits++;
+    return true;
+}
+
+void CompilationCache::store(const CacheKey& key, const CacheEntry& entry) {
+    std::string data(ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    writeRaw(data, entry.status);
+    writeField(data, entry.out);
+    writeField(data, entry.err);
+    writeRaw(data, entry.artifacts.size());
+    for (const std::string& artifact : entry.artifacts) writeField(data, artifact);
+
+    std::string path = entryPath(key);
+    std::error_code error;
+    fs::create_directories(fs::path(path).parent_path(), error);
+
+    // Unique per writer, so two compilers storing the same entry cannot
+    // interleave; the rename then replaces any older copy in one step
+    std::ostringstream temporary;
+    temporary << path << ".tmp" << std::hex << reinterpret_cast<uintptr_t>(&data) << '.'
+              << fs::file_time_type::clock::now().time_since_epoch().count();
+    {
+        std::ofstream file(temporary.str(), std::ios::binary);
+        if (!file || !file.write(data.data(), data.size())) {
+            file.close();
+            fs::remove(temporary.str(), error);
+            return;
+        }
+    }
+    fs::rename(temporary.str(), path, error);
+    if (error) {
+        fs::remove(temporary.str(), error);
+        return;
+    }
+    stores++;
+}
+
+void CompilationCache::evict() {
+    if (stores == 0) return;
+
+    struct Stored {
+        fs::path path;
+        fs::file_time_type used;
+        uint64_t size;
+    };
+    std::vector<Stored> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    for (fs::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        std::error_code entryError;
+        if (!it->is_regular_file(entryError) || it->path().extension() != ENTRY_EXTENSION) continue;
+        Stored stored{it->path(), it->last_write_time(entryError), it->file_size(entryError)};
+        // Removed by someone else in the meantime
+        if (entryError) continue;
+        total += stored.size;
+        entries.push_back(std::move(stored));
+    }
+    if (total <= sizeLimit) return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Stored& a, const Stored& b) { return a.used < b.used; });
+    uint64_t target = sizeLimit / 10 * 9;
+    for (const Stored& stored : entries) {
+        if (total <= target) break;
+        if (fs::remove(stored.path, error)) {
+            evictedEntries++;
+            evictedBytes += stored.size;
+        }
+        total -= stored.size;
+    }
+}
+
+std::string CompilationCache::report() const {
+    std::ostringstream out;
+    out << "cache: " << hits << " hits, " << misses << " misses, " << stores << " stored, "
+        << evictedEntries << " evicted (" << evictedBytes / 1024 << " KiB) in " << directory;
+    return out.str();
+}
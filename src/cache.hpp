@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 128-bit content hash (two wyhash-style 64-bit lanes with different
+// seeds): a few multiplies per 16 bytes, so hashing a tree of sources runs
+// at memory speed
+struct CacheKey {
+    uint64_t low;
+    uint64_t high;
+
+    std::string hex() const;
+};
+
+CacheKey hashBytes(std::string_view data, uint64_t seed = 0);
+
+// What a compile of one file printed and wrote: the exit status, its
+// stdout and stderr text (diagnostics included) and its artifacts: the
+// lexer IR, the checked tree as an ASTImage (the AST IR is dumped from it
+// again), the SSA IR and the bytecode IR
+struct CacheEntry {
+    uint8_t status = 0;
+    std::string out;
+    std::string err;
+    std::vector<std::string> artifacts;
+};
+
+// Persistent, content-addressed store of compile results. An entry's key
+// covers the source bytes, the compiler build, and everything else the
+// output depends on (flags, the file's name, the output names), so an
+// unchanged file is never compiled twice and a changed one can never get a
+// stale result. Entries are files under DIR/xx/ written to a temporary name
+// and renamed into place, so concurrent compilers (threads or processes)
+// sharing a directory never see half an entry. Reading one refreshes its
+// time; evict() removes the least recently used ones once the directory
+// outgrows its size limit.
+class CompilationCache {
+private:
+    std::string directory;
+    uint64_t sizeLimit;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> stores{0};
+    std::atomic<uint64_t> evictedEntries{0};
+    std::atomic<uint64_t> evictedBytes{0};
+
+    std::string entryPath(const CacheKey& key) const;
+
+public:
+    CompilationCache(std::string cacheDirectory, uint64_t maxBytes)
+        : directory(std::move(cacheDirectory)), sizeLimit(maxBytes) {}
+
+    // $XDG_CACHE_HOME/awlang, or ~/.cache/awlang
+    static std::string defaultDirectory();
+
+    // Key of `source` compiled under `context`, which must spell out every
+    // other input of the compile
+    static CacheKey key(std::string_view source, std::string_view context);
+
+    // Counts a hit or a miss
+    bool load(const CacheKey& key, CacheEntry& entry);
+    void store(const CacheKey& key, const CacheEntry& entry);
+
+    // Deletes least recently used entries until the cache is back under 90%
+    // of its limit. Only scans the directory if this process stored anything.
+    void evict();
+
+    // One line of counters, for --cache-stats
+    std::string report() const;
+};
@@ -0,0 +1,272 @@
+#include "codegen.hpp"
+#include "ir.hpp"
+
+namespace {
+
+constexpr int32_t MIN_IMMEDIATE = -(1 << 23);
+constexpr int32_t MAX_IMMEDIATE = (1 << 23) - 1;
+constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+// Net change of the stack height; ARRAY_NEW is accounted for by its caller
+int stackEffect(Op op) {
+    switch (op) {
+        case Op::PUSH_INT: case Op::PUSH_CONST: case Op::LOAD:
+            return 1;
+        case Op::INT_TO_FLOAT: case Op::INT_TO_STRING: case Op::FLOAT_TO_STRING: case Op::BOOL_TO_STRING:
+        case Op::ARRAY_NEW: case Op::ARRAY_CONST: case Op::WRITE_TEXT: case Op::WRITE_NEWLINE: case Op::HALT:
+            return 0;
+        default:
+            // Binary operators, STORE and the typed writes consume one value
+            return -1;
+    }
+}
+
+} // namespace
+
+std::string arrayAllocationError(uint64_t size) {
+    return "Out of memory for an array of " + std::to_string(size) + " items";
+}
+
+const char* Bytecode::opName(Op op) {
+    static const char* const names[] = {
+#define AW_OPCODE_NAME(name) #name,
+        AW_OPCODES(AW_OPCODE_NAME)
+#undef AW_OPCODE_NAME
+    };
+    return op < Op::OP_COUNT ? names[(int)op] : "???";
+}
+
+std::string Bytecode::toString() const {
+    std::string out;
+    out += "slots " + std::to_string(slotNames.size()) + ", constants " + std::to_string(constants.size()) +
+           ", strings " + std::to_string(strings.size()) + ", max stack " + std::to_string(maxStack) + "\n";
+
+    for (size_t pc = 0; pc < code.size(); pc++) {
+        uint32_t word = code[pc];
+        Op op = opcode(word);
+        out += std::to_string(pc) + "\t" + opName(op);
+
+        switch (op) {
+            case Op::PUSH_INT:
+                out += " " + std::to_string(immediate(word));
+                break;
+            case Op::PUSH_CONST: {
+                Value value = constants[argument(word)];
+                out += " #" + std::to_string(argument(word)) + " ";
+                switch (constantTypes[argument(word)]) {
+                    case ValueType::FLOAT_TYPE: out += std::to_string(value.f); break;
+                    case ValueType::STRING_TYPE: out += "\"" + std::string(strings[value.ref]) + "\""; break;
+                    default: out += std::to_string(value.i); break;
+                }
+                break;
+            }
+            case Op::LOAD: case Op::STORE:
+                out += " " + std::to_string(argument(word)) + " (" + std::string(slotNames[argument(word)]) + ")";
+                break;
+            case Op::WRITE_TEXT:
+                out += " \"" + std::string(strings[argument(word)]) + "\"";
+                break;
+            case Op::ARRAY_NEW:
+                out += " " + SemanticAnalyzer::valueTypeToString((ValueType)argument(word)) + " count " +
+                       std::to_string(code[pc + 1]) + " size " + std::to_string(wide(&code[pc + 2]));
+                break;
+            case Op::ARRAY_CONST:
+                out += " " + SemanticAnalyzer::valueTypeToString((ValueType)argument(word)) + " #" +
+                       std::to_string(code[pc + 1]) + " count " + std::to_string(code[pc + 2]) + " size " +
+                       std::to_string(wide(&code[pc + 3]));
+                break;
+            default:
+                break;
+        }
+        out += "\n";
+        pc += extraWords(op);
+    }
+    return out;
+}
+
+void BytecodeCompiler::compileProgram(const IRProgram& program, Bytecode& bytecode) {
+    ir = &program;
+    out = &bytecode;
+    depth = 0;
+    stringIds.clear();
+    for (auto& ids : constantIds) ids.clear();
+    bytecode = Bytecode();
+    // Handle 0 is the empty string, so zero-filled string arrays need no
+    // initialization
+    addString("");
+    uses = program.countUses();
+    slots.assign(program.values.size(), NO_SLOT);
+
+    // No control flow yet: the entry block is the whole program
+    for (IRValue value : program.blocks[0].instructions) {
+        compileInstruction(value);
+    }
+    emit(Op::HALT, 0, 0);
+}
+
+void BytecodeCompiler::emit(Op op, uint32_t arg, uint32_t offset) {
+    out->code.push_back(Bytecode::encode(op, arg));
+    out->offsets.push_back(offset);
+    depth += stackEffect(op);
+    if (depth > out->maxStack) out->maxStack = depth;
+}
+
+uint32_t BytecodeCompiler::addString(std::string_view text) {
+    auto it = stringIds.find(text);
+    if (it != stringIds.end()) {
+        return it->second;
+    }
+    uint32_t id = (uint32_t)out->strings.size();
+    out->strings.push_back(text);
+    stringIds.emplace(text, id);
+    return id;
+}
+
+// Identical literals share an entry
+uint32_t BytecodeCompiler::addConstant(Value value, ValueType type) {
+    auto [it, added] = constantIds[(int)type].try_emplace(value.ref, (uint32_t)out->constants.size());
+    if (added) {
+        out->constants.push_back(value);
+        out->constantTypes.push_back(type);
+    }
+    return it->second;
+}
+
+// A CONST as a pool value: strings become Bytecode string ids
+Value BytecodeCompiler::constantValue(IRValue value) {
+    const IRInstruction& instr = ir->values[value];
+    Value constant;
+    constant.ref = instr.bits;
+    if (instr.type == ValueType::STRING_TYPE) {
+        constant.ref = addString(ir->strings[constant.ref]);
+    }
+    return constant;
+}
+
+bool BytecodeCompiler::needsSlot(IRValue value) const {
+    const IRInstruction& instr = ir->values[value];
+    if (instr.kind == IROp::CONST) return false;
+    return instr.kind == IROp::COPY || instr.kind == IROp::ARRAY_NEW || uses[value] > 1 || ir->hasSideEffects(value);
+}
+
+bool BytecodeCompiler::isConstantArray(IRValue value) const {
+    const IRInstruction& instr = ir->values[value];
+    if (instr.kind != IROp::ARRAY_NEW || instr.operandCount == 0) return false;
+    for (uint32_t i = 0; i < instr.operandCount; i++) {
+        if (ir->values[ir->operand(value, i)].kind != IROp::CONST) return false;
+    }
+    return true;
+}
+
+void BytecodeCompiler::compileInstruction(IRValue value) {
+    const IRInstruction& instr = ir->values[value];
+    switch (instr.kind) {
+        case IROp::NOP:
+            return;
+        case IROp::WRITE_TEXT:
+            emit(Op::WRITE_TEXT, addString(ir->strings[instr.bits]), instr.offset);
+            return;
+        case IROp::WRITE_NEWLINE:
+            emit(Op::WRITE_NEWLINE, 0, instr.offset);
+            return;
+        case IROp::WRITE:
+            compileValue(ir->operand(value, 0));
+            emit(instr.op, 0, instr.offset);
+            return;
+        default:
+            break;
+    }
+
+    // Everything else is computed at its single use, unless it needs a slot
+    if (!needsSlot(value)) return;
+
+    compileValue(value);
+    uint32_t slot = (uint32_t)out->slotNames.size();
+    if (instr.variable != NO_VARIABLE) {
+        out->slotNames.emplace_back(ir->variables[instr.variable].name);
+    } else {
+        out->slotNames.push_back("%" + std::to_string(value));
+    }
+    emit(Op::STORE, slot, instr.offset);
+    slots[value] = slot;
+}
+
+// Pushes a value: loaded from its slot, pushed as a constant, or computed
+// from its operands. Operand trees can be as deep as the source
+// expressions, so they are walked with an explicit stack.
+void BytecodeCompiler::compileValue(IRValue value) {
+    size_t base = walkStack.size();
+    walkStack.push_back(PendingValue{value, 0});
+
+    while (walkStack.size() > base) {
+        PendingValue& top = walkStack.back();
+        IRValue current = top.value;
+        const IRInstruction& instr = ir->values[current];
+
+        if (slots[current] != NO_SLOT) {
+            walkStack.pop_back();
+            emit(Op::LOAD, slots[current], instr.offset);
+        } else if (instr.kind == IROp::CONST) {
+            walkStack.pop_back();
+            compileConstant(current);
+        } else if (top.operandsDone < instr.operandCount && !isConstantArray(current)) {
+            IRValue operand = ir->operand(current, top.operandsDone++);
+            walkStack.push_back(PendingValue{operand, 0});
+        } else {
+            walkStack.pop_back();
+            compileOperation(current);
+        }
+    }
+}
+
+void BytecodeCompiler::compileConstant(IRValue value) {
+    const IRInstruction& instr = ir->values[value];
+    Value constant = constantValue(value);
+    bool isInt = instr.type == ValueType::INT_TYPE || instr.type == ValueType::BOOL_TYPE;
+    if (isInt && constant.i >= MIN_IMMEDIATE && constant.i <= MAX_IMMEDIATE) {
+        emit(Op::PUSH_INT, (uint32_t)constant.i & 0xFFFFFF, instr.offset);
+        return;
+    }
+    emit(Op::PUSH_CONST, addConstant(constant, instr.type), instr.offset);
+}
+
+// The operands are on the stack
+void BytecodeCompiler::compileOperation(IRValue value) {
+    const IRInstruction& instr = ir->values[value];
+    switch (instr.kind) {
+        case IROp::BINARY: case IROp::CONVERT:
+            emit(instr.op, 0, instr.offset);
+            break;
+
+        case IROp::ARRAY_NEW: {
+            // Constant initializers are appended to the pool as one block,
+            // unshared, so they can be copied in one go
+            uint64_t size = arraySize(instr.bits);
+            std::vector<uint32_t> words;
+            if (isConstantArray(value)) {
+                emit(Op::ARRAY_CONST, (uint32_t)arrayElementType(instr.bits), instr.offset);
+                words.push_back((uint32_t)out->constants.size());
+                for (uint32_t i = 0; i < instr.operandCount; i++) {
+                    out->constants.push_back(constantValue(ir->operand(value, i)));
+                    out->constantTypes.push_back(arrayElementType(instr.bits));
+                }
+            } else {
+                emit(Op::ARRAY_NEW, (uint32_t)arrayElementType(instr.bits), instr.offset);
+                depth -= instr.operandCount;
+            }
+            words.insert(words.end(), {instr.operandCount, (uint32_t)size, (uint32_t)(size >> 32)});
+            for (uint32_t word : words) {
+                out->code.push_back(word);
+                out->offsets.push_back(instr.offset);
+            }
+            depth++;
+            if (depth > out->maxStack) out->maxStack = depth;
+            break;
+        }
+
+        default:
+            // COPY is the value itself; PHIs need control flow, which the
+            // bytecode does not have yet
+            break;
+    }
+}
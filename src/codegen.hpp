@@ -0,0 +1,135 @@
+#pragma once
+#include "semantic.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Opcodes of the stack machine. Suffixes name the operand kind: _I for int
+// and bool (stored as 0/1), _F for float, _S for string handles.
+//
+//   PUSH_INT       arg = signed 24-bit immediate
+//   PUSH_CONST     arg = index into Bytecode::constants
+//   LOAD / STORE   arg = variable slot
+//   WRITE_TEXT     arg = index into Bytecode::strings
+//   ARRAY_NEW      arg = element ValueType, followed by three raw words: the
+//                  number of initializers popped from the stack and the
+//                  64-bit array size (>= the initializer count), low half
+//                  first
+//   ARRAY_CONST    ARRAY_NEW whose initializers are all constants: arg =
+//                  element ValueType, followed by four raw words: the first
+//                  of the initializers, which are consecutive entries in
+//                  Bytecode::constants, their count and the 64-bit size
+//
+// Every other opcode has no argument.
+#define AW_OPCODES(X) \
+    X(PUSH_INT) X(PUSH_CONST) X(LOAD) X(STORE) \
+    X(ADD_I) X(SUB_I) X(MUL_I) X(DIV_I) X(MOD_I) \
+    X(ADD_F) X(SUB_F) X(MUL_F) X(DIV_F) X(MOD_F) \
+    X(EQ_I) X(NE_I) X(LT_I) X(LE_I) X(GT_I) X(GE_I) \
+    X(EQ_F) X(NE_F) X(LT_F) X(LE_F) X(GT_F) X(GE_F) \
+    X(EQ_S) X(NE_S) X(LT_S) X(LE_S) X(GT_S) X(GE_S) \
+    X(INT_TO_FLOAT) X(INT_TO_STRING) X(FLOAT_TO_STRING) X(BOOL_TO_STRING) X(CONCAT) \
+    X(ARRAY_NEW) X(ARRAY_CONST) \
+    X(WRITE_TEXT) X(WRITE_INT) X(WRITE_FLOAT) X(WRITE_BOOL) X(WRITE_STRING) X(WRITE_ARRAY) \
+    X(WRITE_NEWLINE) X(HALT)
+
+enum class Op : uint8_t {
+#define AW_OPCODE_ENUM(name) name,
+    AW_OPCODES(AW_OPCODE_ENUM)
+#undef AW_OPCODE_ENUM
+    OP_COUNT
+};
+
+// Arrays of at least LAZY_ARRAY_ITEMS items are backed by anonymous mmap
+// pages that the kernel zeroes on first touch, so declaring one costs
+// nothing until it is used; smaller ones are static data in the executable
+// backends and come from an arena in the VM. Declarations above
+// MAX_ARRAY_ITEMS are rejected, which keeps every array's byte size far
+// from overflowing.
+constexpr uint64_t LAZY_ARRAY_ITEMS = 64 * 1024;
+constexpr uint64_t MAX_ARRAY_ITEMS = 1ull << 40;
+
+// Runtime error of every backend when an array's memory cannot be mapped
+std::string arrayAllocationError(uint64_t size);
+
+// One VM cell. Strings and arrays are handles into the VM's heap; string
+// constants are the indices of Bytecode::strings.
+union Value {
+    int64_t i;
+    double f;
+    uint64_t ref;
+};
+
+// Compiled program. Instructions are 32-bit words with the opcode in the low
+// 8 bits and the argument in the upper 24.
+struct Bytecode {
+    std::vector<uint32_t> code;
+    std::vector<uint32_t> offsets;            // source byte offset of each code word
+    std::vector<Value> constants;
+    std::vector<ValueType> constantTypes;     // parallel to constants
+    std::vector<std::string_view> strings;    // text parts and string literals; 0 is always ""
+    std::vector<std::string> slotNames;       // one per slot: the variable, or %<IR value> for a temporary
+    uint32_t maxStack = 0;
+
+    static uint32_t encode(Op op, uint32_t arg = 0) { return (uint32_t)op | (arg << 8); }
+    static Op opcode(uint32_t word) { return (Op)(word & 0xFF); }
+    static uint32_t argument(uint32_t word) { return word >> 8; }
+    static int32_t immediate(uint32_t word) { return (int32_t)word >> 8; }
+    static uint64_t wide(const uint32_t* words) { return words[0] | (uint64_t)words[1] << 32; }
+
+    // Raw words following an instruction
+    static uint32_t extraWords(Op op) {
+        return op == Op::ARRAY_NEW ? 3 : op == Op::ARRAY_CONST ? 4 : 0;
+    }
+    static const char* opName(Op op);
+
+    // Disassembly used for the bytecode IR file
+    std::string toString() const;
+};
+
+struct IRProgram;
+
+// Generates Bytecode from an optimized IRProgram. Values with a single use
+// are computed right where they are used, so expressions come out in stack
+// order like the tree they came from; values that are used more than once,
+// bound to a variable, or that must happen at their place in the program
+// (divisions that can fail) are stored to a slot when they are computed and
+// loaded at each use. Constants are pushed at every use, except that the
+// initializers of an array that are all constants become one block of the
+// constant pool (ARRAY_CONST).
+class BytecodeCompiler {
+private:
+    // Value being emitted by compileValue's explicit stack
+    struct PendingValue {
+        uint32_t value;
+        uint32_t operandsDone;
+    };
+
+    const IRProgram* ir = nullptr;
+    Bytecode* out = nullptr;
+    std::vector<uint32_t> uses;   // per IR value
+    std::vector<uint32_t> slots;  // IR value -> slot, or UINT32_MAX
+    std::unordered_map<std::string_view, uint32_t> stringIds;
+    std::unordered_map<uint64_t, uint32_t> constantIds[(int)ValueType::UNKNOWN_TYPE];
+    std::vector<PendingValue> walkStack;
+    uint32_t depth = 0;
+
+    void emit(Op op, uint32_t arg, uint32_t offset);
+    uint32_t addString(std::string_view text);
+    uint32_t addConstant(Value value, ValueType type);
+    Value constantValue(uint32_t value);
+
+    bool needsSlot(uint32_t value) const;
+    bool isConstantArray(uint32_t value) const;
+    void compileInstruction(uint32_t value);
+    void compileValue(uint32_t value);
+    void compileConstant(uint32_t value);
+    void compileOperation(uint32_t value);
+
+public:
+    // The Bytecode's strings may view into the IRProgram, which has to
+    // outlive it
+    void compileProgram(const IRProgram& program, Bytecode& bytecode);
+};
@@ -1,29 +1,16 @@
 #include "error.hpp"
-#include <sstream>
 #include <algorithm>
 
-// Global error handler instance
-ErrorHandler g_errorHandler;
-
-// Function to get error handler instance (safer than global)
-ErrorHandler& getErrorHandler() {
-    return g_errorHandler;
-}
-
-void ErrorHandler::setSourceContent(const std::string& content, const std::string& filename) {
+void ErrorHandler::setSourceContent(std::string_view content, const std::string& filename) {
     currentFilename = filename;
-    sourceLines.clear();
-    
-    std::istringstream stream(content);
-    std::string line;
-    while (std::getline(stream, line)) {
-        sourceLines.push_back(line);
-    }
+    lines.build(content);
 }
 
-void ErrorHandler::addError(ErrorType type, const std::string& message, int line, int column, 
-                           const std::string& suggestion, int endColumn) {
-    errors.emplace_back(type, message, line, column, currentFilename, suggestion, endColumn);
+void ErrorHandler::addError(ErrorType type, const std::string& message, uint32_t offset, 
+                           const std::string& suggestion, uint32_t length) {
+    SourceLocation location = lines.locate(offset);
+    int endColumn = location.column + (int)(length > 0 ? length : 1) - 1;
+    errors.emplace_back(type, message, location.line, location.column, currentFilename, suggestion, endColumn);
     
     if (type == ErrorType::WARNING) {
         hasWarnings = true;
@@ -32,24 +19,34 @@ void ErrorHandler::addError(ErrorType type, const std::string& message, int line
     }
 }
 
-void ErrorHandler::addLexicalError(const std::string& message, int line, int column, 
-                                  const std::string& suggestion, int endColumn) {
-    addError(ErrorType::LEXICAL_ERROR, message, line, column, suggestion, endColumn);
+void ErrorHandler::addLexicalError(const std::string& message, uint32_t offset, 
+                                  const std::string& suggestion, uint32_t length) {
+    addError(ErrorType::LEXICAL_ERROR, message, offset, suggestion, length);
+}
+
+void ErrorHandler::addSyntaxError(const std::string& message, uint32_t offset, 
+                                 const std::string& suggestion, uint32_t length) {
+    addError(ErrorType::SYNTAX_ERROR, message, offset, suggestion, length);
 }
 
-void ErrorHandler::addSyntaxError(const std::string& message, int line, int column, 
-                                 const std::string& suggestion, int endColumn) {
-    addError(ErrorType::SYNTAX_ERROR, message, line, column, suggestion, endColumn);
+void ErrorHandler::addSemanticError(const std::string& message, uint32_t offset, 
+                                   const std::string& suggestion, uint32_t length) {
+    addError(ErrorType::SEMANTIC_ERROR, message, offset, suggestion, length);
 }
 
-void ErrorHandler::addSemanticError(const std::string& message, int line, int column, 
-                                   const std::string& suggestion, int endColumn) {
-    addError(ErrorType::SEMANTIC_ERROR, message, line, column, suggestion, endColumn);
+void ErrorHandler::addCodegenError(const std::string& message, uint32_t offset, 
+                                  const std::string& suggestion, uint32_t length) {
+    addError(ErrorType::CODEGEN_ERROR, message, offset, suggestion, length);
 }
 
-void ErrorHandler::addWarning(const std::string& message, int line, int column, 
-                             const std::string& suggestion, int endColumn) {
-    addError(ErrorType::WARNING, message, line, column, suggestion, endColumn);
+void ErrorHandler::addRuntimeError(const std::string& message, uint32_t offset, 
+                                  const std::string& suggestion, uint32_t length) {
+    addError(ErrorType::RUNTIME_ERROR, message, offset, suggestion, length);
+}
+
+void ErrorHandler::addWarning(const std::string& message, uint32_t offset, 
+                             const std::string& suggestion, uint32_t length) {
+    addError(ErrorType::WARNING, message, offset, suggestion, length);
 }
 
 std::string ErrorHandler::getErrorTypeString(ErrorType type) const {
@@ -58,6 +55,7 @@ std::string ErrorHandler::getErrorTypeString(ErrorType type) const {
         case ErrorType::SYNTAX_ERROR: return "syntax error";
         case ErrorType::SEMANTIC_ERROR: return "semantic error";
         case ErrorType::CODEGEN_ERROR: return "codegen error";
+        case ErrorType::RUNTIME_ERROR: return "runtime error";
         case ErrorType::WARNING: return "warning";
         default: return "unknown error";
     }
@@ -69,37 +67,39 @@ std::string ErrorHandler::getErrorTypeColor(ErrorType type) const {
         case ErrorType::SYNTAX_ERROR: return Colors::RED;
         case ErrorType::SEMANTIC_ERROR: return Colors::RED;
         case ErrorType::CODEGEN_ERROR: return Colors::MAGENTA;
+        case ErrorType::RUNTIME_ERROR: return Colors::RED;
         case ErrorType::WARNING: return Colors::YELLOW;
         default: return Colors::RED;
     }
 }
 
-void ErrorHandler::printErrorHeader(const CompilerError& error) const {
+void ErrorHandler::printErrorHeader(std::ostream& out, const CompilerError& error) const {
     std::string errorLabel = (error.type == ErrorType::WARNING) ? "warning" : "error";
     
-    std::cerr << Colors::BOLD << getErrorTypeColor(error.type) << errorLabel << Colors::RESET 
+    out << Colors::BOLD << getErrorTypeColor(error.type) << errorLabel << Colors::RESET 
               << Colors::BOLD << ": " << Colors::RESET << error.message << std::endl;
     
-    std::cerr << Colors::BLUE << "  --> " << Colors::RESET;
+    out << Colors::BLUE << "  --> " << Colors::RESET;
     if (!error.filename.empty()) {
-        std::cerr << error.filename << ":";
+        out << error.filename << ":";
     }
-    std::cerr << error.line << ":" << error.column << std::endl;
+    out << error.line << ":" << error.column << std::endl;
 }
 
-void ErrorHandler::printSourceContext(const CompilerError& error) const {
-    if (sourceLines.empty() || error.line < 1 || error.line > (int)sourceLines.size()) {
+void ErrorHandler::printSourceContext(std::ostream& out, const CompilerError& error) const {
+    int lineCount = (int)lines.lineCount();
+    if (lineCount == 0 || error.line < 1 || error.line > lineCount) {
         return;
     }
     
     int lineNum = error.line;
     int startLine = std::max(1, lineNum - 2);
-    int endLine = std::min((int)sourceLines.size(), lineNum + 2);
+    int endLine = std::min(lineCount, lineNum + 2);
     
     // Calculate padding for line numbers
     int maxLineNumWidth = std::to_string(endLine).length();
     
-    std::cerr << Colors::BLUE << std::string(maxLineNumWidth + 1, ' ') << " |" << Colors::RESET << std::endl;
+    out << Colors::BLUE << std::string(maxLineNumWidth + 1, ' ') << " |" << Colors::RESET << std::endl;
     
     // Print context lines
     for (int i = startLine; i <= endLine; i++) {
@@ -109,97 +109,109 @@ void ErrorHandler::printSourceContext(const CompilerError& error) const {
                                 " | " + Colors::RESET;
         
         if (isErrorLine) {
-            std::cerr << linePrefix << sourceLines[i - 1] << std::endl;
+            out << linePrefix << lines.lineText(i) << std::endl;
             
             // Print error indicator
-            std::cerr << Colors::BLUE << std::string(maxLineNumWidth + 1, ' ') << " | " << Colors::RESET;
+            out << Colors::BLUE << std::string(maxLineNumWidth + 1, ' ') << " | " << Colors::RESET;
             
             // Add spaces to align with error column
             for (int j = 1; j < error.column; j++) {
-                std::cerr << " ";
+                out << " ";
             }
             
             // Print error indicator
-            std::cerr << Colors::RED << Colors::BOLD;
+            out << Colors::RED << Colors::BOLD;
             if (error.endColumn > error.column) {
                 // Multi-character error
                 for (int j = error.column; j <= error.endColumn; j++) {
-                    std::cerr << "^";
+                    out << "^";
                 }
             } else {
-                std::cerr << "^";
+                out << "^";
             }
-            std::cerr << Colors::RESET << std::endl;
+            out << Colors::RESET << std::endl;
         } else {
-            std::cerr << linePrefix << sourceLines[i - 1] << std::endl;
+            out << linePrefix << lines.lineText(i) << std::endl;
         }
     }
     
-    std::cerr << Colors::BLUE << std::string(maxLineNumWidth + 1, ' ') << " |" << Colors::RESET << std::endl;
+    out << Colors::BLUE << std::string(maxLineNumWidth + 1, ' ') << " |" << Colors::RESET << std::endl;
 }
 
-void ErrorHandler::printSuggestion(const CompilerError& error) const {
+void ErrorHandler::printSuggestion(std::ostream& out, const CompilerError& error) const {
     if (!error.suggestion.empty()) {
-        std::cerr << Colors::GREEN << Colors::BOLD << "help: " << Colors::RESET 
+        out << Colors::GREEN << Colors::BOLD << "help: " << Colors::RESET 
                   << Colors::GREEN << error.suggestion << Colors::RESET << std::endl;
     }
 }
 
-void ErrorHandler::printErrors() const {
+void ErrorHandler::printErrors(std::ostream& out) const {
     if (errors.empty()) return;
     
-    std::cerr << std::endl;
+    out << std::endl;
     
     for (size_t i = 0; i < errors.size(); i++) {
         const auto& error = errors[i];
         
-        printErrorHeader(error);
-        printSourceContext(error);
-        printSuggestion(error);
+        printErrorHeader(out, error);
+        printSourceContext(out, error);
+        printSuggestion(out, error);
         
         // Add spacing between errors (except for the last one)
         if (i < errors.size() - 1) {
-            std::cerr << std::endl;
+            out << std::endl;
         }
     }
     
     // Print summary
-    std::cerr << std::endl;
+    out << std::endl;
     
     size_t errorCount = getErrorCount();
     size_t warningCount = getWarningCount();
     
-    if (errorCount > 0) {
-        std::cerr << Colors::RED << Colors::BOLD << "error" << Colors::RESET << ": could not compile `";
+    bool runtimeFailure = std::any_of(errors.begin(), errors.end(), [](const CompilerError& error) {
+        return error.type == ErrorType::RUNTIME_ERROR;
+    });
+    
+    if (runtimeFailure) {
+        out << Colors::RED << Colors::BOLD << "error" << Colors::RESET << ": `";
+        if (!currentFilename.empty()) {
+            out << currentFilename;
+        } else {
+            out << "input";
+        }
+        out << "` stopped on a runtime error" << std::endl;
+    } else if (errorCount > 0) {
+        out << Colors::RED << Colors::BOLD << "error" << Colors::RESET << ": could not compile `";
         if (!currentFilename.empty()) {
-            std::cerr << currentFilename;
+            out << currentFilename;
         } else {
-            std::cerr << "input";
+            out << "input";
         }
-        std::cerr << "` due to " << errorCount << " previous error";
-        if (errorCount > 1) std::cerr << "s";
+        out << "` due to " << errorCount << " previous error";
+        if (errorCount > 1) out << "s";
         
         if (warningCount > 0) {
-            std::cerr << " and " << warningCount << " warning";
-            if (warningCount > 1) std::cerr << "s";
+            out << " and " << warningCount << " warning";
+            if (warningCount > 1) out << "s";
         }
-        std::cerr << std::endl;
+        out << std::endl;
     } else if (warningCount > 0) {
-        std::cerr << Colors::YELLOW << Colors::BOLD << "warning" << Colors::RESET << ": `";
+        out << Colors::YELLOW << Colors::BOLD << "warning" << Colors::RESET << ": `";
         if (!currentFilename.empty()) {
-            std::cerr << currentFilename;
+            out << currentFilename;
         } else {
-            std::cerr << "input";
+            out << "input";
         }
-        std::cerr << "` compiled with " << warningCount << " warning";
-        if (warningCount > 1) std::cerr << "s";
-        std::cerr << std::endl;
+        out << "` compiled with " << warningCount << " warning";
+        if (warningCount > 1) out << "s";
+        out << std::endl;
     }
 }
 
 void ErrorHandler::clear() {
     errors.clear();
-    sourceLines.clear();
+    lines = LineTable();
     currentFilename.clear();
     hasErrors = false;
     hasWarnings = false;
@@ -1,5 +1,7 @@
 #pragma once
+#include "lines.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 
@@ -8,6 +10,7 @@ enum class ErrorType {
     SYNTAX_ERROR,
     SEMANTIC_ERROR,
     CODEGEN_ERROR,
+    RUNTIME_ERROR,
     WARNING
 };
 
@@ -47,45 +50,50 @@ namespace Colors {
 class ErrorHandler {
 private:
     std::vector<CompilerError> errors;
-    std::vector<std::string> sourceLines;  // Store source lines for context
+    LineTable lines;  // Resolves byte offsets to line/column and source context
     std::string currentFilename;
     bool hasErrors;
     bool hasWarnings;
     
-    void printErrorHeader(const CompilerError& error) const;
-    void printSourceContext(const CompilerError& error) const;
-    void printSuggestion(const CompilerError& error) const;
+    void printErrorHeader(std::ostream& out, const CompilerError& error) const;
+    void printSourceContext(std::ostream& out, const CompilerError& error) const;
+    void printSuggestion(std::ostream& out, const CompilerError& error) const;
     std::string getErrorTypeString(ErrorType type) const;
     std::string getErrorTypeColor(ErrorType type) const;
     
 public:
     ErrorHandler() : hasErrors(false), hasWarnings(false) {}
     
-    void setSourceContent(const std::string& content, const std::string& filename);
-    void addError(ErrorType type, const std::string& message, int line, int column, 
-                  const std::string& suggestion = "", int endColumn = -1);
-    void addLexicalError(const std::string& message, int line, int column, 
-                        const std::string& suggestion = "", int endColumn = -1);
-    void addSyntaxError(const std::string& message, int line, int column, 
-                       const std::string& suggestion = "", int endColumn = -1);
-    void addSemanticError(const std::string& message, int line, int column, 
-                         const std::string& suggestion = "", int endColumn = -1);
-    void addWarning(const std::string& message, int line, int column, 
-                   const std::string& suggestion = "", int endColumn = -1);
+    // The content is not copied and must outlive the handler's errors
+    void setSourceContent(std::string_view content, const std::string& filename);
+    SourceLocation locate(uint32_t offset) const { return lines.locate(offset); }
+
+    // Diagnostics are reported at a byte offset into the source; `length`
+    // bytes starting there are underlined
+    void addError(ErrorType type, const std::string& message, uint32_t offset, 
+                  const std::string& suggestion = "", uint32_t length = 1);
+    void addLexicalError(const std::string& message, uint32_t offset, 
+                        const std::string& suggestion = "", uint32_t length = 1);
+    void addSyntaxError(const std::string& message, uint32_t offset, 
+                       const std::string& suggestion = "", uint32_t length = 1);
+    void addSemanticError(const std::string& message, uint32_t offset, 
+                         const std::string& suggestion = "", uint32_t length = 1);
+    void addCodegenError(const std::string& message, uint32_t offset, 
+                        const std::string& suggestion = "", uint32_t length = 1);
+    void addRuntimeError(const std::string& message, uint32_t offset, 
+                        const std::string& suggestion = "", uint32_t length = 1);
+    void addWarning(const std::string& message, uint32_t offset, 
+                   const std::string& suggestion = "", uint32_t length = 1);
     
     bool hasAnyErrors() const { return hasErrors; }
     bool hasAnyWarnings() const { return hasWarnings; }
     size_t getErrorCount() const;
     size_t getWarningCount() const;
     
-    void printErrors() const;
+    // Diagnostics and the summary line go to `out` (stderr unless the
+    // caller collects them)
+    void printErrors(std::ostream& out = std::cerr) const;
     void clear();
     
     const std::vector<CompilerError>& getErrors() const { return errors; }
 };
-
-// Global error handler instance
-extern ErrorHandler g_errorHandler;
-
-// Function to get error handler instance (safer than global)
-ErrorHandler& getErrorHandler();
\ No newline at end of file
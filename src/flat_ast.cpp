@@ -0,0 +1,196 @@
+#include "flat_ast.hpp"
+
+NodeId FlatAST::addNode(ASTNodeType kind, uint32_t offset, uint32_t opA, uint32_t opB, uint32_t opC) {
+    kinds.push_back(kind);
+    offsets.push_back(offset);
+    a.push_back(opA);
+    b.push_back(opB);
+    c.push_back(opC);
+    return (NodeId)(kinds.size() - 1);
+}
+
+uint32_t FlatAST::addString(std::string_view text) {
+    strings.push_back(text);
+    return (uint32_t)(strings.size() - 1);
+}
+
+void FlatAST::clear() {
+    kinds.clear();
+    offsets.clear();
+    a.clear();
+    b.clear();
+    c.clear();
+    ints.clear();
+    floats.clear();
+    strings.clear();
+    lists.clear();
+    arrays.clear();
+    root = NO_NODE;
+    symbols = nullptr;
+}
+
+namespace {
+
+constexpr int MAX_DUMP_INDENT = 64;
+
+} // namespace
+
+std::string FlatAST::toString(NodeId node, int indent) const {
+    std::string out;
+    out.reserve(1024); // pre-reserve to reduce reallocs for medium trees
+    buildString(node, indent, out);
+    return out;
+}
+
+// the worker that actually builds the string. Children are emitted from an
+// explicit work stack rather than by recursion, because operator chains can
+// nest arbitrarily deep.
+void FlatAST::buildString(NodeId node, int indent, std::string &out) const {
+    std::vector<std::pair<NodeId, int>> work;
+    work.emplace_back(node, indent);
+    while (!work.empty()) {
+        auto [next, nextIndent] = work.back();
+        work.pop_back();
+        appendNode(next, nextIndent, out, work);
+    }
+}
+
+// Prints one node and queues its children (pushed in reverse so they come out in order)
+void FlatAST::appendNode(NodeId node, int indent, std::string &out,
+                         std::vector<std::pair<NodeId, int>> &work) const {
+    if (node == NO_NODE) return;
+
+    // indentation: two spaces per indent level. Past MAX_DUMP_INDENT the
+    // depth is written out instead, so deep operator chains do not make the
+    // dump quadratic in size.
+    if (indent <= MAX_DUMP_INDENT) {
+        out.append(static_cast<size_t>(indent) * 2, ' ');
+    } else {
+        out.append(static_cast<size_t>(MAX_DUMP_INDENT) * 2, ' ');
+        out += "@" + std::to_string(indent) + " ";
+    }
+
+    // node type name
+    out += ASTParser::astTypeToString(kinds[node]);
+
+    switch (kinds[node]) {
+        case ASTNodeType::PROGRAM: {
+            out += " (" + std::to_string(listSize(node)) + " statements)\n";
+            for (size_t i = listSize(node); i-- > 0;) {
+                work.emplace_back(listItem(node, i), indent + 1);
+            }
+            break;
+        }
+
+        case ASTNodeType::VARIABLE_DECLARATION: {
+            out += " '";
+            out += name(node);
+            out += "' type=";
+            out += LexerEngine::tokenTypeToString((Token)c[node]);
+            out += '\n';
+            work.emplace_back(b[node], indent + 1);
+            break;
+        }
+
+        case ASTNodeType::STDOUT_STATEMENT: {
+            out += '\n';
+            work.emplace_back(a[node], indent + 1);
+            break;
+        }
+
+        case ASTNodeType::STRING_INTERPOLATION: {
+            // Interpolated expressions are plain identifiers, so recursing is fine here
+            size_t expressionCount = listSize(node);
+            out += " [" + std::to_string(expressionCount + 1) + " parts, "
+                        + std::to_string(expressionCount) + " expressions]\n";
+
+            for (size_t i = 0; i <= expressionCount; ++i) {
+                out.append(static_cast<size_t>(indent + 1) * 2, ' ');
+                out += "TEXT_PART \"";
+                out += interpolationPart(node, i);
+                out += "\"\n";
+                if (i < expressionCount) {
+                    buildString(interpolationExpression(node, i), indent + 1, out);
+                }
+            }
+            break;
+        }
+
+        case ASTNodeType::BINARY_OPERATION: {
+            out += " ";
+            out += LexerEngine::tokenTypeToString((Token)c[node]);
+            out += '\n';
+            work.emplace_back(b[node], indent + 1);
+            work.emplace_back(a[node], indent + 1);
+            break;
+        }
+
+        case ASTNodeType::IDENTIFIER: {
+            out += " '";
+            out += name(node);
+            out += "'\n";
+            break;
+        }
+
+        case ASTNodeType::LITERAL_INT: {
+            out += " ";
+            out += std::to_string(ints[a[node]]);
+            out += '\n';
+            break;
+        }
+
+        case ASTNodeType::LITERAL_FLOAT: {
+            out += " ";
+            out += std::to_string(floats[a[node]]);
+            out += '\n';
+            break;
+        }
+
+        case ASTNodeType::LITERAL_STRING: {
+            out += " \"";
+            out += strings[a[node]];
+            out += "\"\n";
+            break;
+        }
+
+        case ASTNodeType::LITERAL_BOOL: {
+            out += " ";
+            out += (a[node] ? "true" : "false");
+            out += '\n';
+            break;
+        }
+
+        case ASTNodeType::ARRAY_LITERAL: {
+            out += " [" + std::to_string(listSize(node)) + " elements]\n";
+            for (size_t i = listSize(node); i-- > 0;) {
+                work.emplace_back(listItem(node, i), indent + 1);
+            }
+            break;
+        }
+
+        case ASTNodeType::ARRAY_DECLARATION: {
+            const FlatArrayDecl& arrayDecl = arrays[c[node]];
+            out += " '";
+            out += name(node);
+            out += "'";
+            if (arrayDecl.hasType) {
+                out += " type=";
+                out += LexerEngine::tokenTypeToString(arrayDecl.elementType);
+            } else if (b[node] != NO_NODE) {
+                // Show inferred type from first element
+                out += " type=inferred";
+            }
+            if (arrayDecl.hasSize) {
+                out += " size=";
+                out += std::to_string(arrayDecl.size);
+            }
+            out += '\n';
+            work.emplace_back(b[node], indent + 1);
+            break;
+        }
+
+        default:
+            out += '\n';
+            break;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "ast.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Extra data for ARRAY_DECLARATION nodes, kept out of the hot node columns
+struct FlatArrayDecl {
+    Token elementType;
+    bool hasType;
+    bool hasSize;
+    uint64_t size;
+};
+
+// Index-based encoding of a program's AST, written by ASTParser as it
+// parses. Every node is a row across the parallel column vectors below,
+// identified by its 32-bit NodeId. Rows are appended in post-order, so a
+// node's children always have smaller ids than the node itself and the
+// program root is the last row.
+//
+// Meaning of the operand columns per kind:
+//   kind                  a                      b                    c
+//   PROGRAM               first entry in lists   statement count      -
+//   VARIABLE_DECLARATION  name (SymbolId)        value node           declared type (Token)
+//   STDOUT_STATEMENT      content node           -                    -
+//   BINARY_OPERATION      left node              right node           operator (Token)
+//   IDENTIFIER            name (SymbolId)        -                    -
+//   LITERAL_INT           value (ints)           -                    -
+//   LITERAL_FLOAT         value (floats)         -                    -
+//   LITERAL_STRING        value (strings)        -                    -
+//   LITERAL_BOOL          0 or 1                 -                    -
+//   STRING_INTERPOLATION  first entry in lists   expression count     -
+//   ARRAY_LITERAL         first entry in lists   element count        -
+//   ARRAY_DECLARATION     name (SymbolId)        initializer/NO_NODE  entry in arrays
+//
+// An interpolation with n expressions owns 2n+1 list entries alternating text
+// part (strings index) and expression node: part, expr, part, ..., part.
+//
+// Strings are views into the source buffer (or a loaded ASTImage), and names
+// are ids in the compilation's StringInterner; both must outlive the FlatAST.
+class FlatAST {
+public:
+    std::vector<ASTNodeType> kinds;
+    std::vector<uint32_t> offsets;  // source byte offset, see LineTable
+    std::vector<uint32_t> a;
+    std::vector<uint32_t> b;
+    std::vector<uint32_t> c;
+
+    // Side tables
+    std::vector<int> ints;
+    std::vector<float> floats;
+    std::vector<std::string_view> strings;
+    std::vector<uint32_t> lists;
+    std::vector<FlatArrayDecl> arrays;
+
+    NodeId root = NO_NODE;
+    const StringInterner* symbols = nullptr;
+
+    size_t nodeCount() const { return kinds.size(); }
+    ASTNodeType kind(NodeId id) const { return kinds[id]; }
+
+    // Child list helpers for PROGRAM, ARRAY_LITERAL and STRING_INTERPOLATION
+    NodeId listItem(NodeId id, size_t i) const { return lists[a[id] + i]; }
+    size_t listSize(NodeId id) const { return b[id]; }
+    std::string_view interpolationPart(NodeId id, size_t i) const { return strings[lists[a[id] + 2 * i]]; }
+    NodeId interpolationExpression(NodeId id, size_t i) const { return lists[a[id] + 2 * i + 1]; }
+
+    // Declared or referenced name of a declaration/identifier node
+    SymbolId symbol(NodeId id) const { return a[id]; }
+    std::string_view name(NodeId id) const { return symbols->name(a[id]); }
+
+    NodeId addNode(ASTNodeType kind, uint32_t offset, uint32_t a, uint32_t b = 0, uint32_t c = 0);
+    uint32_t addString(std::string_view text);
+
+    // Empties every column but keeps their capacity for the next program
+    void clear();
+
+    // Indented text dump used for the AST IR file
+    std::string toString(NodeId node, int indent) const;
+    void buildString(NodeId node, int indent, std::string &out) const;
+
+private:
+    void appendNode(NodeId node, int indent, std::string &out,
+                    std::vector<std::pair<NodeId, int>> &work) const;
+};
@@ -0,0 +1,20 @@
+#include "interner.hpp"
+
+SymbolId StringInterner::intern(std::string_view text) {
+    auto it = ids.find(text);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    std::string_view stored = storage.copyString(text);
+    SymbolId id = (SymbolId)names.size();
+    names.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+void StringInterner::clear() {
+    ids.clear();
+    names.clear();
+    storage.rewind();
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "arena.hpp"
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Dense id for an interned identifier. Ids are handed out in order of first
+// appearance starting at 0, so passes can index plain vectors with them.
+using SymbolId = uint32_t;
+constexpr SymbolId NO_SYMBOL = UINT32_MAX;
+
+// Maps each distinct identifier to a SymbolId. Names are copied into the
+// interner's own arena, so ids and names stay valid independently of the
+// source buffer they were first seen in.
+class StringInterner {
+private:
+    Arena storage;
+    std::unordered_map<std::string_view, SymbolId> ids;
+    std::vector<std::string_view> names;
+
+public:
+    StringInterner() : storage(16 * 1024) {}
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    SymbolId intern(std::string_view text);
+    std::string_view name(SymbolId id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+    // Forgets every name but keeps the memory, for an interner reused
+    // across compilations
+    void clear();
+};
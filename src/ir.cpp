@@ -0,0 +1,452 @@
+#include "ir.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+// Position of an operator within its opcode group (ADD_I..MOD_I and
+// EQ_I..GE_I), or -1 if the token is not in the group
+int arithmeticIndex(Token op) {
+    switch (op) {
+        case ADD: return 0;
+        case SUB: return 1;
+        case MUL: return 2;
+        case DIV: return 3;
+        case MOD: return 4;
+        default: return -1;
+    }
+}
+
+int comparisonIndex(Token op) {
+    switch (op) {
+        case EQUAL: return 0;
+        case NOT_EQUAL: return 1;
+        case LESSER: return 2;
+        case LESSER_EQUAL: return 3;
+        case GREATER: return 4;
+        case GREATER_EQUAL: return 5;
+        default: return -1;
+    }
+}
+
+Op offsetOp(Op base, int index) {
+    return (Op)((int)base + index);
+}
+
+std::string lowerName(Op op) {
+    std::string name = Bytecode::opName(op);
+    for (char& c : name) c = (char)std::tolower((unsigned char)c);
+    return name;
+}
+
+} // namespace
+
+IRValue IRProgram::append(uint32_t block, IROp kind, Op op, ValueType type, uint32_t offset, uint64_t bits) {
+    IRValue id = (IRValue)values.size();
+    values.push_back(IRInstruction{kind, op, type, offset, NO_VARIABLE, (uint32_t)operands.size(), 0, bits});
+    blocks[block].instructions.push_back(id);
+    return id;
+}
+
+void IRProgram::addOperand(IRValue value) {
+    operands.push_back(value);
+    values.back().operandCount++;
+}
+
+uint32_t IRProgram::addString(std::string text) {
+    ownedStrings.push_back(std::move(text));
+    strings.push_back(ownedStrings.back());
+    return (uint32_t)(strings.size() - 1);
+}
+
+void IRProgram::compact() {
+    for (IRBlock& block : blocks) {
+        auto removed = [this](IRValue value) { return values[value].kind == IROp::NOP; };
+        block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(), removed),
+                                 block.instructions.end());
+    }
+}
+
+size_t IRProgram::instructionCount() const {
+    size_t count = 0;
+    for (const IRBlock& block : blocks) {
+        for (IRValue value : block.instructions) {
+            if (values[value].kind != IROp::NOP) count++;
+        }
+    }
+    return count;
+}
+
+std::vector<uint32_t> IRProgram::countUses() const {
+    std::vector<uint32_t> uses(values.size(), 0);
+    for (const IRBlock& block : blocks) {
+        for (IRValue value : block.instructions) {
+            if (values[value].kind == IROp::NOP) continue;
+            for (uint32_t i = 0; i < values[value].operandCount; i++) {
+                uses[operand(value, i)]++;
+            }
+        }
+    }
+    return uses;
+}
+
+bool IRProgram::hasSideEffects(IRValue value) const {
+    const IRInstruction& instr = values[value];
+    switch (instr.kind) {
+        case IROp::WRITE: case IROp::WRITE_TEXT: case IROp::WRITE_NEWLINE:
+            return true;
+        case IROp::BINARY: {
+            if (instr.op != Op::DIV_I && instr.op != Op::MOD_I) return false;
+            const IRInstruction& divisor = values[operand(value, 1)];
+            return divisor.kind != IROp::CONST || divisor.bits == 0;
+        }
+        default:
+            return false;
+    }
+}
+
+std::string IRProgram::toString() const {
+    std::string out;
+    out += "variables " + std::to_string(variables.size()) + ", blocks " + std::to_string(blocks.size()) +
+           ", instructions " + std::to_string(instructionCount()) + "\n";
+
+    for (size_t b = 0; b < blocks.size(); b++) {
+        out += "block " + std::to_string(b) + ":";
+        for (uint32_t predecessor : blocks[b].predecessors) {
+            out += " <- " + std::to_string(predecessor);
+        }
+        out += "\n";
+
+        for (IRValue value : blocks[b].instructions) {
+            const IRInstruction& instr = values[value];
+            if (instr.kind == IROp::NOP) continue;
+
+            out += "  ";
+            if (instr.type != ValueType::UNKNOWN_TYPE) {
+                out += "%" + std::to_string(value) + " = ";
+            }
+            switch (instr.kind) {
+                case IROp::CONST: {
+                    Value constant;
+                    constant.ref = instr.bits;
+                    out += "const " + SemanticAnalyzer::valueTypeToString(instr.type) + " ";
+                    switch (instr.type) {
+                        case ValueType::FLOAT_TYPE: out += std::to_string(constant.f); break;
+                        case ValueType::BOOL_TYPE: out += constant.i ? "true" : "false"; break;
+                        case ValueType::STRING_TYPE: out += "\"" + std::string(strings[constant.ref]) + "\""; break;
+                        default: out += std::to_string(constant.i); break;
+                    }
+                    break;
+                }
+                case IROp::COPY: out += "copy"; break;
+                case IROp::PHI: out += "phi"; break;
+                case IROp::ARRAY_NEW:
+                    out += "array_new " + SemanticAnalyzer::valueTypeToString(arrayElementType(instr.bits)) + "[" +
+                           std::to_string(arraySize(instr.bits)) + "]";
+                    break;
+                case IROp::WRITE_TEXT: out += "write_text \"" + std::string(strings[instr.bits]) + "\""; break;
+                case IROp::WRITE_NEWLINE: out += "write_newline"; break;
+                default: out += lowerName(instr.op); break;
+            }
+
+            for (uint32_t i = 0; i < instr.operandCount; i++) {
+                out += (i == 0 ? " %" : ", %") + std::to_string(operand(value, i));
+            }
+            if (instr.variable != NO_VARIABLE) {
+                out += "\t; " + std::string(variables[instr.variable].name);
+            }
+            out += "\n";
+        }
+    }
+    return out;
+}
+
+bool IRBuilder::buildProgram(const FlatAST& program, const SemanticAnalyzer& analyzer, IRProgram& ir,
+                             ErrorHandler& diagnostics) {
+    ast = &program;
+    semantic = &analyzer;
+    out = &ir;
+    errors = &diagnostics;
+    success = true;
+    ir = IRProgram();
+    ir.blocks.emplace_back();
+
+    // Roughly one instruction per node, plus a copy per declaration
+    ir.values.reserve(program.nodeCount());
+    ir.operands.reserve(program.nodeCount());
+    ir.blocks[0].instructions.reserve(program.nodeCount());
+
+    definitions.assign(program.symbols->size(), NO_VALUE);
+    variables.assign(program.symbols->size(), NO_VARIABLE);
+    for (SymbolId name : analyzer.getDeclarationOrder()) {
+        variables[name] = (uint32_t)ir.variables.size();
+        ir.variables.push_back(IRVariable{program.symbols->name(name), analyzer.getVariableInfo(name).used});
+    }
+
+    for (size_t i = 0; i < program.listSize(program.root); i++) {
+        buildStatement(program.listItem(program.root, i));
+    }
+    return success;
+}
+
+// Everything goes into the entry block until there is control flow
+IRValue IRBuilder::append(IROp kind, Op op, ValueType type, uint32_t offset, uint64_t bits) {
+    return out->append(0, kind, op, type, offset, bits);
+}
+
+IRValue IRBuilder::constant(ValueType type, Value value, uint32_t offset) {
+    return append(IROp::CONST, Op::HALT, type, offset, value.ref);
+}
+
+void IRBuilder::error(const std::string& message, NodeId node, const std::string& suggestion) {
+    errors->addCodegenError(message, ast->offsets[node], suggestion);
+    success = false;
+}
+
+void IRBuilder::buildStatement(NodeId stmt) {
+    switch (ast->kind(stmt)) {
+        case ASTNodeType::VARIABLE_DECLARATION: {
+            SymbolId name = ast->symbol(stmt);
+            IRValue value = buildExpression(ast->b[stmt]);
+            IRValue copy = append(IROp::COPY, Op::HALT, semantic->getVariableInfo(name).type, ast->offsets[stmt]);
+            out->addOperand(value);
+            out->values[copy].variable = variables[name];
+            definitions[name] = copy;
+            break;
+        }
+
+        case ASTNodeType::ARRAY_DECLARATION:
+            buildArrayDeclaration(stmt);
+            break;
+
+        case ASTNodeType::STDOUT_STATEMENT:
+            buildStdout(stmt);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void IRBuilder::buildArrayDeclaration(NodeId stmt) {
+    const FlatArrayDecl& arrayDecl = ast->arrays[ast->c[stmt]];
+    NodeId initializer = ast->b[stmt];
+    SymbolId name = ast->symbol(stmt);
+    ValueType elementType = semantic->getVariableInfo(name).type;
+    uint32_t offset = ast->offsets[stmt];
+
+    std::vector<IRValue> elements;
+    if (initializer != NO_NODE) {
+        for (size_t i = 0; i < ast->listSize(initializer); i++) {
+            NodeId element = ast->listItem(initializer, i);
+            ValueType type = semantic->getNodeType(element);
+            if (type != elementType && !(type == ValueType::INT_TYPE && elementType == ValueType::FLOAT_TYPE)) {
+                error("Cannot store " + SemanticAnalyzer::valueTypeToString(type) + " in array '" +
+                          std::string(ast->name(stmt)) + "' of " + SemanticAnalyzer::valueTypeToString(elementType),
+                      element, "Make every initializer a " + SemanticAnalyzer::valueTypeToString(elementType));
+                return;
+            }
+            elements.push_back(convert(buildExpression(element), type, elementType, ast->offsets[element]));
+        }
+    }
+
+    uint64_t count = elements.size();
+    uint64_t size = count;
+    if (arrayDecl.hasSize) {
+        if (arrayDecl.size < count) {
+            error("Array '" + std::string(ast->name(stmt)) + "' has " + std::to_string(count) +
+                      " initializers but room for " + std::to_string(arrayDecl.size),
+                  stmt, "Increase the declared size or remove initializers");
+            return;
+        }
+        size = arrayDecl.size;
+    }
+    if (size > MAX_ARRAY_ITEMS) {
+        error("Array '" + std::string(ast->name(stmt)) + "' has " + std::to_string(size) +
+                  " items, more than the limit of " + std::to_string(MAX_ARRAY_ITEMS),
+              stmt, "Declare a smaller array");
+        return;
+    }
+
+    append(IROp::ARRAY_NEW, Op::ARRAY_NEW, ValueType::ARRAY_TYPE, offset, arrayBits(elementType, size));
+    for (IRValue element : elements) {
+        out->addOperand(element);
+    }
+    IRValue array = (IRValue)(out->values.size() - 1);
+
+    IRValue copy = append(IROp::COPY, Op::HALT, ValueType::ARRAY_TYPE, offset);
+    out->addOperand(array);
+    out->values[copy].variable = variables[name];
+    definitions[name] = copy;
+}
+
+void IRBuilder::buildStdout(NodeId stmt) {
+    NodeId content = ast->a[stmt];
+    size_t expressions = ast->listSize(content);
+
+    for (size_t i = 0; i <= expressions; i++) {
+        std::string_view part = ast->interpolationPart(content, i);
+        if (!part.empty()) {
+            out->strings.push_back(part);
+            append(IROp::WRITE_TEXT, Op::WRITE_TEXT, ValueType::UNKNOWN_TYPE, ast->offsets[stmt],
+                   out->strings.size() - 1);
+        }
+        if (i == expressions) break;
+
+        // The parser only allows identifiers inside {}
+        NodeId expr = ast->interpolationExpression(content, i);
+        const VariableInfo& info = semantic->getVariableInfo(ast->symbol(expr));
+        Op write = Op::WRITE_STRING;
+        if (info.isArray) {
+            write = Op::WRITE_ARRAY;
+        } else if (info.type == ValueType::INT_TYPE) {
+            write = Op::WRITE_INT;
+        } else if (info.type == ValueType::FLOAT_TYPE) {
+            write = Op::WRITE_FLOAT;
+        } else if (info.type == ValueType::BOOL_TYPE) {
+            write = Op::WRITE_BOOL;
+        }
+        append(IROp::WRITE, write, ValueType::UNKNOWN_TYPE, ast->offsets[expr]);
+        out->addOperand(definitions[ast->symbol(expr)]);
+    }
+    append(IROp::WRITE_NEWLINE, Op::WRITE_NEWLINE, ValueType::UNKNOWN_TYPE, ast->offsets[stmt]);
+}
+
+// Operator chains are walked in post-order with an explicit stack, like
+// SemanticAnalyzer::analyzeExpression. Each operand is converted to the
+// operation's operand type right after it is built.
+IRValue IRBuilder::buildExpression(NodeId expr) {
+    if (ast->kind(expr) != ASTNodeType::BINARY_OPERATION) {
+        return buildOperand(expr);
+    }
+
+    size_t walkBase = walkStack.size();
+    size_t valueBase = valueStack.size();
+    walkStack.push_back(PendingOperation{expr, 0});
+
+    while (walkStack.size() > walkBase) {
+        PendingOperation& top = walkStack.back();
+        NodeId node = top.node;
+
+        if (ast->kind(node) != ASTNodeType::BINARY_OPERATION) {
+            walkStack.pop_back();
+            valueStack.push_back(buildOperand(node));
+        } else if (top.stage == 0) {
+            top.stage = 1;
+            walkStack.push_back(PendingOperation{ast->a[node], 0});
+        } else if (top.stage == 1) {
+            top.stage = 2;
+            valueStack.back() = convert(valueStack.back(), semantic->getNodeType(ast->a[node]), operandType(node),
+                                        ast->offsets[node]);
+            walkStack.push_back(PendingOperation{ast->b[node], 0});
+        } else {
+            walkStack.pop_back();
+            IRValue right = convert(valueStack.back(), semantic->getNodeType(ast->b[node]), operandType(node),
+                                    ast->offsets[node]);
+            valueStack.pop_back();
+            valueStack.back() = buildOperator(node, valueStack.back(), right);
+        }
+    }
+
+    IRValue result = valueStack.back();
+    valueStack.resize(valueBase);
+    return result;
+}
+
+IRValue IRBuilder::buildOperand(NodeId expr) {
+    uint32_t offset = ast->offsets[expr];
+    Value value;
+
+    switch (ast->kind(expr)) {
+        case ASTNodeType::LITERAL_INT:
+            value.i = ast->ints[ast->a[expr]];
+            return constant(ValueType::INT_TYPE, value, offset);
+
+        case ASTNodeType::LITERAL_FLOAT:
+            value.f = ast->floats[ast->a[expr]];
+            return constant(ValueType::FLOAT_TYPE, value, offset);
+
+        case ASTNodeType::LITERAL_STRING:
+            out->strings.push_back(ast->strings[ast->a[expr]]);
+            value.ref = out->strings.size() - 1;
+            return constant(ValueType::STRING_TYPE, value, offset);
+
+        case ASTNodeType::LITERAL_BOOL:
+            value.i = ast->a[expr];
+            return constant(ValueType::BOOL_TYPE, value, offset);
+
+        case ASTNodeType::IDENTIFIER:
+            if (semantic->getVariableInfo(ast->symbol(expr)).isArray) {
+                error("Array '" + std::string(ast->name(expr)) + "' cannot be used in an expression", expr,
+                      "Only scalar variables can appear in expressions");
+            }
+            return definitions[ast->symbol(expr)];
+
+        default:
+            error("Array literals are only allowed as array initializers", expr,
+                  "Declare an array with this literal and use it instead");
+            value.i = 0;
+            return constant(ValueType::INT_TYPE, value, offset);
+    }
+}
+
+IRValue IRBuilder::buildOperator(NodeId expr, IRValue left, IRValue right) {
+    Token op = (Token)ast->c[expr];
+    ValueType type = operandType(expr);
+
+    Op code;
+    int arithmetic = arithmeticIndex(op);
+    if (arithmetic >= 0) {
+        if (type == ValueType::STRING_TYPE) {
+            code = Op::CONCAT;
+        } else {
+            code = offsetOp(type == ValueType::FLOAT_TYPE ? Op::ADD_F : Op::ADD_I, arithmetic);
+        }
+    } else {
+        Op base = Op::EQ_I;
+        if (type == ValueType::FLOAT_TYPE) base = Op::EQ_F;
+        if (type == ValueType::STRING_TYPE) base = Op::EQ_S;
+        code = offsetOp(base, comparisonIndex(op));
+    }
+
+    IRValue result = append(IROp::BINARY, code, semantic->getNodeType(expr), ast->offsets[expr]);
+    out->addOperand(left);
+    out->addOperand(right);
+    return result;
+}
+
+// Kind of value both operands of a binary node are converted to before the
+// operator runs
+ValueType IRBuilder::operandType(NodeId binary) const {
+    ValueType left = semantic->getNodeType(ast->a[binary]);
+    ValueType right = semantic->getNodeType(ast->b[binary]);
+
+    if (left == ValueType::STRING_TYPE || right == ValueType::STRING_TYPE) {
+        return ValueType::STRING_TYPE;
+    }
+    if (left == ValueType::FLOAT_TYPE || right == ValueType::FLOAT_TYPE) {
+        return ValueType::FLOAT_TYPE;
+    }
+    return left;
+}
+
+IRValue IRBuilder::convert(IRValue value, ValueType from, ValueType to, uint32_t offset) {
+    Op code;
+    if (from == to) {
+        return value;
+    } else if (to == ValueType::FLOAT_TYPE && from == ValueType::INT_TYPE) {
+        code = Op::INT_TO_FLOAT;
+    } else if (to == ValueType::STRING_TYPE && from == ValueType::INT_TYPE) {
+        code = Op::INT_TO_STRING;
+    } else if (to == ValueType::STRING_TYPE && from == ValueType::FLOAT_TYPE) {
+        code = Op::FLOAT_TO_STRING;
+    } else if (to == ValueType::STRING_TYPE && from == ValueType::BOOL_TYPE) {
+        code = Op::BOOL_TO_STRING;
+    } else {
+        return value;
+    }
+
+    IRValue result = append(IROp::CONVERT, code, to, offset);
+    out->addOperand(value);
+    return result;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "codegen.hpp"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Id of an IR instruction, which is also the SSA value it defines
+using IRValue = uint32_t;
+constexpr IRValue NO_VALUE = UINT32_MAX;
+constexpr uint32_t NO_VARIABLE = UINT32_MAX;
+
+enum class IROp : uint8_t {
+    CONST,          // `bits` of `type`; a string is an index into IRProgram::strings
+    COPY,           // operand 0, bound to `variable`
+    PHI,            // one operand per predecessor of the block
+    BINARY,         // `op` (ADD_I..GE_S or CONCAT) on operands 0 and 1
+    CONVERT,        // `op` (INT_TO_FLOAT..BOOL_TO_STRING) on operand 0
+    ARRAY_NEW,      // operands are the initializers; `bits` from arrayBits
+    WRITE,          // `op` (WRITE_INT..WRITE_ARRAY) on operand 0
+    WRITE_TEXT,     // IRProgram::strings[bits]
+    WRITE_NEWLINE,
+    NOP             // removed by a pass, dropped from its block by compact()
+};
+
+// ARRAY_NEW's `bits`: the element type in the top byte and the size below
+// it (sizes are at most MAX_ARRAY_ITEMS)
+constexpr uint64_t arrayBits(ValueType elementType, uint64_t size) { return (uint64_t)elementType << 56 | size; }
+constexpr ValueType arrayElementType(uint64_t bits) { return (ValueType)(bits >> 56); }
+constexpr uint64_t arraySize(uint64_t bits) { return bits & ((1ull << 56) - 1); }
+
+struct IRInstruction {
+    IROp kind;
+    Op op;
+    ValueType type;          // of the result; UNKNOWN_TYPE if there is none
+    uint32_t offset;         // source byte offset
+    uint32_t variable;       // variable the value is bound to (COPY) or was copied into, for naming
+    uint32_t firstOperand;   // into IRProgram::operands
+    uint32_t operandCount;
+    uint64_t bits;
+};
+
+struct IRBlock {
+    std::vector<IRValue> instructions;
+    std::vector<uint32_t> predecessors;
+};
+
+struct IRVariable {
+    std::string_view name;
+    bool read;  // referenced anywhere after its declaration
+};
+
+// Typed SSA form of a checked program, between the semantic analyzer and
+// bytecode generation. Every instruction defines at most one value and
+// values are never reassigned; a variable declaration is a COPY of its
+// initializer and each later use of the variable refers to that COPY.
+//
+// The language has no control flow yet, so programs lower to one block and
+// never contain PHIs; blocks, predecessors and PHI are here so passes are
+// written against the general shape.
+struct IRProgram {
+    std::vector<IRInstruction> values;
+    std::vector<IRValue> operands;
+    std::vector<IRBlock> blocks;
+    std::vector<IRVariable> variables;
+    std::vector<std::string_view> strings;  // views into the source or `ownedStrings`
+    std::deque<std::string> ownedStrings;   // text created by passes
+
+    // Copies would leave `strings` viewing the original's ownedStrings
+    IRProgram() = default;
+    IRProgram(const IRProgram&) = delete;
+    IRProgram& operator=(const IRProgram&) = delete;
+    IRProgram(IRProgram&&) = default;
+    IRProgram& operator=(IRProgram&&) = default;
+
+    // Appends an instruction to `block`; its operands follow with addOperand
+    IRValue append(uint32_t block, IROp kind, Op op, ValueType type, uint32_t offset, uint64_t bits = 0);
+    void addOperand(IRValue value);
+
+    IRValue operand(IRValue value, uint32_t i) const { return operands[values[value].firstOperand + i]; }
+    IRValue& operand(IRValue value, uint32_t i) { return operands[values[value].firstOperand + i]; }
+
+    uint32_t addString(std::string text);
+    void remove(IRValue value) { values[value].kind = IROp::NOP; }
+
+    // Drops removed instructions from the blocks
+    void compact();
+
+    size_t instructionCount() const;
+    std::vector<uint32_t> countUses() const;
+
+    // Writes with side effects, and int divisions that can fail at run time,
+    // must be kept and stay in order; everything else may be moved or removed
+    bool hasSideEffects(IRValue value) const;
+
+    // Text dump used for the SSA IR file
+    std::string toString() const;
+};
+
+// Lowers an analyzed FlatAST to IRProgram. Checks that only the backend
+// cares about (arrays inside expressions, initializers and sizes) are
+// reported here, so a program that lowers always compiles.
+class IRBuilder {
+private:
+    // Binary operation waiting on the explicit stack of buildExpression
+    struct PendingOperation {
+        NodeId node;
+        int stage;  // 0: nothing built, 1: left operand built, 2: both
+    };
+
+    const FlatAST* ast = nullptr;
+    const SemanticAnalyzer* semantic = nullptr;
+    IRProgram* out = nullptr;
+    ErrorHandler* errors = nullptr;
+    std::vector<IRValue> definitions;  // SymbolId -> defining COPY
+    std::vector<uint32_t> variables;   // SymbolId -> IRProgram::variables index
+    std::vector<PendingOperation> walkStack;
+    std::vector<IRValue> valueStack;
+    bool success = true;
+
+    IRValue append(IROp kind, Op op, ValueType type, uint32_t offset, uint64_t bits = 0);
+    IRValue constant(ValueType type, Value value, uint32_t offset);
+    void error(const std::string& message, NodeId node, const std::string& suggestion);
+
+    void buildStatement(NodeId stmt);
+    void buildArrayDeclaration(NodeId stmt);
+    void buildStdout(NodeId stmt);
+    IRValue buildExpression(NodeId expr);
+    IRValue buildOperand(NodeId expr);
+    IRValue buildOperator(NodeId expr, IRValue left, IRValue right);
+    IRValue convert(IRValue value, ValueType from, ValueType to, uint32_t offset);
+    ValueType operandType(NodeId binary) const;
+
+public:
+    bool buildProgram(const FlatAST& program, const SemanticAnalyzer& analyzer, IRProgram& ir, ErrorHandler& diagnostics);
+};
@@ -0,0 +1,702 @@
+#include "jit.hpp"
+#include <cmath>
+#include <cstring>
+
+#ifdef AW_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+// Register numbers in ModRM fields. The frame pointer lives in rbx and the
+// helper context in r12, both callee-saved, so helper calls keep them. rax,
+// rcx, rdx, xmm0 and xmm1 are scratch; the rest of the caller-saved
+// registers hold temporaries and are spilled around helper calls.
+constexpr uint8_t RAX = 0, RCX = 1, RDX = 2, RSI = 6;
+constexpr uint8_t XMM0 = 0, XMM1 = 1;
+const uint8_t GPR_POOL[] = {6, 7, 8, 9, 10, 11};  // rsi, rdi, r8-r11
+const uint8_t XMM_POOL[] = {2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+// Heap of one JIT run, laid out like the VM's: string constants first, then
+// strings built at run time
+struct JitContext {
+    const Bytecode* program;
+    std::vector<std::string> strings;
+    ArrayHeap arrays;
+    OutputBuffer* out;
+};
+
+// Every helper takes the context, a pointer to its operands in the frame
+// (results are written back over the first one) and up to two immediates
+using Helper = void (*)(JitContext*, Value*, uint64_t, uint64_t);
+
+void writeTextHelper(JitContext* context, Value*, uint64_t string, uint64_t) {
+    context->out->write(context->program->strings[string]);
+}
+
+void writeValueHelper(JitContext* context, Value* operands, uint64_t type, uint64_t) {
+    writeElement(*context->out, (ValueType)type, operands[0], context->strings);
+}
+
+void writeNewlineHelper(JitContext* context, Value*, uint64_t, uint64_t) {
+    context->out->put('\n');
+}
+
+void writeArrayHelper(JitContext* context, Value* operands, uint64_t, uint64_t) {
+    const ArrayObject& array = context->arrays[operands[0].ref];
+    OutputBuffer& out = *context->out;
+    out.put('[');
+    for (uint64_t i = 0; i < array.size; i++) {
+        if (i > 0) out.write(", ");
+        writeElement(out, array.elementType, array.items[i], context->strings);
+    }
+    out.put(']');
+}
+
+void toStringHelper(JitContext* context, Value* operands, uint64_t type, uint64_t) {
+    switch ((ValueType)type) {
+        case ValueType::FLOAT_TYPE: context->strings.push_back(formatFloat(operands[0].f)); break;
+        case ValueType::BOOL_TYPE: context->strings.emplace_back(formatBool(operands[0].i)); break;
+        default: context->strings.push_back(std::to_string(operands[0].i)); break;
+    }
+    operands[0].ref = context->strings.size() - 1;
+}
+
+void concatHelper(JitContext* context, Value* operands, uint64_t, uint64_t) {
+    context->strings.push_back(context->strings[operands[0].ref] + context->strings[operands[1].ref]);
+    operands[0].ref = context->strings.size() - 1;
+}
+
+// `group` is the comparison's position in EQ..GE
+void compareStringsHelper(JitContext* context, Value* operands, uint64_t group, uint64_t) {
+    int order = context->strings[operands[0].ref].compare(context->strings[operands[1].ref]);
+    bool results[] = {order == 0, order != 0, order < 0, order <= 0, order > 0, order >= 0};
+    operands[0].i = results[group] ? 1 : 0;
+}
+
+void fmodHelper(JitContext*, Value* operands, uint64_t, uint64_t) {
+    operands[0].f = std::fmod(operands[0].f, operands[1].f);
+}
+
+// ARRAY_NEW and ARRAY_CONST at code index `pc`. A failed allocation leaves
+// UINT64_MAX as the handle, which the generated code checks for.
+void arrayNewHelper(JitContext* context, Value* operands, uint64_t pc, uint64_t) {
+    const uint32_t* words = &context->program->code[pc];
+    ValueType elementType = (ValueType)Bytecode::argument(words[0]);
+    if (Bytecode::opcode(words[0]) == Op::ARRAY_CONST) {
+        const Value* initializers = &context->program->constants[words[1]];
+        operands[0].ref = context->arrays.create(elementType, Bytecode::wide(words + 3), initializers, words[2]);
+    } else {
+        operands[0].ref = context->arrays.create(elementType, Bytecode::wide(words + 2), operands, words[1]);
+    }
+}
+
+// Address of a helper, checked against the calling convention
+void* helper(Helper function) {
+    return (void*)function;
+}
+
+// setcc opcodes (second byte after 0x0F) for EQ..GE on signed ints
+const uint8_t SIGNED_SETCC[] = {0x94, 0x95, 0x9C, 0x9E, 0x9F, 0x9D};
+
+bool fitsImm32(uint64_t bits) {
+    return (int64_t)bits >= INT32_MIN && (int64_t)bits <= INT32_MAX;
+}
+
+} // namespace
+
+void JitCompiler::imm32(uint32_t value) {
+    for (int i = 0; i < 4; i++) byte((uint8_t)(value >> (8 * i)));
+}
+
+void JitCompiler::imm64(uint64_t value) {
+    for (int i = 0; i < 8; i++) byte((uint8_t)(value >> (8 * i)));
+}
+
+// prefix [REX] opcode ModRM, where rm is either a register or the frame
+// slot [rbx + 8 * rm] (always with a 32-bit displacement)
+void JitCompiler::instr(std::initializer_list<uint8_t> prefix, bool wide, std::initializer_list<uint8_t> opcode,
+                        uint8_t reg, bool memory, uint32_t rm) {
+    bytes(prefix);
+    uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | (!memory && (rm & 8) ? 1 : 0);
+    if (rex != 0x40) byte(rex);
+    bytes(opcode);
+    if (memory) {
+        byte((uint8_t)(0x80 | ((reg & 7) << 3) | 3));
+        imm32(8 * rm);
+    } else {
+        byte((uint8_t)(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+    }
+}
+
+// Same, with a register, variable slot or home operand
+void JitCompiler::operandInstr(std::initializer_list<uint8_t> prefix, bool wide, std::initializer_list<uint8_t> opcode,
+                               uint8_t reg, const JitOperand& operand) {
+    instr(prefix, wide, opcode, reg, operand.kind != JitOperand::REGISTER, operand.index);
+}
+
+void JitCompiler::push(JitOperand::Kind kind, bool isFloat, uint32_t index, uint64_t bits) {
+    stack.push_back(JitOperand{kind, isFloat, index, bits});
+}
+
+JitOperand JitCompiler::pop() {
+    JitOperand operand = stack.back();
+    stack.pop_back();
+    return operand;
+}
+
+// A free pool register, spilling the deepest register entry if none is left
+uint8_t JitCompiler::allocate(bool isFloat) {
+    bool* used = usedRegisters[isFloat];
+    for (;;) {
+        if (isFloat) {
+            for (uint8_t reg : XMM_POOL) {
+                if (!used[reg]) { used[reg] = true; return reg; }
+            }
+        } else {
+            for (uint8_t reg : GPR_POOL) {
+                if (!used[reg]) { used[reg] = true; return reg; }
+            }
+        }
+        for (size_t entry = 0; entry < stack.size(); entry++) {
+            if (stack[entry].kind == JitOperand::REGISTER && stack[entry].isFloat == isFloat) {
+                spill(entry);
+                break;
+            }
+        }
+    }
+}
+
+void JitCompiler::free(const JitOperand& operand) {
+    if (operand.kind == JitOperand::REGISTER) {
+        usedRegisters[operand.isFloat][operand.index] = false;
+    }
+}
+
+void JitCompiler::spill(size_t entry) {
+    JitOperand& operand = stack[entry];
+    uint32_t home = base + (uint32_t)entry;
+    if (operand.isFloat) {
+        instr({0xF2}, false, {0x0F, 0x11}, (uint8_t)operand.index, true, home);  // movsd [home], xmm
+    } else {
+        instr({}, true, {0x89}, (uint8_t)operand.index, true, home);            // mov [home], reg
+    }
+    free(operand);
+    operand = JitOperand{JitOperand::HOME, operand.isFloat, home, 0};
+}
+
+void JitCompiler::spillAll() {
+    for (size_t entry = 0; entry < stack.size(); entry++) {
+        if (stack[entry].kind == JitOperand::REGISTER) spill(entry);
+    }
+}
+
+// Copies an operand into `reg` (a general register for ints, an xmm
+// register for floats). Float constants go through rax.
+void JitCompiler::load(uint8_t reg, const JitOperand& operand) {
+    if (!operand.isFloat) {
+        if (operand.kind == JitOperand::CONSTANT) {
+            if (fitsImm32(operand.bits)) {
+                instr({}, true, {0xC7}, 0, false, reg);  // mov reg, imm32
+                imm32((uint32_t)operand.bits);
+            } else {
+                byte((uint8_t)(0x48 | (reg >> 3)));
+                byte((uint8_t)(0xB8 + (reg & 7)));        // mov reg, imm64
+                imm64(operand.bits);
+            }
+        } else if (operand.kind != JitOperand::REGISTER || operand.index != reg) {
+            operandInstr({}, true, {0x8B}, reg, operand);  // mov reg, operand
+        }
+        return;
+    }
+
+    if (operand.kind == JitOperand::CONSTANT) {
+        if (operand.bits == 0) {
+            instr({0x66}, false, {0x0F, 0x57}, reg, false, reg);  // xorpd reg, reg
+        } else {
+            load(RAX, JitOperand{JitOperand::CONSTANT, false, 0, operand.bits});
+            instr({0x66}, true, {0x0F, 0x6E}, reg, false, RAX);  // movq reg, rax
+        }
+    } else if (operand.kind == JitOperand::REGISTER) {
+        if (operand.index != reg) instr({0x66}, false, {0x0F, 0x28}, reg, false, operand.index);  // movapd
+    } else {
+        operandInstr({0xF2}, false, {0x0F, 0x10}, reg, operand);  // movsd reg, [operand]
+    }
+}
+
+uint8_t JitCompiler::toRegister(size_t entry) {
+    if (stack[entry].kind == JitOperand::REGISTER) {
+        return (uint8_t)stack[entry].index;
+    }
+    uint8_t reg = allocate(stack[entry].isFloat);
+    load(reg, stack[entry]);
+    stack[entry].kind = JitOperand::REGISTER;
+    stack[entry].index = reg;
+    return reg;
+}
+
+void JitCompiler::toHome(size_t entry) {
+    JitOperand& operand = stack[entry];
+    uint32_t home = base + (uint32_t)entry;
+    switch (operand.kind) {
+        case JitOperand::REGISTER:
+            spill(entry);
+            return;
+        case JitOperand::CONSTANT:
+            if (fitsImm32(operand.bits)) {
+                instr({}, true, {0xC7}, 0, true, home);  // mov qword [home], imm32
+                imm32((uint32_t)operand.bits);
+            } else {
+                load(RAX, JitOperand{JitOperand::CONSTANT, false, 0, operand.bits});
+                instr({}, true, {0x89}, RAX, true, home);
+            }
+            break;
+        case JitOperand::SLOT:
+            instr({}, true, {0x8B}, RAX, true, operand.index);
+            instr({}, true, {0x89}, RAX, true, home);
+            break;
+        case JitOperand::HOME:
+            return;
+    }
+    operand = JitOperand{JitOperand::HOME, operand.isFloat, home, 0};
+}
+
+// Calls helper(context, &home of `entry`, argument, extra). Every register
+// value is spilled first since the helper may clobber them.
+void JitCompiler::helperCall(void* helper, size_t entry, uint64_t argument, uint64_t extra) {
+    spillAll();
+    bytes({0x4C, 0x89, 0xE7});                             // mov rdi, r12
+    instr({}, true, {0x8D}, RSI, true, base + (uint32_t)entry);  // lea rsi, [home]
+    load(RDX, JitOperand{JitOperand::CONSTANT, false, 0, argument});
+    load(RCX, JitOperand{JitOperand::CONSTANT, false, 0, extra});
+    load(RAX, JitOperand{JitOperand::CONSTANT, false, 0, (uint64_t)(uintptr_t)helper});
+    bytes({0xFF, 0xD0});                                   // call rax
+}
+
+bool JitCompiler::compileProgram(const Bytecode& bytecode, std::string& reason) {
+    release();
+    program = &bytecode;
+    code.clear();
+    errorJumps.clear();
+    stack.clear();
+    slotFloats.assign(bytecode.slotNames.size(), false);
+    base = (uint32_t)bytecode.slotNames.size();
+    std::memset(usedRegisters, 0, sizeof(usedRegisters));
+
+#ifndef AW_JIT_SUPPORTED
+    reason = "the JIT needs x86-64 Linux";
+    return false;
+#else
+    // uint32_t (Value* frame, JitContext* context). rbp is pushed only to
+    // keep the stack 16-byte aligned for helper calls.
+    bytes({0x53, 0x55, 0x41, 0x54});  // push rbx; push rbp; push r12
+    bytes({0x48, 0x89, 0xFB});        // mov rbx, rdi
+    bytes({0x49, 0x89, 0xF4});        // mov r12, rsi
+
+    const std::vector<uint32_t>& words = bytecode.code;
+    for (size_t pc = 0; pc < words.size(); pc++) {
+        Op op = Bytecode::opcode(words[pc]);
+        if (!emitInstr(words[pc], pc)) {
+            reason = std::string("unsupported instruction ") + Bytecode::opName(op);
+            return false;
+        }
+        pc += Bytecode::extraWords(op);
+    }
+
+    // Success returns 0; a runtime error returns its code index + 1
+    bytes({0x31, 0xC0});              // xor eax, eax
+    size_t exit = code.size();
+    bytes({0x41, 0x5C, 0x5D, 0x5B});  // pop r12; pop rbp; pop rbx
+    byte(0xC3);
+
+    for (auto [position, pc] : errorJumps) {
+        uint32_t target = (uint32_t)(code.size() - (position + 4));
+        std::memcpy(&code[position], &target, 4);
+        byte(0xB8); imm32((uint32_t)pc + 1);     // mov eax, pc + 1
+        byte(0xE9); imm32((uint32_t)(exit - (code.size() + 4)));
+    }
+
+    size_t page = 4096;
+    mappingSize = (code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        reason = "could not map memory for code";
+        return false;
+    }
+    std::memcpy(memory, code.data(), code.size());
+    if (mprotect(memory, mappingSize, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, mappingSize);
+        reason = "could not make the code executable";
+        return false;
+    }
+    mapping = memory;
+    return true;
+#endif
+}
+
+bool JitCompiler::emitInstr(uint32_t word, size_t pc) {
+    Op op = Bytecode::opcode(word);
+    uint32_t arg = Bytecode::argument(word);
+    size_t top = stack.size() - 1;
+
+    switch (op) {
+        case Op::PUSH_INT:
+            push(JitOperand::CONSTANT, false, 0, (uint64_t)(int64_t)Bytecode::immediate(word));
+            return true;
+        case Op::PUSH_CONST:
+            push(JitOperand::CONSTANT, program->constantTypes[arg] == ValueType::FLOAT_TYPE, 0,
+                 program->constants[arg].ref);
+            return true;
+        case Op::LOAD:
+            push(JitOperand::SLOT, slotFloats[arg], arg);
+            return true;
+        case Op::STORE:
+            emitStore(arg);
+            return true;
+
+        case Op::ADD_I: case Op::SUB_I: case Op::MUL_I:
+            if (!fold(op)) emitIntBinary(op);
+            return true;
+        case Op::DIV_I: case Op::MOD_I:
+            if (!fold(op)) emitDivision(op, pc);
+            return true;
+        case Op::ADD_F: case Op::SUB_F: case Op::MUL_F: case Op::DIV_F:
+            if (!fold(op)) emitFloatBinary(op);
+            return true;
+        case Op::EQ_I: case Op::NE_I: case Op::LT_I: case Op::LE_I: case Op::GT_I: case Op::GE_I:
+            if (!fold(op)) emitIntCompare(op);
+            return true;
+        case Op::EQ_F: case Op::NE_F: case Op::LT_F: case Op::LE_F: case Op::GT_F: case Op::GE_F:
+            if (!fold(op)) emitFloatCompare(op);
+            return true;
+
+        // Everything else runs in C++ on operands in their frame homes
+        case Op::MOD_F:
+            if (fold(op)) return true;
+            toHome(top - 1);
+            toHome(top);
+            helperCall(helper(fmodHelper), top - 1, 0);
+            stack.pop_back();
+            return true;
+        case Op::EQ_S: case Op::NE_S: case Op::LT_S: case Op::LE_S: case Op::GT_S: case Op::GE_S:
+        case Op::CONCAT:
+            toHome(top - 1);
+            toHome(top);
+            if (op == Op::CONCAT) {
+                helperCall(helper(concatHelper), top - 1, 0);
+            } else {
+                helperCall(helper(compareStringsHelper), top - 1, (int)op - (int)Op::EQ_S);
+            }
+            stack.pop_back();
+            return true;
+
+        case Op::INT_TO_FLOAT: {
+            if (stack[top].kind == JitOperand::CONSTANT) {
+                Value value;
+                value.f = (double)(int64_t)stack[top].bits;
+                stack[top] = JitOperand{JitOperand::CONSTANT, true, 0, value.ref};
+                return true;
+            }
+            JitOperand value = pop();
+            uint8_t reg = allocate(true);
+            operandInstr({0xF2}, true, {0x0F, 0x2A}, reg, value);  // cvtsi2sd reg, value
+            free(value);
+            push(JitOperand::REGISTER, true, reg);
+            return true;
+        }
+        case Op::INT_TO_STRING: case Op::FLOAT_TO_STRING: case Op::BOOL_TO_STRING: {
+            const ValueType types[] = {ValueType::INT_TYPE, ValueType::FLOAT_TYPE, ValueType::BOOL_TYPE};
+            toHome(top);
+            helperCall(helper(toStringHelper), top, (uint64_t)types[(int)op - (int)Op::INT_TO_STRING]);
+            stack[top].isFloat = false;
+            return true;
+        }
+
+        case Op::ARRAY_NEW: case Op::ARRAY_CONST: {
+            size_t count = op == Op::ARRAY_NEW ? program->code[pc + 1] : 0;
+            size_t first = stack.size() - count;
+            for (size_t entry = first; entry < stack.size(); entry++) {
+                toHome(entry);
+            }
+            helperCall(helper(arrayNewHelper), first, pc);
+            instr({}, true, {0x83}, 7, true, base + (uint32_t)first);  // cmp qword [home], -1
+            byte(0xFF);
+            bytes({0x0F, 0x84});                                       // je error
+            errorJumps.emplace_back(code.size(), (uint32_t)pc);
+            imm32(0);
+            stack.resize(first);
+            push(JitOperand::HOME, false, base + (uint32_t)first);
+            return true;
+        }
+
+        case Op::WRITE_TEXT:
+            helperCall(helper(writeTextHelper), stack.size(), arg);
+            return true;
+        case Op::WRITE_INT: case Op::WRITE_FLOAT: case Op::WRITE_BOOL: case Op::WRITE_STRING: {
+            const ValueType types[] = {ValueType::INT_TYPE, ValueType::FLOAT_TYPE, ValueType::BOOL_TYPE,
+                                       ValueType::STRING_TYPE};
+            toHome(top);
+            helperCall(helper(writeValueHelper), top, (uint64_t)types[(int)op - (int)Op::WRITE_INT]);
+            stack.pop_back();
+            return true;
+        }
+        case Op::WRITE_ARRAY:
+            toHome(top);
+            helperCall(helper(writeArrayHelper), top, 0);
+            stack.pop_back();
+            return true;
+        case Op::WRITE_NEWLINE:
+            helperCall(helper(writeNewlineHelper), stack.size(), 0);
+            return true;
+        case Op::HALT:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+void JitCompiler::emitStore(uint32_t slot) {
+    // Pending loads of this slot must read the old value
+    for (size_t entry = 0; entry + 1 < stack.size(); entry++) {
+        if (stack[entry].kind == JitOperand::SLOT && stack[entry].index == slot) toHome(entry);
+    }
+
+    JitOperand value = pop();
+    switch (value.kind) {
+        case JitOperand::CONSTANT:
+            if (fitsImm32(value.bits)) {
+                instr({}, true, {0xC7}, 0, true, slot);  // mov qword [slot], imm32
+                imm32((uint32_t)value.bits);
+            } else {
+                load(RAX, JitOperand{JitOperand::CONSTANT, false, 0, value.bits});
+                instr({}, true, {0x89}, RAX, true, slot);
+            }
+            break;
+        case JitOperand::REGISTER:
+            if (value.isFloat) {
+                instr({0xF2}, false, {0x0F, 0x11}, (uint8_t)value.index, true, slot);
+            } else {
+                instr({}, true, {0x89}, (uint8_t)value.index, true, slot);
+            }
+            free(value);
+            break;
+        default:
+            operandInstr({}, true, {0x8B}, RAX, value);
+            instr({}, true, {0x89}, RAX, true, slot);
+            break;
+    }
+    slotFloats[slot] = value.isFloat;
+}
+
+// Int arithmetic wraps around: the hardware already does
+void JitCompiler::emitIntBinary(Op op) {
+    JitOperand right = pop();
+    uint8_t reg = toRegister(stack.size() - 1);
+
+    if (right.kind == JitOperand::CONSTANT && fitsImm32(right.bits)) {
+        if (op == Op::MUL_I) {
+            instr({}, true, {0x69}, reg, false, reg);                           // imul reg, reg, imm32
+        } else {
+            instr({}, true, {0x81}, op == Op::ADD_I ? 0 : 5, false, reg);       // add/sub reg, imm32
+        }
+        imm32((uint32_t)right.bits);
+        return;
+    }
+    if (right.kind == JitOperand::CONSTANT) {
+        load(RAX, right);
+        right = JitOperand{JitOperand::REGISTER, false, RAX, 0};
+    }
+    if (op == Op::ADD_I) operandInstr({}, true, {0x03}, reg, right);
+    else if (op == Op::SUB_I) operandInstr({}, true, {0x2B}, reg, right);
+    else operandInstr({}, true, {0x0F, 0xAF}, reg, right);
+    free(right);
+}
+
+void JitCompiler::emitFloatBinary(Op op) {
+    const uint8_t forms[] = {0x58, 0x5C, 0x59, 0x5E};  // addsd, subsd, mulsd, divsd
+    JitOperand right = pop();
+    uint8_t reg = toRegister(stack.size() - 1);
+    if (right.kind == JitOperand::CONSTANT) {
+        load(XMM0, right);
+        right = JitOperand{JitOperand::REGISTER, true, XMM0, 0};
+    }
+    operandInstr({0xF2}, false, {0x0F, forms[(int)op - (int)Op::ADD_F]}, reg, right);
+    free(right);
+}
+
+// Division by zero leaves through an error stub; x / -1 is negation and
+// x % -1 is 0, so INT64_MIN / -1 wraps instead of trapping
+void JitCompiler::emitDivision(Op op, size_t pc) {
+    JitOperand right = pop();
+    JitOperand left = pop();
+    load(RAX, left);
+    load(RCX, right);
+    free(left);
+    free(right);
+
+    // A constant divisor other than 0 and -1 needs no checks
+    if (right.kind != JitOperand::CONSTANT || right.bits == 0 || (int64_t)right.bits == -1) {
+        bytes({0x48, 0x85, 0xC9});            // test rcx, rcx
+        bytes({0x0F, 0x84});                  // jz error
+        errorJumps.emplace_back(code.size(), (uint32_t)pc);
+        imm32(0);
+        bytes({0x48, 0x83, 0xF9, 0xFF});      // cmp rcx, -1
+        if (op == Op::DIV_I) {
+            bytes({0x75, 0x05});              // jne divide
+            bytes({0x48, 0xF7, 0xD8});        // neg rax
+        } else {
+            bytes({0x75, 0x04});
+            bytes({0x31, 0xD2});              // xor edx, edx
+        }
+        bytes({0xEB, 0x05});                  // jmp done
+    }
+    bytes({0x48, 0x99});                  // divide: cqo
+    bytes({0x48, 0xF7, 0xF9});            // idiv rcx
+
+    uint8_t reg = allocate(false);
+    instr({}, true, {0x8B}, reg, false, op == Op::DIV_I ? RAX : RDX);
+    push(JitOperand::REGISTER, false, reg);
+}
+
+void JitCompiler::emitIntCompare(Op op) {
+    JitOperand right = pop();
+    uint8_t reg = toRegister(stack.size() - 1);
+    if (right.kind == JitOperand::CONSTANT && fitsImm32(right.bits)) {
+        instr({}, true, {0x81}, 7, false, reg);  // cmp reg, imm32
+        imm32((uint32_t)right.bits);
+    } else {
+        if (right.kind == JitOperand::CONSTANT) {
+            load(RAX, right);
+            right = JitOperand{JitOperand::REGISTER, false, RAX, 0};
+        }
+        operandInstr({}, true, {0x3B}, reg, right);  // cmp reg, right
+        free(right);
+    }
+    bytes({0x0F, SIGNED_SETCC[(int)op - (int)Op::EQ_I], 0xC0});  // setcc al
+    instr({}, false, {0x0F, 0xB6}, reg, false, RAX);              // movzx reg32, al
+}
+
+// ucomisd reports unordered (NaN) as ZF=PF=CF=1. `a < b` is tested as
+// `b > a` so that every ordered test is seta/setae, which are false on NaN;
+// == also needs PF clear and != accepts PF set.
+void JitCompiler::emitFloatCompare(Op op) {
+    JitOperand right = pop();
+    JitOperand left = pop();
+    bool swap = op == Op::LT_F || op == Op::LE_F;
+    JitOperand first = swap ? right : left;
+    JitOperand second = swap ? left : right;
+
+    if (first.kind != JitOperand::REGISTER) {
+        load(XMM0, first);
+        first = JitOperand{JitOperand::REGISTER, true, XMM0, 0};
+    }
+    if (second.kind == JitOperand::CONSTANT) {
+        load(XMM1, second);
+        second = JitOperand{JitOperand::REGISTER, true, XMM1, 0};
+    }
+    operandInstr({0x66}, false, {0x0F, 0x2E}, (uint8_t)first.index, second);  // ucomisd first, second
+    free(left);
+    free(right);
+
+    switch (op) {
+        case Op::EQ_F:
+            bytes({0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8});  // sete al; setnp cl; and al, cl
+            break;
+        case Op::NE_F:
+            bytes({0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8});  // setne al; setp cl; or al, cl
+            break;
+        case Op::LT_F: case Op::GT_F:
+            bytes({0x0F, 0x97, 0xC0});  // seta al
+            break;
+        default:
+            bytes({0x0F, 0x93, 0xC0});  // setae al
+            break;
+    }
+    uint8_t reg = allocate(false);
+    instr({}, false, {0x0F, 0xB6}, reg, false, RAX);  // movzx reg32, al
+    push(JitOperand::REGISTER, false, reg);
+}
+
+// Folds an operation on two constants with the VM's semantics. Division by
+// a constant zero is left alone so that it still fails at run time.
+bool JitCompiler::fold(Op op) {
+    size_t count = stack.size();
+    if (count < 2 || stack[count - 1].kind != JitOperand::CONSTANT || stack[count - 2].kind != JitOperand::CONSTANT) {
+        return false;
+    }
+    Value a, b, result;
+    a.ref = stack[count - 2].bits;
+    b.ref = stack[count - 1].bits;
+    bool isFloat = false;
+
+    switch (op) {
+        case Op::ADD_I: result.i = (int64_t)((uint64_t)a.i + (uint64_t)b.i); break;
+        case Op::SUB_I: result.i = (int64_t)((uint64_t)a.i - (uint64_t)b.i); break;
+        case Op::MUL_I: result.i = (int64_t)((uint64_t)a.i * (uint64_t)b.i); break;
+        case Op::DIV_I:
+            if (b.i == 0) return false;
+            result.i = b.i == -1 ? (int64_t)(0 - (uint64_t)a.i) : a.i / b.i;
+            break;
+        case Op::MOD_I:
+            if (b.i == 0) return false;
+            result.i = b.i == -1 ? 0 : a.i % b.i;
+            break;
+        case Op::ADD_F: result.f = a.f + b.f; isFloat = true; break;
+        case Op::SUB_F: result.f = a.f - b.f; isFloat = true; break;
+        case Op::MUL_F: result.f = a.f * b.f; isFloat = true; break;
+        case Op::DIV_F: result.f = a.f / b.f; isFloat = true; break;
+        case Op::MOD_F: result.f = std::fmod(a.f, b.f); isFloat = true; break;
+        case Op::EQ_I: result.i = a.i == b.i; break;
+        case Op::NE_I: result.i = a.i != b.i; break;
+        case Op::LT_I: result.i = a.i < b.i; break;
+        case Op::LE_I: result.i = a.i <= b.i; break;
+        case Op::GT_I: result.i = a.i > b.i; break;
+        case Op::GE_I: result.i = a.i >= b.i; break;
+        case Op::EQ_F: result.i = a.f == b.f; break;
+        case Op::NE_F: result.i = a.f != b.f; break;
+        case Op::LT_F: result.i = a.f < b.f; break;
+        case Op::LE_F: result.i = a.f <= b.f; break;
+        case Op::GT_F: result.i = a.f > b.f; break;
+        case Op::GE_F: result.i = a.f >= b.f; break;
+        default: return false;
+    }
+    stack.pop_back();
+    stack.back() = JitOperand{JitOperand::CONSTANT, isFloat, 0, result.ref};
+    return true;
+}
+
+bool JitCompiler::run(RuntimeError& error) {
+#ifdef AW_JIT_SUPPORTED
+    JitContext context{program, std::vector<std::string>(program->strings.begin(), program->strings.end()), {},
+                       &OutputBuffer::standardOutput()};
+    std::vector<Value> frame(program->slotNames.size() + program->maxStack + 1);
+    auto entry = (uint32_t (*)(Value*, JitContext*))mapping;
+    uint32_t status = entry(frame.data(), &context);
+    context.out->flush();
+    if (status != 0) {
+        const uint32_t* words = &program->code[status - 1];
+        switch (Bytecode::opcode(words[0])) {
+            case Op::ARRAY_NEW: error.message = arrayAllocationError(Bytecode::wide(words + 2)); break;
+            case Op::ARRAY_CONST: error.message = arrayAllocationError(Bytecode::wide(words + 3)); break;
+            default: error.message = "Division by zero"; break;
+        }
+        error.offset = program->offsets[status - 1];
+        return false;
+    }
+    return true;
+#else
+    (void)error;
+    return false;
+#endif
+}
+
+void JitCompiler::release() {
+#ifdef AW_JIT_SUPPORTED
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+    }
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "codegen.hpp"
+#include "vm.hpp"
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define AW_JIT_SUPPORTED 1
+#endif
+
+// Where a value on the JIT's compile-time stack currently lives. Stack entry
+// k has a home in the frame (after the variable slots) that it is written
+// to when a helper call needs it in memory or its register is taken.
+struct JitOperand {
+    enum Kind : uint8_t {
+        CONSTANT,  // `bits`, not materialized yet
+        SLOT,      // still just a variable slot (`index`), loaded on use
+        REGISTER,  // general or xmm register `index`
+        HOME       // in its frame home
+    };
+    Kind kind;
+    bool isFloat;
+    uint32_t index;
+    uint64_t bits;
+};
+
+// In-process x86-64 compiler for Bytecode, for running a program without
+// writing any files. Code is generated into a writable buffer, copied into
+// an mmap'd region that is then made executable and never writable (W^X),
+// and called directly.
+//
+// Straight-line bytecode has a known stack at every instruction, so the
+// compiler replays it on JitOperands instead of emitting stack traffic:
+// constants and variable loads stay lazy until an instruction can use them
+// as immediates or memory operands, operations on constants are folded, and
+// temporaries sit in caller-saved registers. The typed opcodes pick the int
+// or SSE2 float instruction forms. Strings, arrays and output go through
+// helper calls into C++ that share the VM's heap layout and printing.
+class JitCompiler {
+private:
+    const Bytecode* program = nullptr;
+    std::vector<uint8_t> code;
+    std::vector<std::pair<size_t, uint32_t>> errorJumps;  // rel32 position, code index
+    std::vector<JitOperand> stack;
+    std::vector<bool> slotFloats;
+    uint32_t base = 0;  // frame index of stack entry 0
+    bool usedRegisters[2][16] = {};
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+
+    // Encoding. `memory` operands are frame indices addressed off rbx.
+    void byte(uint8_t value) { code.push_back(value); }
+    void bytes(std::initializer_list<uint8_t> values) { code.insert(code.end(), values); }
+    void imm32(uint32_t value);
+    void imm64(uint64_t value);
+    void instr(std::initializer_list<uint8_t> prefix, bool wide, std::initializer_list<uint8_t> opcode,
+               uint8_t reg, bool memory, uint32_t rm);
+    void operandInstr(std::initializer_list<uint8_t> prefix, bool wide, std::initializer_list<uint8_t> opcode,
+                      uint8_t reg, const JitOperand& operand);
+
+    // Operand stack
+    void push(JitOperand::Kind kind, bool isFloat, uint32_t index, uint64_t bits = 0);
+    JitOperand pop();
+    uint8_t allocate(bool isFloat);
+    void free(const JitOperand& operand);
+    void spill(size_t entry);
+    void spillAll();
+    void load(uint8_t reg, const JitOperand& operand);
+    uint8_t toRegister(size_t entry);
+    void toHome(size_t entry);
+    void helperCall(void* helper, size_t entry, uint64_t argument, uint64_t extra = 0);
+
+    bool emitInstr(uint32_t word, size_t pc);
+    void emitStore(uint32_t slot);
+    void emitIntBinary(Op op);
+    void emitFloatBinary(Op op);
+    void emitDivision(Op op, size_t pc);
+    void emitIntCompare(Op op);
+    void emitFloatCompare(Op op);
+    bool fold(Op op);
+    void release();
+
+public:
+    JitCompiler() = default;
+    JitCompiler(const JitCompiler&) = delete;
+    JitCompiler& operator=(const JitCompiler&) = delete;
+    ~JitCompiler() { release(); }
+
+    // False, with the reason, if the program has to fall back to the VM
+    bool compileProgram(const Bytecode& bytecode, std::string& reason);
+
+    // Same contract as VirtualMachine::run
+    bool run(RuntimeError& error);
+
+    size_t codeSize() const { return code.size(); }
+};
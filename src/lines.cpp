@@ -0,0 +1,28 @@
+#include "lines.hpp"
+#include "scan.hpp"
+#include <algorithm>
+
+void LineTable::build(std::string_view content) {
+    source = content;
+    starts.clear();
+    starts.push_back(0);
+    Scan::collectLineStarts(content.data(), 0, content.size(), starts);
+}
+
+SourceLocation LineTable::locate(uint32_t offset) const {
+    // Last line start that is <= offset
+    auto it = std::upper_bound(starts.begin(), starts.end(), offset);
+    size_t index = (size_t)(it - starts.begin()) - 1;
+    return SourceLocation{(int)index + 1, (int)(offset - starts[index]) + 1};
+}
+
+size_t LineTable::lineCount() const {
+    if (starts.empty()) return 0;
+    return starts.back() == source.size() ? starts.size() - 1 : starts.size();
+}
+
+std::string_view LineTable::lineText(int line) const {
+    size_t start = starts[line - 1];
+    size_t end = (size_t)line < starts.size() ? starts[line] - 1 : source.size();
+    return source.substr(start, end - start);
+}
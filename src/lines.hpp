@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 1-based line and column of a byte in the source
+struct SourceLocation {
+    int line;
+    int column;
+};
+
+// Byte offsets of the start of every line in a source buffer. Tokens and AST
+// nodes only record a byte offset; line/column are resolved through this
+// table (binary search) when a diagnostic or dump actually needs them.
+// The table does not own the source, which must outlive it.
+class LineTable {
+private:
+    std::string_view source;
+    std::vector<uint32_t> starts;
+
+public:
+    LineTable() = default;
+
+    void build(std::string_view content);
+    SourceLocation locate(uint32_t offset) const;
+
+    // Same line count as splitting with std::getline: a trailing newline
+    // does not start a new line
+    size_t lineCount() const;
+    // Text of a 1-based line, without its '\n'
+    std::string_view lineText(int line) const;
+};
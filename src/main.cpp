@@ -1,118 +1,940 @@
 #include "ast.hpp"
+#include "ast_image.hpp"
+#include "cache.hpp"
+#include "codegen.hpp"
+#include "flat_ast.hpp"
+#include "ir.hpp"
+#include "jit.hpp"
+#include "native.hpp"
 #include "parser.hpp"
+#include "passes.hpp"
 #include "error.hpp"
 #include "semantic.hpp"
+#include "server.hpp"
+#include "session.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
+#include "transpiler.hpp"
+#include "vm.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
 
-std::string read_file(const char* filename) {
-  std::ifstream file(filename, std::ios::binary);
-
-  return std::string(
-        (std::istreambuf_iterator<char>(file)),
-        std::istreambuf_iterator<char>()
-    );
+std::string tokensToText(const std::vector<TokenData>& tokens, std::string_view source) {
+  std::string text;
+  for (const auto& token : tokens) {
+    text += LexerEngine::tokenTypeToString(token.type);
+    text += ' ';
+    text += LexerEngine::tokenText(token, source);
+    text += '\n';
+  }
+  return text;
 }
 
-int writeTokenToFile(const char* filename, std::vector<TokenData>& tokens ) {
+int writeASTToFile(const std::string& filename, std::string ast_rep, std::ostream& err){
   std::ofstream file(filename, std::ios::binary);
   if (!file) {
-    std::cerr << "Error opening file for writing: " << filename << "\n";
+    err << "Error opening file for writing: " << filename << "\n";
     return 1;
   }
 
-  for (const auto& token : tokens) {
-    file << LexerEngine::tokenTypeToString(token.type) << " " << token.value << "\n";
-  }
+  file << ast_rep;
 
   file.close();
   return 0;
 }
 
-int writeASTToFile(const char* filename, std::string ast_rep){
-  std::ofstream file(filename, std::ios::binary);
-  if (!file) {
-    std::cerr << "Error opening file for writing: " << filename << "\n";
+int printUsage() {
+  std::cout << "Please give a file name.\nUsage:\tcompiler.exe [-O0] [--pass-stats] [--stats[=json]] [-j N] <file|directory|pattern>...\n"
+            << "\tcompiler.exe [--cache[=DIR]] [--cache-size=MB] [--cache-stats] [-O0] [-j N] <file|directory|pattern>...\n"
+            << "\tcompiler.exe run [--jit|--jit-stats] [--dispatch=switch|threaded] [--repeat=N] [--stats[=json]] <filename>\n"
+            << "\tcompiler.exe build [--backend=native|c] [-j N] [-o <executable>] <file|directory|pattern>...\n"
+            << "\tcompiler.exe ast [-o <image>] <filename>\n"
+            << "\tcompiler.exe ast --check <filename>...\n"
+            << "\tcompiler.exe ast --dump <image>...\n"
+            << "\tcompiler.exe ast --bench=N <filename>\n"
+            << "\tcompiler.exe keywords --bench=N <filename>\n"
+            << "\tcompiler.exe serve [--socket=PATH] [-j N]\n"
+            << "\tcompiler.exe client [--socket=PATH] [-O0] [--emit=lexer|ast|ssa|bytecode] [--bench=N [--connections=C]] <filename>|-\n"
+            << "\tcompiler.exe client [--socket=PATH] --stop\n";
+  return 1;
+}
+
+namespace {
+
+// `run` executes the program instead of writing IR files and stays quiet
+// apart from the program's own output and diagnostics. `build` produces a
+// native executable, either directly or through C and the host compiler.
+// A plain compile can reuse earlier results from `cache`.
+struct Options {
+  bool run = false;
+  bool build = false;
+  VirtualMachine::Dispatch dispatch = VirtualMachine::defaultDispatch();
+  long repeat = 1;
+  bool cBackend = false;
+  bool useJit = false;
+  bool jitStats = false;
+  bool optimize = true;
+  bool passStats = false;
+  enum class Stats { NONE, TABLE, JSON } stats = Stats::NONE;
+  CompilationCache* cache = nullptr;
+};
+
+// Files one compilation writes: the IR dumps of a plain compile or the
+// executable of `build` (its .s or .c goes next to it)
+struct Outputs {
+  std::string lexerIR = "output.lexerIR";
+  std::string astIR = "output.astIR";
+  std::string ssaIR = "output.ssaIR";
+  std::string bytecodeIR = "output.bytecodeIR";
+  std::string executable;
+};
+
+// Compiles (and runs or builds) one file. Progress goes to `out`, errors and
+// diagnostics to `err`; the program's own output in run mode goes straight
+// to stdout. Returns the process exit status. The contents of the IR files
+// are also left in `record`, if given, once they were all written.
+int compilePhases(const Options& options, const char* filename, const Outputs& outputs, std::ostream& out,
+                  std::ostream& err, CacheEntry* record, CompileStatistics& stats) {
+  using Clock = std::chrono::steady_clock;
+  auto millis = [](Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  };
+  Clock::time_point frontEndStart = Clock::now();
+
+  // The session owns the source and the diagnostics reported against it;
+  // the buffer backs every token, so it lives until the compilation is done
+  CompilationSession session;
+  ErrorHandler& errors = session.errors();
+  if (!session.open(filename)) {
+    err << "\033[31m\033[1merror\033[0m: could not read `" << filename << "`" << std::endl;
     return 1;
   }
+  std::string_view content = session.content();
 
-  file << ast_rep;
+  if (!options.run) out << "Compiling " << filename << "...\n";
+
+  // Identifiers are interned once at lex time; later passes work on SymbolIds
+  StringInterner symbols;
+
+  // Tokens are pulled from the lexer as the parser needs them
+  if (!options.run) out << "Parsing...\n";
+  stats.begin("parse");
+  Parser parser(content, symbols, errors);
+
+  // The parser writes the tree straight into the compact index-based
+  // encoding that every later pass walks
+  FlatAST flatAst;
+
+  if (!options.run) out << "Generating AST...\n";
+  ASTParser::parseProgram(parser, flatAst);
+  stats.end({{"tokens", parser.lexed}, {"symbols", symbols.size()}, {"nodes", flatAst.nodeCount()},
+             {"diagnostics", errors.getErrorCount() + errors.getWarningCount()}});
+
+  // Check for syntax errors before proceeding
+  if (errors.hasAnyErrors()) {
+    errors.printErrors(err);
+    return 1;
+  }
+
+  if (!options.run) out << "Performing semantic analysis...\n";
+  SemanticAnalyzer semanticAnalyzer;
+  stats.begin("analyze");
+  bool semanticSuccess = semanticAnalyzer.analyzeProgram(flatAst, errors);
+  stats.end({{"diagnostics", errors.getErrorCount() + errors.getWarningCount()}});
+
+  // Check for semantic errors
+  if (errors.hasAnyErrors()) {
+    errors.printErrors(err);
+    return 1;
+  }
+
+  if (!semanticSuccess) {
+    err << "\033[31m\033[1m✗ Semantic analysis failed!\033[0m" << std::endl;
+    return 1;
+  }
+
+  // Every backend starts from bytecode generated from the optimized SSA IR
+  Clock::time_point lowerStart = Clock::now();
+  stats.begin("lower");
+  IRProgram ir;
+  IRBuilder irBuilder;
+  bool lowered = irBuilder.buildProgram(flatAst, semanticAnalyzer, ir, errors);
+  stats.end({{"instructions", ir.instructionCount()}});
+
+  if (errors.hasAnyErrors() || !lowered) {
+    errors.printErrors(err);
+    return 1;
+  }
+
+  PassManager passes;
+  passes.record("lower", millis(lowerStart, Clock::now()), 0, ir.instructionCount());
+  if (options.optimize) passes.addStandardPipeline();
+  stats.begin("optimize");
+  passes.run(ir);
+  stats.end({{"instructions", ir.instructionCount()}});
+
+  Clock::time_point bytecodeStart = Clock::now();
+  stats.begin("bytecode");
+  Bytecode bytecode;
+  BytecodeCompiler bytecodeCompiler;
+  bytecodeCompiler.compileProgram(ir, bytecode);
+  stats.end({{"words", bytecode.code.size()}});
+  passes.record("bytecode", millis(bytecodeStart, Clock::now()), ir.instructionCount(), bytecode.code.size());
+
+  if (options.passStats) {
+    err << passes.report();
+  }
+
+  if (options.run) {
+    // The JIT falls back to the VM for anything it cannot compile
+    Clock::time_point codegenStart = Clock::now();
+    JitCompiler jit;
+    bool jitReady = false;
+    if (options.useJit) {
+      std::string reason;
+      stats.begin("jit");
+      jitReady = jit.compileProgram(bytecode, reason);
+      stats.end({{"bytes", jitReady ? jit.codeSize() : 0}});
+      if (!jitReady && options.jitStats) {
+        err << "jit: " << reason << ", running on the interpreter" << std::endl;
+      }
+    }
+
+    Clock::time_point runStart = Clock::now();
+    stats.begin("execute");
+    for (long i = 0; i < options.repeat; i++) {
+      RuntimeError runtimeError;
+      bool finished = jitReady ? jit.run(runtimeError) : VirtualMachine::run(bytecode, runtimeError, options.dispatch);
+      if (!finished) {
+        stats.end({{"runs", i + 1}});
+        errors.addRuntimeError(runtimeError.message, runtimeError.offset);
+        errors.printErrors(err);
+        return 1;
+      }
+    }
+    stats.end({{"runs", options.repeat}});
+
+    if (options.jitStats && jitReady) {
+      Clock::time_point end = Clock::now();
+      err << std::fixed << std::setprecision(3) << "jit: front end " << millis(frontEndStart, codegenStart)
+                << " ms, code generation " << millis(codegenStart, runStart) << " ms (" << jit.codeSize()
+                << " bytes), run " << millis(runStart, end) << " ms" << std::endl;
+    }
+    return 0;
+  }
+
+  if (options.build && options.cBackend) {
+    std::string cSource;
+    CTranspiler transpiler;
+    stats.begin("emit-c");
+    bool transpiled = transpiler.compileProgram(bytecode, session, cSource);
+    stats.end({{"bytes", cSource.size()}});
+    if (!transpiled) {
+      errors.printErrors(err);
+      return 1;
+    }
+
+    std::string cFile = outputs.executable + ".c";
+    if (writeASTToFile(cFile.c_str(), cSource, err) != 0) {
+      return 1;
+    }
+    out << "\033[34m  → C source written to " << cFile << "\033[0m" << std::endl;
+
+    stats.begin("cc");
+    bool compiled = CTranspiler::compileC(cFile, outputs.executable);
+    stats.end();
+    if (!compiled) {
+      err << "\033[31m\033[1m✗ C compilation failed!\033[0m" << std::endl;
+      return 1;
+    }
+    out << "\033[32m\033[1m✓ Built " << outputs.executable << "\033[0m" << std::endl;
+    return 0;
+  }
+
+  if (options.build) {
+    std::string assembly;
+    NativeCompiler nativeCompiler;
+    stats.begin("emit-asm");
+    bool generated = nativeCompiler.compileProgram(bytecode, session, assembly);
+    stats.end({{"bytes", assembly.size()}});
+    if (!generated) {
+      errors.printErrors(err);
+      return 1;
+    }
+
+    std::string assemblyFile = outputs.executable + ".s";
+    if (writeASTToFile(assemblyFile.c_str(), assembly, err) != 0) {
+      return 1;
+    }
+    out << "\033[34m  → Assembly written to " << assemblyFile << "\033[0m" << std::endl;
+
+    stats.begin("link");
+    bool linked = NativeCompiler::assembleAndLink(assemblyFile, outputs.executable);
+    stats.end();
+    if (!linked) {
+      err << "\033[31m\033[1m✗ Assembling or linking failed!\033[0m" << std::endl;
+      return 1;
+    }
+    out << "\033[32m\033[1m✓ Built " << outputs.executable << "\033[0m" << std::endl;
+    return 0;
+  }
+
+  out << "\033[32m\033[1m✓ Compilation successful!\033[0m" << std::endl;
+  
+  // Only write output files if compilation was successful. The lexer IR
+  // needs the whole token stream, so materialize it just for the dump.
+  const std::string* files[] = {&outputs.lexerIR, &outputs.astIR, &outputs.ssaIR, &outputs.bytecodeIR};
+  const char* labels[] = {"Lexer IR", "AST IR", "SSA IR", "Bytecode IR"};
+  const char* contents[] = {"lexer data", "AST data", "SSA IR", "bytecode"};
+  stats.begin("tokenize");
+  std::vector<TokenData> tokens = LexerEngine::tokenize(content);
+  stats.end({{"tokens", tokens.size()}});
+
+  stats.begin("write-ir");
+  std::vector<std::string> texts;
+  texts.push_back(tokensToText(tokens, content));
+  texts.push_back(flatAst.toString(flatAst.root, 0));
+  texts.push_back(ir.toString());
+  texts.push_back(bytecode.toString());
+
+  bool written = true;
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < texts.size(); i++) {
+    bytes += texts[i].size();
+    if (writeASTToFile(*files[i], texts[i], err) == 0) {
+      out << "\033[34m  → " << labels[i] << " written to " << *files[i] << "\033[0m" << std::endl;
+    } else {
+      err << "\033[31mFailed to write " << contents[i] << "\033[0m" << std::endl;
+      written = false;
+    }
+  }
+  stats.end({{"files", texts.size()}, {"bytes", bytes}});
+  if (record && written) {
+    texts[1] = ASTImage::serialize(flatAst, content);
+    record->artifacts = std::move(texts);
+  }
 
-  file.close();
   return 0;
 }
 
-int main(int argc, char **argv) {
+// compilePhases with --stats: the report follows the file's own diagnostics
+int compileFile(const Options& options, const char* filename, const Outputs& outputs, std::ostream& out,
+                std::ostream& err, CacheEntry* record = nullptr) {
+  CompileStatistics stats(options.stats != Options::Stats::NONE);
+  int status = compilePhases(options, filename, outputs, out, err, record, stats);
+  if (options.stats == Options::Stats::TABLE) {
+    err << stats.report();
+  } else if (options.stats == Options::Stats::JSON) {
+    err << stats.json(filename);
+  }
+  return status;
+}
 
-  if (argc < 2) {
-    std::cout << "Please give a file name.\nUsage:\tcompiler.exe <filename>\n";
-    return 1;
+// A plain compile through the cache: a file compiled before with the same
+// contents, name, flags and outputs gets its recorded messages and IR files
+// back without going through the compiler again. Everything else, pipes
+// (which can only be read once) and any file that cannot be read go
+// straight to compileFile.
+int compileCached(const Options& options, const char* filename, const Outputs& outputs, std::ostream& out,
+                  std::ostream& err) {
+  SourceBuffer source;
+  std::error_code error;
+  if (!options.cache || options.run || options.build || options.passStats || options.stats != Options::Stats::NONE ||
+      !std::filesystem::is_regular_file(filename, error) || !source.open(filename)) {
+    return compileFile(options, filename, outputs, out, err);
   }
 
-  char* output_file_parser = "output.lexerIR";
-  char* output_file_ast = "output.astIR";
+  std::string context = std::string(options.optimize ? "O1" : "O0") + '\0' + filename;
+  for (const std::string* file : {&outputs.lexerIR, &outputs.astIR, &outputs.ssaIR, &outputs.bytecodeIR}) {
+    context += '\0';
+    context += *file;
+  }
+  CacheKey key = CompilationCache::key(source.view(), context);
 
-  char* filename = argv[1];
+  CacheEntry entry;
+  if (options.cache->load(key, entry)) {
+    // The AST is kept as an image of the checked tree and dumped again here
+    ASTImage image;
+    FlatAST ast;
+    StringInterner symbols;
+    std::string error;
+    bool written = entry.artifacts.size() != 4 ||
+                   (image.adopt(std::move(entry.artifacts[1]), error) && image.load(ast, symbols, error));
+    if (written && entry.artifacts.size() == 4) entry.artifacts[1] = ast.toString(ast.root, 0);
 
-  std::string content = read_file(filename);
+    const std::string* files[] = {&outputs.lexerIR, &outputs.astIR, &outputs.ssaIR, &outputs.bytecodeIR};
+    std::ostringstream ignored;
+    for (size_t i = 0; i < entry.artifacts.size() && i < 4 && written; i++) {
+      written = writeASTToFile(*files[i], entry.artifacts[i], ignored) == 0;
+    }
+    // A file that cannot be written, or a damaged image, is handled by
+    // compiling normally
+    if (written) {
+      out << entry.out << std::flush;
+      err << entry.err << std::flush;
+      return entry.status;
+    }
+  }
 
-  std::cout << "Compiling " << filename << "...\n";
+  entry = CacheEntry();
+  std::ostringstream capturedOut, capturedErr;
+  int status = compileFile(options, filename, outputs, capturedOut, capturedErr, &entry);
+  entry.status = static_cast<uint8_t>(status);
+  entry.out = capturedOut.str();
+  entry.err = capturedErr.str();
+  out << entry.out << std::flush;
+  err << entry.err << std::flush;
 
-  // Clear any previous errors and set source content for context
-  g_errorHandler.clear();
-  g_errorHandler.setSourceContent(content, filename);
+  // Failed compiles are kept too (their diagnostics are the result), but
+  // not a success whose IR files could not all be written
+  if (status != 0 || entry.artifacts.size() == 4) options.cache->store(key, entry);
+  return status;
+}
 
-  std::cout << "Tokenizing...\n";
-  auto tokens = LexerEngine::tokenize(content);
+// `*` matches any run of characters and `?` any single one
+bool matchesPattern(std::string_view pattern, std::string_view name) {
+  size_t p = 0, n = 0;
+  size_t star = std::string_view::npos, starName = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      p++;
+      n++;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      starName = n;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      n = ++starName;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') p++;
+  return p == pattern.size();
+}
 
-  std::cout << "Parsing...\n";
-  Parser parser(tokens);
+// A directory stands for every .aw file below it and an argument with `*` or
+// `?` in its last component for the files in that directory matching it,
+// sorted so the order never depends on the file system. Anything else is
+// taken as a file name.
+bool expandInput(const std::string& input, std::vector<std::string>& files, bool& expanded) {
+  namespace fs = std::filesystem;
+  std::error_code error;
+  std::vector<std::string> found;
+  size_t slash = input.find_last_of('/');
+  std::string prefix = slash == std::string::npos ? "" : input.substr(0, slash + 1);
+  std::string name = input.substr(prefix.size());
 
-  std::cout << "Generating AST...\n";
-  auto ast = ASTParser::parseProgram(parser);
+  if (name.find_first_of("*?") != std::string::npos) {
+    fs::directory_iterator it(prefix.empty() ? "." : prefix, error), end;
+    for (; !error && it != end; it.increment(error)) {
+      std::string entryName = it->path().filename().string();
+      if (it->is_regular_file(error) && matchesPattern(name, entryName)) found.push_back(prefix + entryName);
+    }
+    if (found.empty()) {
+      std::cerr << "\033[31m\033[1merror\033[0m: no files match `" << input << "`" << std::endl;
+      return false;
+    }
+  } else if (fs::is_directory(input, error)) {
+    fs::recursive_directory_iterator it(input, error), end;
+    for (; !error && it != end; it.increment(error)) {
+      if (it->path().extension() == ".aw" && it->is_regular_file(error)) found.push_back(it->path().string());
+    }
+    if (found.empty()) {
+      std::cerr << "\033[31m\033[1merror\033[0m: no .aw files in `" << input << "`" << std::endl;
+      return false;
+    }
+  } else {
+    files.push_back(input);
+    return true;
+  }
 
-  // Check for syntax errors before proceeding
-  if (g_errorHandler.hasAnyErrors()) {
-    g_errorHandler.printErrors();
-    return 1;
+  std::sort(found.begin(), found.end());
+  files.insert(files.end(), found.begin(), found.end());
+  expanded = true;
+  return true;
+}
+
+// In a batch every file's outputs are named after it and sit next to it:
+// a/b.aw gets a/b.lexerIR and so on, or the executable a/b
+Outputs batchOutputs(const std::string& filename) {
+  std::string stem = filename;
+  size_t slash = stem.find_last_of('/');
+  size_t dot = stem.find_last_of('.');
+  if (dot != std::string::npos && dot > (slash == std::string::npos ? 0 : slash + 1)) stem.erase(dot);
+
+  Outputs outputs;
+  outputs.lexerIR = stem + ".lexerIR";
+  outputs.astIR = stem + ".astIR";
+  outputs.ssaIR = stem + ".ssaIR";
+  outputs.bytecodeIR = stem + ".bytecodeIR";
+  outputs.executable = stem == filename ? stem + ".out" : stem;
+  return outputs;
+}
+
+// Compiles the files on a thread pool. Every file has its own session, so
+// workers report diagnostics without ever touching each other's; each
+// file's progress and diagnostics are collected while it compiles and
+// merged here into one report, in the order the files were given, as soon
+// as it and every file before it are done.
+int compileBatch(const Options& options, const std::vector<std::string>& files, size_t jobs) {
+  struct Result {
+    std::ostringstream out;
+    std::ostringstream err;
+    int status = 0;
+    bool done = false;
+  };
+  std::vector<Result> results(files.size());
+  std::mutex mutex;
+  std::condition_variable finished;
+  size_t failures = 0;
+
+  {
+    ThreadPool pool(std::min(jobs, files.size()));
+    for (size_t i = 0; i < files.size(); i++) {
+      pool.submit([&, i] {
+        Result& result = results[i];
+        int status = compileCached(options, files[i].c_str(), batchOutputs(files[i]), result.out, result.err);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          result.status = status;
+          result.done = true;
+        }
+        finished.notify_all();
+      });
+    }
+
+    for (Result& result : results) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&result] { return result.done; });
+      }
+      std::cout << result.out.str() << std::flush;
+      std::cerr << result.err.str() << std::flush;
+      if (result.status != 0) failures++;
+    }
   }
 
-  if (!ast) {
-    std::cerr << "\033[31m\033[1m✗ AST generation failed!\033[0m" << std::endl;
+  if (failures > 0) {
+    std::cerr << "\033[31m\033[1merror\033[0m: " << failures << " of " << files.size() << " files failed" << std::endl;
     return 1;
   }
+  std::cout << "\033[32m\033[1m✓ " << (options.build ? "Built " : "Compiled ") << files.size() << " files\033[0m"
+            << std::endl;
+  return 0;
+}
 
-  std::cout << "Performing semantic analysis...\n";
-  SemanticAnalyzer semanticAnalyzer;
-  bool semanticSuccess = semanticAnalyzer.analyzeProgram(ast.get());
+// Parses and checks the session's source into `flatAst`, printing any
+// diagnostics. Returns false if the program has errors.
+bool checkedAST(CompilationSession& session, StringInterner& symbols, FlatAST& flatAst) {
+  ErrorHandler& errors = session.errors();
+  Parser parser(session.content(), symbols, errors);
+  ASTParser::parseProgram(parser, flatAst);
+  bool analyzed = false;
+  if (!errors.hasAnyErrors()) {
+    SemanticAnalyzer analyzer;
+    analyzed = analyzer.analyzeProgram(flatAst, errors);
+  }
+  if (errors.hasAnyErrors()) errors.printErrors(std::cerr);
+  return analyzed && !errors.hasAnyErrors();
+}
 
-  // Check for semantic errors
-  if (g_errorHandler.hasAnyErrors()) {
-    g_errorHandler.printErrors();
+// Optimized SSA IR of a checked tree, to compare two trees by what they compile to
+std::string loweredIR(const FlatAST& flatAst, ErrorHandler& errors) {
+  SemanticAnalyzer analyzer;
+  IRProgram ir;
+  IRBuilder builder;
+  if (!analyzer.analyzeProgram(flatAst, errors) || !builder.buildProgram(flatAst, analyzer, ir, errors)) return "";
+  PassManager passes;
+  passes.addStandardPipeline();
+  passes.run(ir);
+  return ir.toString();
+}
+
+// `ast --dump` loads existing images and prints their trees like the AST IR
+// file, or why an image was rejected
+int dumpAstImages(const std::vector<const char*>& images) {
+  int status = 0;
+  for (const char* imagePath : images) {
+    ASTImage image;
+    StringInterner symbols;
+    FlatAST ast;
+    std::string error;
+    if (!image.open(imagePath, error) || !image.load(ast, symbols, error)) {
+      std::cerr << "\033[31m\033[1merror\033[0m: " << error << std::endl;
+      status = 1;
+      continue;
+    }
+    std::cout << ast.toString(ast.root, 0);
+  }
+  return status;
+}
+
+// `ast` writes the checked tree of a file as a binary image. --check makes
+// the round trip through an image file for each file and verifies that the
+// loaded tree dumps and compiles exactly like the parsed one; --bench times
+// loading an image against parsing and checking the source again.
+int runAstImage(int argc, char **argv) {
+  std::string imagePath = "output.awast";
+  bool check = false;
+  bool dump = false;
+  long benchmark = 0;
+  std::vector<const char*> inputs;
+  for (int i = 2; i < argc; i++) {
+    if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      imagePath = argv[++i];
+    } else if (std::strcmp(argv[i], "--check") == 0) {
+      check = true;
+    } else if (std::strcmp(argv[i], "--dump") == 0) {
+      dump = true;
+    } else if (std::strncmp(argv[i], "--bench=", 8) == 0) {
+      benchmark = std::strtol(argv[i] + 8, nullptr, 10);
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty() || (!check && !dump && inputs.size() > 1)) {
+    return printUsage();
+  }
+  if (dump) {
+    return dumpAstImages(inputs);
+  }
+
+  int status = 0;
+  for (const char* filename : inputs) {
+    CompilationSession session;
+    if (!session.open(filename)) {
+      std::cerr << "\033[31m\033[1merror\033[0m: could not read `" << filename << "`" << std::endl;
+      status = 1;
+      continue;
+    }
+    StringInterner symbols;
+    FlatAST flatAst;
+    if (!checkedAST(session, symbols, flatAst)) {
+      status = 1;
+      continue;
+    }
+
+    if (!ASTImage::write(imagePath, flatAst, session.content())) {
+      std::cerr << "\033[31m\033[1merror\033[0m: could not write `" << imagePath << "`" << std::endl;
+      return 1;
+    }
+    if (!check && benchmark <= 0) {
+      std::cout << "\033[32m\033[1m✓ AST image written to " << imagePath << "\033[0m" << std::endl;
+      return 0;
+    }
+
+    ASTImage image;
+    StringInterner loadedSymbols;
+    FlatAST loaded;
+    std::string error;
+    if (!image.open(imagePath, error) || !image.load(loaded, loadedSymbols, error)) {
+      std::cerr << "\033[31m\033[1merror\033[0m: " << error << std::endl;
+      status = 1;
+      continue;
+    }
+
+    if (check) {
+      bool same = image.sourceHash() == ASTImage::hashSource(session.content()) &&
+                  loaded.toString(loaded.root, 0) == flatAst.toString(flatAst.root, 0) &&
+                  loweredIR(loaded, session.errors()) == loweredIR(flatAst, session.errors());
+      if (same) {
+        std::cout << "\033[32m✓\033[0m " << filename << ": " << loaded.nodeCount() << " nodes round trip" << std::endl;
+      } else {
+        std::cout << "\033[31m✗\033[0m " << filename << ": loaded tree differs" << std::endl;
+        status = 1;
+      }
+      continue;
+    }
+
+    // Both sides start from bytes in memory: the source text, or the image
+    // already in the page cache
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < benchmark; i++) {
+      CompilationSession again;
+      again.openText(filename, std::string(session.content()));
+      StringInterner againSymbols;
+      FlatAST againAst;
+      checkedAST(again, againSymbols, againAst);
+    }
+    Clock::time_point parsed = Clock::now();
+    for (long i = 0; i < benchmark; i++) {
+      ASTImage again;
+      StringInterner againSymbols;
+      FlatAST againAst;
+      again.open(imagePath, error) && again.load(againAst, againSymbols, error);
+    }
+    Clock::time_point mapped = Clock::now();
+
+    auto micros = [benchmark](Clock::time_point from, Clock::time_point to) {
+      return std::chrono::duration<double, std::micro>(to - from).count() / benchmark;
+    };
+    double parseTime = micros(start, parsed), loadTime = micros(parsed, mapped);
+    std::cout << std::fixed << std::setprecision(1) << filename << ": " << flatAst.nodeCount() << " nodes, "
+              << session.content().size() << " source bytes, " << ASTImage::serialize(flatAst, session.content()).size()
+              << " image bytes\n"
+              << "  parse + check  " << std::setw(10) << parseTime << " us\n"
+              << "  load image     " << std::setw(10) << loadTime << " us  (" << parseTime / loadTime << "x)\n";
+  }
+  return status;
+}
+
+// `keywords --bench=N` times keyword lookup on the words of a file
+int runKeywordBench(int argc, char **argv) {
+  long rounds = 0;
+  const char* filename = nullptr;
+  for (int i = 2; i < argc; i++) {
+    if (std::strncmp(argv[i], "--bench=", 8) == 0) {
+      rounds = std::strtol(argv[i] + 8, nullptr, 10);
+    } else {
+      filename = argv[i];
+    }
+  }
+  if (rounds <= 0 || !filename) {
+    return printUsage();
+  }
+
+  SourceBuffer source;
+  if (!source.open(filename)) {
+    std::cerr << "\033[31m\033[1merror\033[0m: could not read `" << filename << "`" << std::endl;
     return 1;
   }
+  LexerEngine::benchmarkKeywords(source.view(), rounds, std::cout);
+  return 0;
+}
 
-  if (semanticSuccess) {
-    std::cout << "\033[32m\033[1m✓ Compilation successful!\033[0m" << std::endl;
-    
-    // Only write output files if compilation was successful
-    int success = writeTokenToFile(output_file_parser, tokens);
-    if (success == 0) {
-      std::cout << "\033[34m  → Lexer IR written to " << output_file_parser << "\033[0m" << std::endl;
+// `serve` keeps compiling files sent by `client` until stopped
+int runServer(int argc, char **argv) {
+  std::string socketPath = defaultSocketPath();
+  size_t jobs = 0;
+  for (int i = 2; i < argc; i++) {
+    if (std::strncmp(argv[i], "--socket=", 9) == 0) {
+      socketPath = argv[i] + 9;
+    } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0') {
+      jobs = std::strtoul(argv[i] + 2, nullptr, 10);
     } else {
-      std::cerr << "\033[31mFailed to write lexer data\033[0m" << std::endl;
+      return printUsage();
     }
+  }
+
+  CompileServer server(socketPath, jobs > 0 ? jobs : ThreadPool::defaultThreadCount());
+  return server.serve() ? 0 : 1;
+}
 
-    success = writeASTToFile(output_file_ast, ASTParser::astToString(ast.get(), 0));
-    if (success == 0) {
-      std::cout << "\033[34m  → AST IR written to " << output_file_ast << "\033[0m" << std::endl;
+// `client` sends one file, or stdin as `-`, to a running server and prints
+// the answer like a local compile: IR on stdout, diagnostics on stderr and
+// the same exit status. With --bench it becomes a load generator instead.
+int runClient(int argc, char **argv) {
+  std::string socketPath = defaultSocketPath();
+  CompileRequest request;
+  size_t benchmark = 0;
+  size_t connections = 1;
+  bool stop = false;
+  const char* input = nullptr;
+
+  for (int i = 2; i < argc; i++) {
+    if (std::strncmp(argv[i], "--socket=", 9) == 0) {
+      socketPath = argv[i] + 9;
+    } else if (std::strcmp(argv[i], "-O0") == 0) {
+      request.optimize = false;
+    } else if (std::strcmp(argv[i], "--emit=lexer") == 0) {
+      request.emit = EmitKind::LEXER;
+    } else if (std::strcmp(argv[i], "--emit=ast") == 0) {
+      request.emit = EmitKind::AST;
+    } else if (std::strcmp(argv[i], "--emit=ssa") == 0) {
+      request.emit = EmitKind::SSA;
+    } else if (std::strcmp(argv[i], "--emit=bytecode") == 0) {
+      request.emit = EmitKind::BYTECODE;
+    } else if (std::strcmp(argv[i], "--stop") == 0) {
+      stop = true;
+    } else if (std::strncmp(argv[i], "--bench=", 8) == 0) {
+      benchmark = std::strtoul(argv[i] + 8, nullptr, 10);
+    } else if (std::strncmp(argv[i], "--connections=", 14) == 0) {
+      connections = std::strtoul(argv[i] + 14, nullptr, 10);
+    } else if (!input) {
+      input = argv[i];
     } else {
-      std::cerr << "\033[31mFailed to write AST data\033[0m" << std::endl;
+      return printUsage();
     }
+  }
+
+  if (stop) {
+    request.kind = CompileRequest::STOP;
+  } else if (!input) {
+    return printUsage();
+  } else if (std::strcmp(input, "-") == 0) {
+    request.kind = CompileRequest::SOURCE;
+    request.name = "<stdin>";
+    request.text.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
   } else {
-    std::cerr << "\033[31m\033[1m✗ Semantic analysis failed!\033[0m" << std::endl;
+    // The server resolves paths from its own working directory
+    std::error_code error;
+    request.kind = CompileRequest::PATH;
+    request.name = input;
+    request.text = std::filesystem::absolute(input, error).string();
+    if (error) request.text = input;
+  }
+
+  if (benchmark > 0 && !stop) {
+    return benchmarkServer(socketPath, request, benchmark, connections) ? 0 : 1;
+  }
+
+  CompileClient client;
+  CompileResponse response;
+  if (!client.connect(socketPath) || !client.send(request, response)) {
+    std::cerr << "\033[31m\033[1merror\033[0m: no compile server of this user on `" << socketPath
+              << "` (start one with `serve`)" << std::endl;
     return 1;
   }
+  std::cout << response.output << std::flush;
+  std::cerr << response.diagnostics << std::flush;
+  return response.status;
+}
 
-  return 0;
+} // namespace
+
+int main(int argc, char **argv) {
+
+  if (argc < 2) {
+    return printUsage();
+  }
+
+  if (std::strcmp(argv[1], "ast") == 0) {
+    return runAstImage(argc, argv);
+  }
+  if (std::strcmp(argv[1], "keywords") == 0) {
+    return runKeywordBench(argc, argv);
+  }
+  if (std::strcmp(argv[1], "serve") == 0) {
+    return runServer(argc, argv);
+  }
+  if (std::strcmp(argv[1], "client") == 0) {
+    return runClient(argc, argv);
+  }
+
+  Options options;
+  options.run = std::strcmp(argv[1], "run") == 0;
+  options.build = std::strcmp(argv[1], "build") == 0;
+  std::vector<std::string> inputs;
+  std::string executable;
+  size_t jobs = 0;
+  const char* cacheDirectory = nullptr;
+  uint64_t cacheMegabytes = 512;
+  bool cacheStats = false;
+
+  for (int i = (options.run || options.build) ? 2 : 1; i < argc; i++) {
+    if (options.build && std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      executable = argv[++i];
+    } else if (options.build && std::strcmp(argv[i], "--backend=native") == 0) {
+      options.cBackend = false;
+    } else if (options.build && std::strcmp(argv[i], "--backend=c") == 0) {
+      options.cBackend = true;
+    } else if (options.run && std::strcmp(argv[i], "--jit") == 0) {
+      options.useJit = true;
+    } else if (options.run && std::strcmp(argv[i], "--jit-stats") == 0) {
+      options.useJit = options.jitStats = true;
+    } else if (options.run && std::strcmp(argv[i], "--dispatch=switch") == 0) {
+      options.dispatch = VirtualMachine::Dispatch::SWITCH;
+    } else if (options.run && std::strcmp(argv[i], "--dispatch=threaded") == 0) {
+      options.dispatch = VirtualMachine::Dispatch::THREADED;
+    } else if (options.run && std::strncmp(argv[i], "--repeat=", 9) == 0) {
+      options.repeat = std::strtol(argv[i] + 9, nullptr, 10);
+      if (options.repeat < 1) options.repeat = 1;
+    } else if (std::strcmp(argv[i], "-O0") == 0) {
+      options.optimize = false;
+    } else if (std::strcmp(argv[i], "--pass-stats") == 0) {
+      options.passStats = true;
+    } else if (std::strcmp(argv[i], "--stats") == 0 || std::strcmp(argv[i], "--time-passes") == 0) {
+      options.stats = Options::Stats::TABLE;
+    } else if (std::strcmp(argv[i], "--stats=json") == 0) {
+      options.stats = Options::Stats::JSON;
+    } else if (!options.run && std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = std::strtoul(argv[++i], nullptr, 10);
+    } else if (!options.run && std::strncmp(argv[i], "-j", 2) == 0 && argv[i][2] != '\0') {
+      jobs = std::strtoul(argv[i] + 2, nullptr, 10);
+    } else if (!options.run && !options.build && std::strcmp(argv[i], "--cache") == 0) {
+      cacheDirectory = "";
+    } else if (!options.run && !options.build && std::strncmp(argv[i], "--cache=", 8) == 0) {
+      cacheDirectory = argv[i] + 8;
+    } else if (!options.run && !options.build && std::strncmp(argv[i], "--cache-size=", 13) == 0) {
+      cacheMegabytes = std::strtoull(argv[i] + 13, nullptr, 10);
+    } else if (!options.run && !options.build && std::strcmp(argv[i], "--cache-stats") == 0) {
+      cacheStats = true;
+    } else if (options.run && !inputs.empty()) {
+      // run executes a single program
+      return printUsage();
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+
+  if (inputs.empty()) {
+    return printUsage();
+  }
+
+  std::vector<std::string> files;
+  bool expanded = false;
+  for (const std::string& input : inputs) {
+    if (options.run) {
+      files.push_back(input);
+    } else if (!expandInput(input, files, expanded)) {
+      return 1;
+    }
+  }
+
+  // Counting starts before any worker thread does
+  if (options.stats != Options::Stats::NONE) CompileStatistics::countAllocations();
+
+  // --cache-stats alone uses the default directory
+  std::unique_ptr<CompilationCache> cache;
+  if (cacheDirectory || cacheStats) {
+    std::string directory = cacheDirectory && *cacheDirectory ? cacheDirectory : CompilationCache::defaultDirectory();
+    cache = std::make_unique<CompilationCache>(directory, cacheMegabytes * 1024 * 1024);
+    options.cache = cache.get();
+  }
+  auto finishCache = [&](int status) {
+    if (cache) {
+      cache->evict();
+      if (cacheStats) std::cerr << cache->report() << std::endl;
+    }
+    return status;
+  };
+
+  if (files.size() > 1 || expanded) {
+    if (!executable.empty()) {
+      std::cerr << "\033[31m\033[1merror\033[0m: -o needs a single input file" << std::endl;
+      return 1;
+    }
+    return finishCache(compileBatch(options, files, jobs > 0 ? jobs : ThreadPool::defaultThreadCount()));
+  }
+
+  const char* filename = files[0].c_str();
+  Outputs outputs;
+  outputs.executable = executable;
+
+  // Default executable name: the source's file name without its extension
+  if (options.build && outputs.executable.empty()) {
+    outputs.executable = filename;
+    size_t slash = outputs.executable.find_last_of('/');
+    if (slash != std::string::npos) outputs.executable.erase(0, slash + 1);
+    size_t dot = outputs.executable.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) outputs.executable.erase(dot);
+    if (outputs.executable.empty() || outputs.executable == filename) outputs.executable += ".out";
+  }
+
+  return finishCache(compileCached(options, filename, outputs, std::cout, std::cerr));
 }
@@ -0,0 +1,654 @@
+#include "native.hpp"
+#include "error.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <queue>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+namespace {
+
+// Allocatable registers. rax, rcx, rdx, rsi, rdi, r11, xmm0 and xmm1 are
+// scratch for instruction sequences and runtime calls; the runtime preserves
+// everything listed here.
+const char* const GPR_NAMES[] = {"%rbx", "%r12", "%r13", "%r14", "%r15", "%r8", "%r9", "%r10"};
+const char* const XMM_NAMES[] = {"%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7", "%xmm8",
+                                 "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15"};
+constexpr uint32_t GPR_COUNT = sizeof(GPR_NAMES) / sizeof(GPR_NAMES[0]);
+constexpr uint32_t XMM_COUNT = sizeof(XMM_NAMES) / sizeof(XMM_NAMES[0]);
+
+bool isMemory(const std::string& operand) {
+    return operand.find('(') != std::string::npos;
+}
+
+std::string slotAddress(uint32_t slot) {
+    return "aw_slots+" + std::to_string(8 * (uint64_t)slot) + "(%rip)";
+}
+
+// Body of a GAS .ascii directive
+std::string escapeAscii(std::string_view text) {
+    std::string escaped;
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += (char)c;
+        } else if (c < 32 || c >= 127) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\%03o", c);
+            escaped += buffer;
+        } else {
+            escaped += (char)c;
+        }
+    }
+    return escaped;
+}
+
+// Condition code suffix for setcc, by position in the EQ..GE opcode groups
+const char* const SIGNED_CONDITIONS[] = {"e", "ne", "l", "le", "g", "ge"};
+
+} // namespace
+
+bool NativeCompiler::compileProgram(const Bytecode& bytecode, CompilationSession& compilation, std::string& assembly) {
+    program = &bytecode;
+    session = &compilation;
+    instrs.clear();
+    operandLists.clear();
+    intervals.clear();
+    arrays.clear();
+    vregArrays.clear();
+    errorMessages.clear();
+    spillSlots = 0;
+    out.clear();
+
+    if (!lower()) {
+        return false;
+    }
+    allocateRegisters();
+
+    out += "# Generated by the AwLang native backend\n";
+    out += "    .text\n    .globl _start\n_start:\n    call aw_main\n    jmp aw_exit\n\naw_main:\n";
+    for (size_t i = 0; i < instrs.size(); i++) {
+        emitInstr(instrs[i]);
+    }
+
+    // Runtime error exits, one per distinct message
+    for (size_t i = 0; i < errorMessages.size(); i++) {
+        out += ".Lerror" + std::to_string(i) + ":\n";
+        line("leaq aw_error_" + std::to_string(i) + "(%rip), %rdi");
+        line("jmp aw_runtime_error");
+    }
+
+    out += "\n";
+    out += runtimeAssembly();
+    emitData();
+
+    assembly = std::move(out);
+    out.clear();
+    return true;
+}
+
+uint32_t NativeCompiler::newVreg(ValueType type, uint32_t start) {
+    intervals.push_back(LiveInterval{start, start, type, false, 0});
+    vregArrays.push_back(UINT32_MAX);
+    return (uint32_t)(intervals.size() - 1);
+}
+
+// Replays the bytecode's stack effects, naming each pushed value with a new
+// vreg. Straight-line code means every vreg is defined once and its interval
+// runs from its definition to its single use.
+bool NativeCompiler::lower() {
+    const std::vector<uint32_t>& code = program->code;
+    std::vector<uint32_t> stack;
+    std::vector<ValueType> slotTypes(program->slotNames.size(), ValueType::UNKNOWN_TYPE);
+    std::vector<uint32_t> slotArrays(program->slotNames.size(), UINT32_MAX);
+
+    for (size_t pc = 0; pc < code.size(); pc++) {
+        uint32_t word = code[pc];
+        Op op = Bytecode::opcode(word);
+        uint32_t index = (uint32_t)instrs.size();
+        NativeInstr instr{op, NO_VREG, NO_VREG, NO_VREG, Bytecode::argument(word), program->offsets[pc]};
+
+        auto pop = [&]() {
+            uint32_t vreg = stack.back();
+            stack.pop_back();
+            intervals[vreg].end = index;
+            return vreg;
+        };
+        auto binary = [&](ValueType result) {
+            instr.b = pop();
+            instr.a = pop();
+            instr.dst = newVreg(result, index);
+        };
+
+        switch (op) {
+            case Op::PUSH_INT:
+                instr.dst = newVreg(ValueType::INT_TYPE, index);
+                break;
+            case Op::PUSH_CONST:
+                instr.dst = newVreg(program->constantTypes[instr.arg], index);
+                break;
+            case Op::LOAD:
+                instr.dst = newVreg(slotTypes[instr.arg], index);
+                vregArrays[instr.dst] = slotArrays[instr.arg];
+                break;
+            case Op::STORE:
+                instr.a = pop();
+                slotTypes[instr.arg] = intervals[instr.a].type;
+                slotArrays[instr.arg] = vregArrays[instr.a];
+                break;
+
+            case Op::ADD_I: case Op::SUB_I: case Op::MUL_I: case Op::DIV_I: case Op::MOD_I:
+                binary(ValueType::INT_TYPE);
+                break;
+            case Op::ADD_F: case Op::SUB_F: case Op::MUL_F: case Op::DIV_F: case Op::MOD_F:
+                binary(ValueType::FLOAT_TYPE);
+                break;
+            case Op::EQ_I: case Op::NE_I: case Op::LT_I: case Op::LE_I: case Op::GT_I: case Op::GE_I:
+            case Op::EQ_F: case Op::NE_F: case Op::LT_F: case Op::LE_F: case Op::GT_F: case Op::GE_F:
+            case Op::EQ_S: case Op::NE_S: case Op::LT_S: case Op::LE_S: case Op::GT_S: case Op::GE_S:
+                binary(ValueType::BOOL_TYPE);
+                break;
+            case Op::CONCAT:
+                binary(ValueType::STRING_TYPE);
+                break;
+
+            case Op::INT_TO_FLOAT:
+                instr.a = pop();
+                instr.dst = newVreg(ValueType::FLOAT_TYPE, index);
+                break;
+            case Op::INT_TO_STRING: case Op::FLOAT_TO_STRING: case Op::BOOL_TO_STRING:
+                instr.a = pop();
+                instr.dst = newVreg(ValueType::STRING_TYPE, index);
+                break;
+
+            case Op::ARRAY_NEW: case Op::ARRAY_CONST: {
+                NativeArray array{(ValueType)instr.arg, 0, 0, 0};
+                if (op == Op::ARRAY_CONST) {
+                    array.firstConstant = code[pc + 1];
+                    array.constantCount = code[pc + 2];
+                    array.size = Bytecode::wide(&code[pc + 3]);
+                } else {
+                    array.size = Bytecode::wide(&code[pc + 2]);
+                }
+                uint32_t count = op == Op::ARRAY_NEW ? code[pc + 1] : 0;
+                pc += Bytecode::extraWords(op);
+                instr.a = (uint32_t)operandLists.size();
+                instr.b = count;
+                operandLists.insert(operandLists.end(), stack.end() - count, stack.end());
+                for (uint32_t i = 0; i < count; i++) pop();
+                arrays.push_back(array);
+                instr.arg = (uint32_t)(arrays.size() - 1);
+                instr.dst = newVreg(ValueType::ARRAY_TYPE, index);
+                vregArrays[instr.dst] = instr.arg;
+                break;
+            }
+
+            case Op::WRITE_INT: case Op::WRITE_FLOAT: case Op::WRITE_BOOL:
+            case Op::WRITE_STRING: case Op::WRITE_ARRAY:
+                instr.a = pop();
+                break;
+            case Op::WRITE_TEXT: case Op::WRITE_NEWLINE: case Op::HALT:
+                break;
+
+            default:
+                session->errors().addCodegenError(std::string("Native backend cannot lower ") + Bytecode::opName(op),
+                                                  instr.offset);
+                return false;
+        }
+        if (instr.dst != NO_VREG) {
+            stack.push_back(instr.dst);
+        }
+        instrs.push_back(instr);
+    }
+    return true;
+}
+
+// Linear scan over intervals in order of their start (which is vreg order).
+// An interval ending at the instruction that starts the next one is already
+// free, so a result may reuse one of its operands' registers.
+void NativeCompiler::allocateRegisters() {
+    struct SpilledEnd {
+        uint32_t end;
+        uint32_t slot;
+        bool operator>(const SpilledEnd& other) const { return end > other.end; }
+    };
+
+    std::vector<uint32_t> activeGpr, activeXmm;
+    std::vector<bool> usedGpr(GPR_COUNT, false), usedXmm(XMM_COUNT, false);
+    std::priority_queue<SpilledEnd, std::vector<SpilledEnd>, std::greater<SpilledEnd>> spilled;
+    std::vector<uint32_t> freeSlots;
+
+    auto takeSlot = [&]() {
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        return spillSlots++;
+    };
+
+    for (uint32_t vreg = 0; vreg < intervals.size(); vreg++) {
+        LiveInterval& current = intervals[vreg];
+
+        auto expire = [&](std::vector<uint32_t>& active, std::vector<bool>& used) {
+            for (size_t i = 0; i < active.size();) {
+                if (intervals[active[i]].end <= current.start) {
+                    used[intervals[active[i]].location] = false;
+                    active[i] = active.back();
+                    active.pop_back();
+                } else {
+                    i++;
+                }
+            }
+        };
+        expire(activeGpr, usedGpr);
+        expire(activeXmm, usedXmm);
+        while (!spilled.empty() && spilled.top().end <= current.start) {
+            freeSlots.push_back(spilled.top().slot);
+            spilled.pop();
+        }
+
+        bool floatClass = current.type == ValueType::FLOAT_TYPE;
+        std::vector<uint32_t>& active = floatClass ? activeXmm : activeGpr;
+        std::vector<bool>& used = floatClass ? usedXmm : usedGpr;
+
+        auto freeRegister = std::find(used.begin(), used.end(), false);
+        if (freeRegister != used.end()) {
+            current.location = (uint32_t)(freeRegister - used.begin());
+            *freeRegister = true;
+            active.push_back(vreg);
+            continue;
+        }
+
+        // Spill whichever interval reaches furthest
+        auto furthest = std::max_element(active.begin(), active.end(), [&](uint32_t x, uint32_t y) {
+            return intervals[x].end < intervals[y].end;
+        });
+        LiveInterval& victim = intervals[*furthest];
+        if (victim.end > current.end) {
+            current.location = victim.location;
+            victim.spilled = true;
+            victim.location = takeSlot();
+            spilled.push(SpilledEnd{victim.end, victim.location});
+            *furthest = vreg;
+        } else {
+            current.spilled = true;
+            current.location = takeSlot();
+            spilled.push(SpilledEnd{current.end, current.location});
+        }
+    }
+}
+
+std::string NativeCompiler::location(uint32_t vreg) const {
+    const LiveInterval& interval = intervals[vreg];
+    if (interval.spilled) {
+        return "aw_spill+" + std::to_string(8 * (uint64_t)interval.location) + "(%rip)";
+    }
+    return interval.type == ValueType::FLOAT_TYPE ? XMM_NAMES[interval.location] : GPR_NAMES[interval.location];
+}
+
+bool NativeCompiler::inRegister(uint32_t vreg) const {
+    return !intervals[vreg].spilled;
+}
+
+void NativeCompiler::line(const std::string& text) {
+    out += "    ";
+    out += text;
+    out += "\n";
+}
+
+void NativeCompiler::move(const std::string& from, const std::string& to, bool isFloat) {
+    if (from == to) return;
+    const char* mnemonic = isFloat ? "movsd" : "movq";
+    if (isMemory(from) && isMemory(to)) {
+        const char* scratch = isFloat ? "%xmm0" : "%rax";
+        line(std::string(mnemonic) + " " + from + ", " + scratch);
+        line(std::string(mnemonic) + " " + scratch + ", " + to);
+        return;
+    }
+    line(std::string(mnemonic) + " " + from + ", " + to);
+}
+
+uint32_t NativeCompiler::runtimeError(const std::string& message, uint32_t offset) {
+    SourceLocation where = session->errors().locate(offset);
+    std::string text = "error: " + message + "\n  --> " + session->getFilename() + ":" +
+                       std::to_string(where.line) + ":" + std::to_string(where.column) + "\n";
+    auto it = std::find(errorMessages.begin(), errorMessages.end(), text);
+    if (it != errorMessages.end()) {
+        return (uint32_t)(it - errorMessages.begin());
+    }
+    errorMessages.push_back(text);
+    return (uint32_t)(errorMessages.size() - 1);
+}
+
+void NativeCompiler::emitInstr(const NativeInstr& instr) {
+    switch (instr.op) {
+        case Op::PUSH_INT:
+            line("movq $" + std::to_string((int32_t)(instr.arg << 8) >> 8) + ", " + location(instr.dst));
+            break;
+
+        case Op::PUSH_CONST: {
+            Value value = program->constants[instr.arg];
+            std::string dst = location(instr.dst);
+            switch (program->constantTypes[instr.arg]) {
+                case ValueType::FLOAT_TYPE:
+                    move("aw_const_" + std::to_string(instr.arg) + "(%rip)", dst, true);
+                    break;
+                case ValueType::STRING_TYPE:
+                    line("leaq aw_string_" + std::to_string(value.ref) + "(%rip), " + (inRegister(instr.dst) ? dst : "%rax"));
+                    if (!inRegister(instr.dst)) move("%rax", dst, false);
+                    break;
+                default:
+                    if (value.i >= INT32_MIN && value.i <= INT32_MAX) {
+                        line("movq $" + std::to_string(value.i) + ", " + dst);
+                    } else {
+                        line("movabsq $" + std::to_string(value.i) + ", %rax");
+                        move("%rax", dst, false);
+                    }
+                    break;
+            }
+            break;
+        }
+
+        case Op::LOAD:
+            move(slotAddress(instr.arg), location(instr.dst), isFloat(instr.dst));
+            break;
+        case Op::STORE:
+            move(location(instr.a), slotAddress(instr.arg), isFloat(instr.a));
+            break;
+
+        case Op::ADD_I: emitIntBinary("addq", instr); break;
+        case Op::SUB_I: emitIntBinary("subq", instr); break;
+        case Op::MUL_I: emitIntBinary("imulq", instr); break;
+        case Op::DIV_I: case Op::MOD_I: emitDivision(instr); break;
+
+        case Op::ADD_F: emitFloatBinary("addsd", instr); break;
+        case Op::SUB_F: emitFloatBinary("subsd", instr); break;
+        case Op::MUL_F: emitFloatBinary("mulsd", instr); break;
+        case Op::DIV_F: emitFloatBinary("divsd", instr); break;
+        case Op::MOD_F:
+            move(location(instr.b), "%xmm1", true);
+            move(location(instr.a), "%xmm0", true);
+            line("call aw_fmod");
+            move("%xmm0", location(instr.dst), true);
+            break;
+
+        case Op::INT_TO_FLOAT: {
+            std::string dst = inRegister(instr.dst) ? location(instr.dst) : "%xmm0";
+            line("cvtsi2sdq " + location(instr.a) + ", " + dst);
+            move(dst, location(instr.dst), true);
+            break;
+        }
+        case Op::INT_TO_STRING: emitCall("aw_int_to_string", instr); break;
+        case Op::FLOAT_TO_STRING: emitCall("aw_float_to_string", instr); break;
+        case Op::BOOL_TO_STRING:
+            line("leaq aw_text_true(%rip), %rax");
+            line("leaq aw_text_false(%rip), %rcx");
+            line("cmpq $0, " + location(instr.a));
+            line("cmoveq %rcx, %rax");
+            move("%rax", location(instr.dst), false);
+            break;
+        case Op::CONCAT: emitCall("aw_concat", instr); break;
+
+        case Op::ARRAY_NEW: case Op::ARRAY_CONST: {
+            const NativeArray& array = arrays[instr.arg];
+            std::string name = "aw_array_" + std::to_string(instr.arg);
+            // Initializers go through the items pointer of a lazy array
+            std::string items = name + "_items+";
+            std::string itemsBase = "(%rip)";
+            if (array.lazy()) {
+                uint32_t error = runtimeError(arrayAllocationError(array.size), instr.offset);
+                line("leaq " + name + "(%rip), %rdi");
+                if (array.constantCount > 0) {
+                    line("leaq " + name + "_init(%rip), %rsi");
+                } else {
+                    line("xorl %esi, %esi");
+                }
+                line("movq $" + std::to_string(array.constantCount) + ", %rdx");
+                line("call aw_array_alloc");
+                line("testq %rax, %rax");
+                line("jz .Lerror" + std::to_string(error));
+                line("movq %rax, %rcx");
+                items.clear();
+                itemsBase = "(%rcx)";
+            }
+            for (uint32_t i = 0; i < instr.b; i++) {
+                uint32_t element = operandLists[instr.a + i];
+                move(location(element), items + std::to_string(8 * (uint64_t)i) + itemsBase, isFloat(element));
+            }
+            std::string dst = inRegister(instr.dst) ? location(instr.dst) : "%rax";
+            line("leaq " + name + "(%rip), " + dst);
+            move(dst, location(instr.dst), false);
+            break;
+        }
+
+        case Op::WRITE_TEXT:
+            line("leaq aw_string_" + std::to_string(instr.arg) + "(%rip), %rdi");
+            line("call aw_write_string");
+            break;
+        case Op::WRITE_INT: emitCall("aw_write_int", instr); break;
+        case Op::WRITE_FLOAT: emitCall("aw_write_float", instr); break;
+        case Op::WRITE_BOOL: emitCall("aw_write_bool", instr); break;
+        case Op::WRITE_STRING: emitCall("aw_write_string", instr); break;
+        case Op::WRITE_ARRAY:
+            move(location(instr.a), "%rdi", false);
+            line("movl $" + std::to_string((int)arrays[vregArrays[instr.a]].elementType) + ", %esi");
+            line("call aw_write_array");
+            break;
+        case Op::WRITE_NEWLINE:
+            line("call aw_write_newline");
+            break;
+
+        case Op::HALT:
+            line("ret");
+            break;
+
+        default:
+            emitCompare(instr);
+            break;
+    }
+}
+
+// dst = a op b, computed in dst's register unless that register holds b
+void NativeCompiler::emitIntBinary(const char* mnemonic, const NativeInstr& instr) {
+    std::string dst = location(instr.dst);
+    std::string right = location(instr.b);
+    std::string target = inRegister(instr.dst) && dst != right ? dst : "%rax";
+    move(location(instr.a), target, false);
+    line(std::string(mnemonic) + " " + right + ", " + target);
+    move(target, dst, false);
+}
+
+void NativeCompiler::emitFloatBinary(const char* mnemonic, const NativeInstr& instr) {
+    std::string dst = location(instr.dst);
+    std::string right = location(instr.b);
+    std::string target = inRegister(instr.dst) && dst != right ? dst : "%xmm0";
+    move(location(instr.a), target, true);
+    line(std::string(mnemonic) + " " + right + ", " + target);
+    move(target, dst, true);
+}
+
+// idivq traps on a zero divisor and on INT64_MIN / -1; the first is a
+// runtime error, the second wraps like the VM
+void NativeCompiler::emitDivision(const NativeInstr& instr) {
+    bool modulo = instr.op == Op::MOD_I;
+    uint32_t error = runtimeError("Division by zero", instr.offset);
+
+    move(location(instr.b), "%rcx", false);
+    line("testq %rcx, %rcx");
+    line("jz .Lerror" + std::to_string(error));
+    move(location(instr.a), "%rax", false);
+    line("cmpq $-1, %rcx");
+    line("jne 1f");
+    line(modulo ? "xorl %eax, %eax" : "negq %rax");
+    line("jmp 2f");
+    out += "1:\n";
+    line("cqto");
+    line("idivq %rcx");
+    if (modulo) line("movq %rdx, %rax");
+    out += "2:\n";
+    move("%rax", location(instr.dst), false);
+}
+
+void NativeCompiler::emitCompare(const NativeInstr& instr) {
+    int op = (int)instr.op;
+    std::string a = location(instr.a);
+    std::string b = location(instr.b);
+
+    if (op >= (int)Op::EQ_F && op <= (int)Op::GE_F) {
+        // ucomisd reports unordered (NaN) as ZF=PF=CF=1. Ordering tests use
+        // "above" with the operands arranged so that NaN compares false.
+        switch (instr.op) {
+            case Op::EQ_F: case Op::NE_F:
+                move(a, "%xmm0", true);
+                line("ucomisd " + b + ", %xmm0");
+                line(instr.op == Op::EQ_F ? "sete %al" : "setne %al");
+                line(instr.op == Op::EQ_F ? "setnp %cl" : "setp %cl");
+                line(instr.op == Op::EQ_F ? "andb %cl, %al" : "orb %cl, %al");
+                break;
+            case Op::LT_F: case Op::LE_F:
+                move(b, "%xmm0", true);
+                line("ucomisd " + a + ", %xmm0");
+                line(instr.op == Op::LT_F ? "seta %al" : "setae %al");
+                break;
+            default:
+                move(a, "%xmm0", true);
+                line("ucomisd " + b + ", %xmm0");
+                line(instr.op == Op::GT_F ? "seta %al" : "setae %al");
+                break;
+        }
+    } else if (op >= (int)Op::EQ_S && op <= (int)Op::GE_S) {
+        move(a, "%rdi", false);
+        move(b, "%rsi", false);
+        line("call aw_string_compare");
+        line("cmpq $0, %rax");
+        line(std::string("set") + SIGNED_CONDITIONS[op - (int)Op::EQ_S] + " %al");
+    } else {
+        move(a, "%rax", false);
+        line("cmpq " + b + ", %rax");
+        line(std::string("set") + SIGNED_CONDITIONS[op - (int)Op::EQ_I] + " %al");
+    }
+    line("movzbl %al, %eax");
+    move("%rax", location(instr.dst), false);
+}
+
+// Runtime routine taking a in rdi (xmm0 for floats), b in rsi and returning
+// its result in rax
+void NativeCompiler::emitCall(const char* routine, const NativeInstr& instr) {
+    if (instr.b != NO_VREG) {
+        move(location(instr.b), "%rsi", false);
+    }
+    move(location(instr.a), isFloat(instr.a) ? "%xmm0" : "%rdi", isFloat(instr.a));
+    line(std::string("call ") + routine);
+    if (instr.dst != NO_VREG) {
+        move("%rax", location(instr.dst), false);
+    }
+}
+
+void NativeCompiler::emitData() {
+    out += "\n    .section .rodata\n";
+    for (size_t i = 0; i < program->strings.size(); i++) {
+        std::string_view text = program->strings[i];
+        out += "    .balign 8\naw_string_" + std::to_string(i) + ":\n";
+        line(".quad " + std::to_string(text.size()));
+        line(".ascii \"" + escapeAscii(text) + "\"");
+    }
+    for (size_t i = 0; i < program->constants.size(); i++) {
+        out += "    .balign 8\naw_const_" + std::to_string(i) + ":\n";
+        line(".quad " + std::to_string(program->constants[i].ref));
+    }
+    for (size_t i = 0; i < errorMessages.size(); i++) {
+        out += "    .balign 8\naw_error_" + std::to_string(i) + ":\n";
+        line(".quad " + std::to_string(errorMessages[i].size()));
+        line(".ascii \"" + escapeAscii(errorMessages[i]) + "\"");
+    }
+
+    for (size_t i = 0; i < arrays.size(); i++) {
+        if (arrays[i].lazy() && arrays[i].constantCount > 0) {
+            out += "    .balign 8\naw_array_" + std::to_string(i) + "_init:\n";
+            emitArrayConstants(arrays[i]);
+        }
+    }
+
+    out += "\n    .data\n";
+    for (size_t i = 0; i < arrays.size(); i++) {
+        std::string name = "aw_array_" + std::to_string(i);
+        out += "    .balign 8\n" + name + ":\n";
+        line(".quad " + std::to_string(arrays[i].size) + ", " + (arrays[i].lazy() ? "0" : name + "_items"));
+    }
+    for (size_t i = 0; i < arrays.size(); i++) {
+        const NativeArray& array = arrays[i];
+        if (array.lazy() || array.constantCount == 0) continue;
+        out += "aw_array_" + std::to_string(i) + "_items:\n";
+        emitArrayConstants(array);
+        if (array.size > array.constantCount) {
+            line(".zero " + std::to_string(8 * (array.size - array.constantCount)));
+        }
+    }
+
+    out += "\n    .bss\n    .balign 8\n";
+    out += "aw_slots:\n";
+    line(".zero " + std::to_string(8 * std::max<size_t>(program->slotNames.size(), 1)));
+    out += "aw_spill:\n";
+    line(".zero " + std::to_string(8 * (uint64_t)std::max<uint32_t>(spillSlots, 1)));
+    for (size_t i = 0; i < arrays.size(); i++) {
+        if (arrays[i].lazy() || arrays[i].constantCount > 0) continue;
+        out += "aw_array_" + std::to_string(i) + "_items:\n";
+        line(".zero " + std::to_string(8 * std::max<uint64_t>(arrays[i].size, 1)));
+    }
+}
+
+// The constant initializers as .quad lines; strings are their literals'
+// addresses
+void NativeCompiler::emitArrayConstants(const NativeArray& array) {
+    for (uint32_t i = 0; i < array.constantCount; i += 16) {
+        std::string values;
+        for (uint32_t j = i; j < std::min(i + 16, array.constantCount); j++) {
+            uint64_t bits = program->constants[array.firstConstant + j].ref;
+            if (j > i) values += ", ";
+            values += array.elementType == ValueType::STRING_TYPE ? "aw_string_" + std::to_string(bits)
+                                                                  : std::to_string(bits);
+        }
+        line(".quad " + values);
+    }
+}
+
+bool runTool(std::vector<std::string> args) {
+#ifndef _WIN32
+    std::vector<char*> argv;
+    for (std::string& arg : args) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+        std::cerr << "error: could not run `" << args[0] << "`" << std::endl;
+        return false;
+    }
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+    std::cerr << "error: could not run `" << args[0] << "`" << std::endl;
+    return false;
+#endif
+}
+
+bool NativeCompiler::assembleAndLink(const std::string& assemblyPath, const std::string& executablePath) {
+#ifndef _WIN32
+    std::string objectPath = executablePath + ".o";
+    bool linked = runTool({"as", "--64", "-o", objectPath, assemblyPath}) &&
+                  runTool({"ld", "-o", executablePath, objectPath});
+    unlink(objectPath.c_str());
+    return linked;
+#else
+    (void)assemblyPath;
+    (void)executablePath;
+    std::cerr << "error: native executables are only supported on x86-64 Linux" << std::endl;
+    return false;
+#endif
+}
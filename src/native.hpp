@@ -0,0 +1,101 @@
+#pragma once
+#include "codegen.hpp"
+#include "session.hpp"
+#include <string>
+#include <vector>
+
+constexpr uint32_t NO_VREG = UINT32_MAX;
+
+// Spawns an external tool (searched on PATH) and waits for it; true if it
+// exited with status 0
+bool runTool(std::vector<std::string> args);
+
+// Bytecode instruction rewritten in register form: every value the stack
+// machine would push gets a fresh virtual register instead.
+struct NativeInstr {
+    Op op;
+    uint32_t dst;     // defined vreg or NO_VREG
+    uint32_t a;       // operands; ARRAY_NEW: first entry in operandLists
+    uint32_t b;       //           ARRAY_NEW: initializer count (0 for ARRAY_CONST)
+    uint32_t arg;     // bytecode argument (slot, constant, string, array)
+    uint32_t offset;  // source byte offset
+};
+
+// Live range of one virtual register over the instruction list, and where
+// the allocator put it: a register index, or a spill slot when spilled
+struct LiveInterval {
+    uint32_t start;
+    uint32_t end;
+    ValueType type;
+    bool spilled;
+    uint32_t location;
+};
+
+// Array emitted as static data: a {size, items} header in .data, and the
+// items in .data when they start with constants (ARRAY_CONST) or in .bss.
+// Lazy arrays (LAZY_ARRAY_ITEMS or more) are mapped by the runtime when
+// they are created instead, and their constants are copied in from .rodata.
+struct NativeArray {
+    ValueType elementType;
+    uint64_t size;
+    uint32_t firstConstant;
+    uint32_t constantCount;
+
+    bool lazy() const { return size >= LAZY_ARRAY_ITEMS; }
+};
+
+// x86-64 System V (Linux) backend. Lowers the checked program, through its
+// bytecode so type conversions are decided in one place, to GNU assembler
+// text for a freestanding executable:
+//   - variables live in a static slot table; temporaries are assigned to
+//     registers with linear-scan allocation (Poletto & Sarkar) and spill
+//     to a static area when registers run out
+//   - string literals and arrays are static data, except big arrays,
+//     which are mapped at run time
+//   - the runtime appended to every program talks to the kernel directly
+//     (write(2), mmap(2), exit_group(2)) and buffers stdout; no libc
+class NativeCompiler {
+private:
+    const Bytecode* program = nullptr;
+    CompilationSession* session = nullptr;  // source name and diagnostics
+
+    std::vector<NativeInstr> instrs;
+    std::vector<uint32_t> operandLists;
+    std::vector<LiveInterval> intervals;   // indexed by vreg
+    std::vector<NativeArray> arrays;
+    std::vector<uint32_t> vregArrays;      // vreg -> array, for WRITE_ARRAY
+    std::vector<std::string> errorMessages;
+    uint32_t spillSlots = 0;
+    std::string out;
+
+    // Register-form translation and allocation
+    bool lower();
+    uint32_t newVreg(ValueType type, uint32_t start);
+    void allocateRegisters();
+
+    // Emission
+    std::string location(uint32_t vreg) const;
+    bool inRegister(uint32_t vreg) const;
+    bool isFloat(uint32_t vreg) const { return intervals[vreg].type == ValueType::FLOAT_TYPE; }
+    void line(const std::string& text);
+    void move(const std::string& from, const std::string& to, bool isFloat);
+    void emitInstr(const NativeInstr& instr);
+    void emitIntBinary(const char* mnemonic, const NativeInstr& instr);
+    void emitFloatBinary(const char* mnemonic, const NativeInstr& instr);
+    void emitDivision(const NativeInstr& instr);
+    void emitCompare(const NativeInstr& instr);
+    void emitCall(const char* routine, const NativeInstr& instr);
+    void emitData();
+    void emitArrayConstants(const NativeArray& array);
+    uint32_t runtimeError(const std::string& message, uint32_t offset);
+
+public:
+    // Produces the whole assembly file, runtime included
+    bool compileProgram(const Bytecode& bytecode, CompilationSession& compilation, std::string& assembly);
+
+    // Runs `as` and `ld` on an assembly file; returns false if either fails
+    static bool assembleAndLink(const std::string& assemblyPath, const std::string& executablePath);
+
+    // Runtime support routines, in assembly
+    static const char* runtimeAssembly();
+};
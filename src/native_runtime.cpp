@@ -0,0 +1,556 @@
+#include "native.hpp"
+
+// Runtime linked into every native executable. Conventions:
+//   - arguments in rdi/rsi (xmm0/xmm1 for floats), results in rax (xmm0),
+//     numeric text in rsi/rdx (pointer, length)
+//   - routines may clobber rax, rcx, rdx, rsi, rdi, r11, xmm0 and xmm1 and
+//     preserve everything else, so generated code can keep values in the
+//     other registers across calls
+//   - a string is a pointer to {8-byte length, bytes}; a null pointer is the
+//     empty string (zero-filled string arrays rely on this)
+//   - an array is a pointer to {8-byte size, pointer to 8-byte items}
+//   - stdout is buffered in 64 KiB and flushed on exit and before errors
+const char* NativeCompiler::runtimeAssembly() {
+    return R"(# ---- runtime ----
+aw_exit:
+    call aw_flush
+    xorl %edi, %edi
+aw_exit_code:
+    movl $231, %eax                 # exit_group
+    syscall
+
+# rdi = error message string; flushes stdout, writes it to stderr, exits 1
+aw_runtime_error:
+    pushq %rdi
+    call aw_flush
+    popq %rdi
+    movq (%rdi), %rdx
+    leaq 8(%rdi), %rsi
+    movl $2, %edi
+    call aw_write_all
+    movl $1, %edi
+    jmp aw_exit_code
+
+# edi = fd, rsi = bytes, rdx = length
+aw_write_all:
+    testq %rdx, %rdx
+    jz 2f
+    movl $1, %eax                   # write
+    syscall
+    cmpq $-4, %rax                  # EINTR
+    je aw_write_all
+    testq %rax, %rax
+    jle 2f
+    addq %rax, %rsi
+    subq %rax, %rdx
+    jmp aw_write_all
+2:  ret
+
+aw_flush:
+    movq aw_out_length(%rip), %rdx
+    leaq aw_out_buffer(%rip), %rsi
+    movl $1, %edi
+    movq $0, aw_out_length(%rip)
+    jmp aw_write_all
+
+# rsi = bytes, rdx = length
+aw_write_bytes:
+    movq aw_out_length(%rip), %rax
+    leaq (%rax,%rdx), %rcx
+    cmpq $65536, %rcx
+    jbe 2f
+    pushq %rsi
+    pushq %rdx
+    call aw_flush
+    popq %rdx
+    popq %rsi
+    cmpq $65536, %rdx
+    jb 1f
+    movl $1, %edi                   # larger than the buffer: write through
+    jmp aw_write_all
+1:  xorl %eax, %eax
+2:  leaq aw_out_buffer(%rip), %rdi
+    addq %rax, %rdi
+    addq %rdx, %rax
+    movq %rax, aw_out_length(%rip)
+    movq %rdx, %rcx
+    rep movsb
+    ret
+
+# rdi = string
+aw_write_string:
+    testq %rdi, %rdi
+    jz 1f
+    movq (%rdi), %rdx
+    leaq 8(%rdi), %rsi
+    jmp aw_write_bytes
+1:  ret
+
+aw_write_newline:
+    leaq aw_text_newline(%rip), %rsi
+    movl $1, %edx
+    jmp aw_write_bytes
+
+# rdi = bool
+aw_write_bool:
+    leaq aw_text_true(%rip), %rax
+    leaq aw_text_false(%rip), %rcx
+    testq %rdi, %rdi
+    cmovzq %rcx, %rax
+    movq %rax, %rdi
+    jmp aw_write_string
+
+# rdi = int
+aw_write_int:
+    call aw_format_int
+    jmp aw_write_bytes
+
+# xmm0 = float
+aw_write_float:
+    call aw_format_float
+    jmp aw_write_bytes
+
+# rdi = int -> rsi, rdx = decimal text in aw_number_buffer
+aw_format_int:
+    leaq aw_number_end(%rip), %rsi
+    movq %rdi, %rax
+    testq %rax, %rax
+    jns 1f
+    negq %rax                       # INT64_MIN stays the right magnitude unsigned
+1:  movl $10, %ecx
+2:  xorl %edx, %edx
+    divq %rcx
+    addb $48, %dl
+    decq %rsi
+    movb %dl, (%rsi)
+    testq %rax, %rax
+    jnz 2b
+    testq %rdi, %rdi
+    jns 3f
+    decq %rsi
+    movb $45, (%rsi)
+3:  leaq aw_number_end(%rip), %rdx
+    subq %rsi, %rdx
+    ret
+
+# xmm0 = float -> rsi, rdx = text like printf("%.6f") with trailing zeros
+# removed down to one decimal. The six decimals are rounded from
+# fraction * 1e6. Magnitudes of 2^63 and above are integers; they are
+# expanded exactly as mantissa * 2^exponent in base-1e9 limbs.
+aw_format_float:
+    pushq %r8
+    pushq %r9
+    movq %xmm0, %r11                # sign in bit 63
+    movq %r11, %rax
+    btrq $63, %rax
+    movabsq $0x7FF0000000000000, %rcx
+    cmpq %rcx, %rax
+    ja .Lformat_nan
+    je .Lformat_inf
+    movq %rax, %xmm0
+    movsd aw_float_two63(%rip), %xmm1
+    ucomisd %xmm1, %xmm0
+    jae .Lformat_huge
+    cvttsd2si %xmm0, %rax           # integer part
+    cvtsi2sdq %rax, %xmm1
+    subsd %xmm1, %xmm0
+    mulsd aw_float_million(%rip), %xmm0
+    cvtsd2si %xmm0, %rcx            # six decimals, rounded to nearest
+    cmpq $1000000, %rcx
+    jb 2f
+    xorl %ecx, %ecx
+    incq %rax
+2:  pushq %rax
+    movl $10, %r9d
+    movl $6, %r8d
+    movq %rcx, %rax
+3:  cmpl $1, %r8d                   # drop trailing zeros, keep one digit
+    je 5f
+    movq %rax, %rcx
+    xorl %edx, %edx
+    divq %r9
+    testq %rdx, %rdx
+    jnz 4f
+    decl %r8d
+    jmp 3b
+4:  movq %rcx, %rax
+5:  leaq aw_number_end(%rip), %rsi
+6:  xorl %edx, %edx
+    divq %r9
+    addb $48, %dl
+    decq %rsi
+    movb %dl, (%rsi)
+    decl %r8d
+    jnz 6b
+    decq %rsi
+    movb $46, (%rsi)
+    popq %rax
+9:  xorl %edx, %edx
+    divq %r9
+    addb $48, %dl
+    decq %rsi
+    movb %dl, (%rsi)
+    testq %rax, %rax
+    jnz 9b
+.Lformat_sign:
+    testq %r11, %r11
+    jns 1f
+    decq %rsi
+    movb $45, (%rsi)
+1:  leaq aw_number_end(%rip), %rdx
+    subq %rsi, %rdx
+    popq %r9
+    popq %r8
+    ret
+.Lformat_huge:
+    movq %xmm0, %rax
+    movq %rax, %rcx
+    shrq $52, %rcx
+    subl $1075, %ecx                # value = mantissa * 2^ecx, ecx >= 11
+    movabsq $0x000FFFFFFFFFFFFF, %rdx
+    andq %rdx, %rax
+    btsq $52, %rax
+    xorl %edx, %edx
+    movl $1000000000, %r9d
+    divq %r9
+    leaq aw_big_limbs(%rip), %rsi
+    movl %edx, (%rsi)
+    movl %eax, 4(%rsi)
+    movl $2, %r8d                   # limb count
+1:  xorl %edi, %edi                 # double the number ecx times
+    xorl %r9d, %r9d
+2:  movl (%rsi,%r9,4), %eax
+    leal (%rdi,%rax,2), %eax
+    xorl %edi, %edi
+    cmpl $1000000000, %eax
+    jb 3f
+    subl $1000000000, %eax
+    movl $1, %edi
+3:  movl %eax, (%rsi,%r9,4)
+    incq %r9
+    cmpq %r8, %r9
+    jb 2b
+    testl %edi, %edi
+    jz 4f
+    movl $1, (%rsi,%r8,4)
+    incq %r8
+4:  decl %ecx
+    jnz 1b
+    leaq aw_number_end(%rip), %rdi
+    movb $48, -1(%rdi)
+    movb $46, -2(%rdi)
+    subq $2, %rdi
+    xorl %r9d, %r9d
+5:  movl (%rsi,%r9,4), %eax         # low limbs print as nine digits
+    incq %r9
+    cmpq %r8, %r9
+    je 7f
+    movl $9, %ecx
+6:  xorl %edx, %edx
+    divl aw_int_ten(%rip)
+    addb $48, %dl
+    decq %rdi
+    movb %dl, (%rdi)
+    decl %ecx
+    jnz 6b
+    jmp 5b
+7:  xorl %edx, %edx                 # top limb without leading zeros
+    divl aw_int_ten(%rip)
+    addb $48, %dl
+    decq %rdi
+    movb %dl, (%rdi)
+    testl %eax, %eax
+    jnz 7b
+    movq %rdi, %rsi
+    jmp .Lformat_sign
+.Lformat_nan:
+    leaq aw_text_nan(%rip), %rcx
+    jmp 1f
+.Lformat_inf:
+    leaq aw_text_inf(%rip), %rcx
+1:  leaq aw_number_end(%rip), %rsi
+    subq $3, %rsi
+    movw (%rcx), %ax
+    movw %ax, (%rsi)
+    movb 2(%rcx), %al
+    movb %al, 2(%rsi)
+    jmp .Lformat_sign
+
+# rdi = byte count -> rax = 8-byte aligned block. Bump allocation from
+# chunks mapped with mmap(2); nothing is freed before exit.
+aw_alloc:
+    addq $7, %rdi
+    andq $-8, %rdi
+    movq aw_heap_next(%rip), %rax
+    leaq (%rax,%rdi), %rdx
+    cmpq aw_heap_end(%rip), %rdx
+    ja 1f
+    testq %rax, %rax
+    jz 1f
+    movq %rdx, aw_heap_next(%rip)
+    ret
+1:  pushq %rdi
+    movq %rdi, %rsi
+    cmpq $1048576, %rsi
+    jae 2f
+    movl $1048576, %esi
+2:  pushq %rsi
+    pushq %r8
+    pushq %r9
+    pushq %r10
+    xorl %edi, %edi
+    movl $3, %edx                   # PROT_READ | PROT_WRITE
+    movl $0x22, %r10d               # MAP_PRIVATE | MAP_ANONYMOUS
+    movq $-1, %r8
+    xorl %r9d, %r9d
+    movl $9, %eax                   # mmap
+    syscall
+    popq %r10
+    popq %r9
+    popq %r8
+    popq %rsi
+    popq %rdi
+    cmpq $-4096, %rax
+    ja aw_out_of_memory
+    leaq (%rax,%rsi), %rdx
+    movq %rdx, aw_heap_end(%rip)
+    leaq (%rax,%rdi), %rdx
+    movq %rdx, aw_heap_next(%rip)
+    ret
+
+aw_out_of_memory:
+    leaq aw_text_out_of_memory(%rip), %rdi
+    jmp aw_runtime_error
+
+# rdi = array header, rsi = initial items, rdx = their count -> rax = items,
+# or 0 if they could not be mapped. The fresh pages read as zero, so only the
+# initial items are written, with one string copy.
+aw_array_alloc:
+    pushq %rdi
+    pushq %rsi
+    pushq %rdx
+    pushq %r8
+    pushq %r9
+    pushq %r10
+    movq (%rdi), %rsi
+    shlq $3, %rsi
+    xorl %edi, %edi
+    movl $3, %edx                   # PROT_READ | PROT_WRITE
+    movl $0x22, %r10d               # MAP_PRIVATE | MAP_ANONYMOUS
+    movq $-1, %r8
+    xorl %r9d, %r9d
+    movl $9, %eax                   # mmap
+    syscall
+    popq %r10
+    popq %r9
+    popq %r8
+    popq %rcx
+    popq %rsi
+    popq %rdi
+    cmpq $-4096, %rax
+    ja 1f
+    movq %rax, 8(%rdi)
+    movq %rax, %rdi
+    shlq $3, %rcx
+    rep movsb
+    ret
+1:  xorl %eax, %eax
+    ret
+
+# rsi, rdx = bytes -> rax = new string
+aw_string_from_bytes:
+    pushq %rsi
+    pushq %rdx
+    leaq 8(%rdx), %rdi
+    call aw_alloc
+    popq %rcx
+    popq %rsi
+    movq %rcx, (%rax)
+    leaq 8(%rax), %rdi
+    rep movsb
+    ret
+
+aw_int_to_string:
+    call aw_format_int
+    jmp aw_string_from_bytes
+
+aw_float_to_string:
+    call aw_format_float
+    jmp aw_string_from_bytes
+
+# rdi = a, rsi = b -> rax = a + b
+aw_concat:
+    pushq %rdi
+    pushq %rsi
+    xorl %eax, %eax
+    testq %rdi, %rdi
+    jz 1f
+    movq (%rdi), %rax
+1:  xorl %edx, %edx
+    testq %rsi, %rsi
+    jz 2f
+    movq (%rsi), %rdx
+2:  leaq 8(%rax,%rdx), %rdi
+    pushq %rax
+    pushq %rdx
+    call aw_alloc
+    popq %rdx                       # length of b
+    popq %rcx                       # length of a
+    leaq (%rcx,%rdx), %rsi
+    movq %rsi, (%rax)
+    leaq 8(%rax), %rdi
+    movq 8(%rsp), %rsi
+    addq $8, %rsi
+    rep movsb
+    popq %rsi
+    addq $8, %rsi
+    movq %rdx, %rcx
+    rep movsb
+    popq %rsi
+    ret
+
+# rdi = a, rsi = b -> rax = -1, 0 or 1, comparing bytes as unsigned
+aw_string_compare:
+    xorl %eax, %eax
+    testq %rdi, %rdi
+    jz 1f
+    movq (%rdi), %rax
+    addq $8, %rdi
+1:  xorl %edx, %edx
+    testq %rsi, %rsi
+    jz 2f
+    movq (%rsi), %rdx
+    addq $8, %rsi
+2:  xchgq %rsi, %rdi                # cmpsb compares (%rsi) with (%rdi)
+    movq %rax, %rcx
+    cmpq %rdx, %rcx
+    cmovaq %rdx, %rcx
+    testq %rcx, %rcx
+    jz 3f
+    repe cmpsb
+    jne 4f
+3:  cmpq %rdx, %rax
+    je 5f
+4:  movq $-1, %rax
+    jb 6f
+    movl $1, %eax
+6:  ret
+5:  xorl %eax, %eax
+    ret
+
+# xmm0 = a, xmm1 = b -> xmm0 = fmod(a, b)
+aw_fmod:
+    subq $16, %rsp
+    movsd %xmm1, (%rsp)
+    fldl (%rsp)
+    movsd %xmm0, (%rsp)
+    fldl (%rsp)
+1:  fprem
+    fnstsw %ax
+    testw $0x400, %ax
+    jnz 1b
+    fstp %st(1)
+    fstpl (%rsp)
+    movsd (%rsp), %xmm0
+    addq $16, %rsp
+    ret
+
+# rdi = array, esi = element ValueType (0 string, 2 float, 3 bool, else int)
+aw_write_array:
+    pushq %rbx
+    pushq %r8
+    pushq %r9
+    pushq %r10
+    movq (%rdi), %r9
+    movq 8(%rdi), %r10
+    movl %esi, %ebx
+    leaq aw_text_open(%rip), %rsi
+    movl $1, %edx
+    call aw_write_bytes
+    xorl %r8d, %r8d
+1:  cmpq %r9, %r8
+    jae 9f
+    testq %r8, %r8
+    jz 2f
+    leaq aw_text_separator(%rip), %rsi
+    movl $2, %edx
+    call aw_write_bytes
+2:  movq (%r10,%r8,8), %rdi
+    cmpl $0, %ebx
+    je 3f
+    cmpl $2, %ebx
+    je 4f
+    cmpl $3, %ebx
+    je 5f
+    call aw_write_int
+    jmp 8f
+3:  call aw_write_string
+    jmp 8f
+4:  movq %rdi, %xmm0
+    call aw_write_float
+    jmp 8f
+5:  call aw_write_bool
+8:  incq %r8
+    jmp 1b
+9:  leaq aw_text_close(%rip), %rsi
+    movl $1, %edx
+    call aw_write_bytes
+    popq %r10
+    popq %r9
+    popq %r8
+    popq %rbx
+    ret
+
+    .section .rodata
+    .balign 8
+aw_text_true:
+    .quad 4
+    .ascii "true"
+    .balign 8
+aw_text_false:
+    .quad 5
+    .ascii "false"
+    .balign 8
+aw_text_out_of_memory:
+    .quad 21
+    .ascii "error: out of memory\n"
+    .balign 8
+aw_float_two63:
+    .double 9223372036854775808.0
+aw_int_ten:
+    .long 10
+    .balign 8
+aw_float_million:
+    .double 1000000.0
+aw_text_newline:
+    .ascii "\n"
+aw_text_open:
+    .ascii "["
+aw_text_close:
+    .ascii "]"
+aw_text_separator:
+    .ascii ", "
+aw_text_nan:
+    .ascii "nan"
+aw_text_inf:
+    .ascii "inf"
+
+    .bss
+    .balign 8
+aw_out_length:
+    .zero 8
+aw_heap_next:
+    .zero 8
+aw_heap_end:
+    .zero 8
+aw_big_limbs:
+    .zero 144
+aw_number_buffer:
+    .zero 384
+aw_number_end:
+aw_out_buffer:
+    .zero 65536
+
+    .text
+)";
+}
@@ -0,0 +1,72 @@
+#include "output.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+
+#ifdef _WIN32
+#include <io.h>
+#define AW_WRITE _write
+#else
+#include <unistd.h>
+#define AW_WRITE ::write
+#endif
+
+namespace {
+
+// Writes all of `text`, retrying short and interrupted writes. Output that
+// cannot be written (a closed pipe) is dropped like stdio would.
+void writeAll(int fd, const char* text, size_t length) {
+    while (length > 0) {
+        auto written = AW_WRITE(fd, text, (unsigned)std::min<size_t>(length, 1 << 30));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return;
+        text += written;
+        length -= (size_t)written;
+    }
+}
+
+} // namespace
+
+size_t formatFloat(double value, char* buffer) {
+    char* end = std::to_chars(buffer, buffer + MAX_FLOAT_TEXT, value, std::chars_format::fixed, 6).ptr;
+    // inf and nan have no decimals to trim
+    if (!std::isfinite(value)) return end - buffer;
+    while (end[-1] == '0') end--;
+    if (end[-1] == '.') *end++ = '0';
+    return end - buffer;
+}
+
+std::string formatFloat(double value) {
+    char buffer[MAX_FLOAT_TEXT];
+    return std::string(buffer, formatFloat(value, buffer));
+}
+
+void OutputBuffer::writeLarge(std::string_view text) {
+    flush();
+    if (text.size() < CAPACITY) {
+        write(text);
+    } else {
+        writeAll(fd, text.data(), text.size());
+    }
+}
+
+void OutputBuffer::writeInt(int64_t value) {
+    reserve(20);
+    size = std::to_chars(data + size, data + CAPACITY, value).ptr - data;
+}
+
+void OutputBuffer::writeFloat(double value) {
+    reserve(MAX_FLOAT_TEXT);
+    size += formatFloat(value, data + size);
+}
+
+void OutputBuffer::flush() {
+    writeAll(fd, data, size);
+    size = 0;
+}
+
+OutputBuffer& OutputBuffer::standardOutput() {
+    static OutputBuffer out(1);
+    return out;
+}
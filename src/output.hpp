@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Room for any formatted float: the 309 integer digits of DBL_MAX, a sign,
+// the point and six decimals
+constexpr size_t MAX_FLOAT_TEXT = 320;
+
+// Six decimals like printf's %f, minus trailing zeros; at least one decimal
+// stays so floats never print like ints (2.5, 3.0). The first form writes
+// into `buffer` (MAX_FLOAT_TEXT bytes) and returns the length.
+size_t formatFloat(double value, char* buffer);
+std::string formatFloat(double value);
+
+// Bools are 0 or 1, so the text is a table lookup rather than a branch
+inline std::string_view formatBool(int64_t value) {
+    static constexpr std::string_view texts[] = {"false", "true"};
+    return texts[value != 0];
+}
+
+// Output of programs run in-process (the VM and the JIT). Everything is
+// collected in one fixed buffer that lives as long as the process, so
+// printing never allocates; ints and floats are formatted straight into it
+// with std::to_chars (no stdio, iostreams or locale). The buffer goes to
+// the file descriptor when it is full and at explicit flush points: the end
+// of a run, before a runtime error is reported, and at exit.
+class OutputBuffer {
+private:
+    static constexpr size_t CAPACITY = 64 * 1024;
+
+    char data[CAPACITY];
+    size_t size = 0;
+    int fd;
+
+    // Makes room for `length` bytes of formatted text
+    void reserve(size_t length) {
+        if (CAPACITY - size < length) flush();
+    }
+
+public:
+    explicit OutputBuffer(int fd) : fd(fd) {}
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void write(std::string_view text) {
+        if (text.size() > CAPACITY - size) {
+            writeLarge(text);
+            return;
+        }
+        std::memcpy(data + size, text.data(), text.size());
+        size += text.size();
+    }
+
+    void put(char c) {
+        reserve(1);
+        data[size++] = c;
+    }
+
+    void writeLarge(std::string_view text);
+    void writeInt(int64_t value);
+    void writeFloat(double value);
+    void writeBool(int64_t value) { write(formatBool(value)); }
+
+    // Hands everything buffered to the file descriptor
+    void flush();
+
+    // The process's stdout
+    static OutputBuffer& standardOutput();
+};
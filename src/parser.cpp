@@ -1,11 +1,14 @@
 #include "parser.hpp"
+#include "scan.hpp"
 #include <iostream>
 #include <cctype>
+#include <chrono>
+#include <iomanip>
 #include <unordered_map>
 
 // Lexer Implementation
-std::vector<TokenData> LexerEngine::tokenize(const std::string& source) {
-    Lexer lexer(source);
+std::vector<TokenData> LexerEngine::tokenize(std::string_view source, StringInterner* interner) {
+    Lexer lexer(source, interner);
     std::vector<TokenData> tokens;
     
     TokenData token;
@@ -17,24 +20,157 @@ std::vector<TokenData> LexerEngine::tokenize(const std::string& source) {
     return tokens;
 }
 
-Token LexerEngine::getKeywordToken(const std::string& word) {
-    static std::unordered_map<std::string, Token> keywords = {
-        {"new", NEW},
-        {"bl", BL},
-        {"stdout", STDOUT},
-        {"string", STRING},
-        {"int", INTEGER},
-        {"float", FLOAT},
-        {"bool", BOOL},
-        {"char", CHARACTER},
-        {"True", TRUE_VAL},
-        {"true", TRUE_VAL},
-        {"False", FALSE_VAL},
-        {"false", FALSE_VAL}
-    };
+// Keyword recognition uses a perfect hash over (first char, last char, length)
+// whose coefficients are searched for at compile time, so a lookup is one
+// hash, one table load and at most one short compare, with no allocation.
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    Token token;
+};
+
+constexpr Keyword KEYWORDS[] = {
+    {"new", NEW},
+    {"bl", BL},
+    {"stdout", STDOUT},
+    {"string", STRING},
+    {"int", INTEGER},
+    {"float", FLOAT},
+    {"bool", BOOL},
+    {"char", CHARACTER},
+    {"True", TRUE_VAL},
+    {"true", TRUE_VAL},
+    {"False", FALSE_VAL},
+    {"false", FALSE_VAL},
+};
+
+constexpr size_t KEYWORD_TABLE_SIZE = 16;  // power of two, >= keyword count
+constexpr size_t KEYWORD_MIN_LENGTH = 2;
+constexpr size_t KEYWORD_MAX_LENGTH = 6;
+
+struct KeywordHash {
+    unsigned first, last, length;
+
+    constexpr size_t operator()(std::string_view word) const {
+        unsigned mix = (unsigned char)word.front() * first + (unsigned char)word.back() * last
+                     + (unsigned)word.size() * length;
+        return (mix >> 3) & (KEYWORD_TABLE_SIZE - 1);
+    }
+};
+
+constexpr bool isCollisionFree(KeywordHash hash) {
+    bool used[KEYWORD_TABLE_SIZE] = {};
+    for (const Keyword& keyword : KEYWORDS) {
+        size_t slot = hash(keyword.text);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr KeywordHash findKeywordHash() {
+    for (unsigned length = 0; length < 8; length++) {
+        for (unsigned first = 1; first < 64; first++) {
+            for (unsigned last = 0; last < 64; last++) {
+                if (isCollisionFree(KeywordHash{first, last, length})) {
+                    return KeywordHash{first, last, length};
+                }
+            }
+        }
+    }
+    return KeywordHash{0, 0, 0};
+}
+
+constexpr bool lengthsInRange() {
+    for (const Keyword& keyword : KEYWORDS) {
+        if (keyword.text.size() < KEYWORD_MIN_LENGTH || keyword.text.size() > KEYWORD_MAX_LENGTH) return false;
+    }
+    return true;
+}
+static_assert(lengthsInRange(), "update KEYWORD_MIN_LENGTH/KEYWORD_MAX_LENGTH");
+
+constexpr KeywordHash KEYWORD_HASH = findKeywordHash();
+static_assert(isCollisionFree(KEYWORD_HASH), "no perfect hash found for the keyword set");
+
+struct KeywordTable {
+    Keyword slots[KEYWORD_TABLE_SIZE];
+
+    constexpr KeywordTable() : slots() {
+        for (Keyword& slot : slots) slot = Keyword{std::string_view(), IDENTIFIER};
+        for (const Keyword& keyword : KEYWORDS) slots[KEYWORD_HASH(keyword.text)] = keyword;
+    }
+};
+
+constexpr KeywordTable KEYWORD_TABLE;
+
+} // namespace
+
+Token LexerEngine::getKeywordToken(std::string_view word) {
+    if (word.size() < KEYWORD_MIN_LENGTH || word.size() > KEYWORD_MAX_LENGTH) {
+        return IDENTIFIER;
+    }
     
-    auto it = keywords.find(word);
-    return (it != keywords.end()) ? it->second : IDENTIFIER;
+    const Keyword& candidate = KEYWORD_TABLE.slots[KEYWORD_HASH(word)];
+    return candidate.text == word ? candidate.token : IDENTIFIER;
+}
+
+void LexerEngine::benchmarkKeywords(std::string_view source, long rounds, std::ostream& out) {
+    std::vector<std::string_view> words;
+    size_t keywords = 0;
+    for (size_t i = 0; i < source.size();) {
+        if (!std::isalpha((unsigned char)source[i]) && source[i] != '_') {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < source.size() && (std::isalnum((unsigned char)source[i]) || source[i] == '_')) i++;
+        words.push_back(source.substr(start, i - start));
+        if (getKeywordToken(words.back()) != IDENTIFIER) keywords++;
+    }
+    if (words.empty() || rounds <= 0) {
+        out << "no words to look up" << std::endl;
+        return;
+    }
+
+    // The lookups this table replaced: the original map keyed by copies of
+    // the word, and the same map keyed by views
+    std::unordered_map<std::string, Token> copied;
+    std::unordered_map<std::string_view, Token> viewed;
+    for (const Keyword& keyword : KEYWORDS) {
+        copied.emplace(std::string(keyword.text), keyword.token);
+        viewed.emplace(keyword.text, keyword.token);
+    }
+
+    // Summing the results keeps the lookups from being optimized away
+    using Clock = std::chrono::steady_clock;
+    volatile unsigned sink = 0;
+    auto measure = [&](auto lookup) {
+        unsigned sum = 0;
+        Clock::time_point start = Clock::now();
+        for (long round = 0; round < rounds; round++) {
+            for (std::string_view word : words) sum += (unsigned)lookup(word);
+        }
+        double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        sink = sink + sum;
+        return elapsed / ((double)words.size() * rounds);
+    };
+    double copiedTime = measure([&](std::string_view word) {
+        auto it = copied.find(std::string(word));
+        return it != copied.end() ? it->second : IDENTIFIER;
+    });
+    double viewedTime = measure([&](std::string_view word) {
+        auto it = viewed.find(word);
+        return it != viewed.end() ? it->second : IDENTIFIER;
+    });
+    double hashedTime = measure([](std::string_view word) { return getKeywordToken(word); });
+
+    out << std::fixed << std::setprecision(2) << words.size() << " words, " << keywords << " keywords, "
+        << rounds << " rounds, ns per lookup:\n"
+        << "  unordered_map<string>, copied word  " << std::setw(7) << copiedTime << " ns\n"
+        << "  unordered_map<string_view>          " << std::setw(7) << viewedTime << " ns\n"
+        << "  perfect hash                        " << std::setw(7) << hashedTime << " ns  ("
+        << copiedTime / hashedTime << "x)" << std::endl;
 }
 
 std::string LexerEngine::tokenTypeToString(Token type) {
@@ -51,10 +187,16 @@ std::string LexerEngine::tokenTypeToString(Token type) {
         case FALSE_VAL: return "FALSE";
         case ASSIGNMENT: return "ASSIGNMENT";
         case EQUAL: return "EQUAL";
+        case NOT_EQUAL: return "NOT_EQUAL";
+        case GREATER: return "GREATER";
+        case LESSER: return "LESSER";
+        case GREATER_EQUAL: return "GREATER_EQUAL";
+        case LESSER_EQUAL: return "LESSER_EQUAL";
         case ADD: return "ADD";
         case SUB: return "SUB";
         case MUL: return "MUL";
         case DIV: return "DIV";
+        case MOD: return "MOD";
         case STDOPEN: return "STDOPEN";
         case STDCLOSE: return "STDCLOSE";
         case LBRACE: return "LBRACE";
@@ -78,42 +220,37 @@ char LexerEngine::peekNext(const Lexer& lexer) {
 
 char LexerEngine::advance(Lexer& lexer) {
     if (lexer.current >= lexer.source.length()) return '\0';
-    
-    char c = lexer.source[lexer.current++];
-    if (c == '\n') {
-        lexer.line++;
-        lexer.column = 1;
-    } else {
-        lexer.column++;
-    }
-    return c;
+    return lexer.source[lexer.current++];
 }
 
 void LexerEngine::skipWhitespace(Lexer& lexer) {
-    while (std::isspace(peek(lexer))) {
-        advance(lexer);
-    }
+    if (!std::isspace(peek(lexer))) return;
+    lexer.current = Scan::skipWhitespace(lexer.source.data(), lexer.current, lexer.source.length());
+}
+
+// Every token spans the source bytes from `start` to where the lexer stopped
+TokenData LexerEngine::makeToken(const Lexer& lexer, Token type, uint32_t start, SymbolId symbol) {
+    return TokenData(type, start, (uint32_t)lexer.current - start, symbol);
 }
 
 TokenData LexerEngine::readIdentifier(Lexer& lexer) {
-    size_t start = lexer.current;
-    int line = lexer.line;
-    int column = lexer.column;
+    uint32_t offset = (uint32_t)lexer.current;
     
-    while (std::isalnum(peek(lexer)) || peek(lexer) == '_') {
-        advance(lexer);
-    }
+    lexer.current = Scan::skipIdentifier(lexer.source.data(), lexer.current, lexer.source.length());
     
-    std::string value = lexer.source.substr(start, lexer.current - start);
+    std::string_view value = lexer.source.substr(offset, lexer.current - offset);
     Token type = getKeywordToken(value);
     
-    return TokenData(type, value, line, column);
+    SymbolId symbol = NO_SYMBOL;
+    if (type == IDENTIFIER && lexer.interner) {
+        symbol = lexer.interner->intern(value);
+    }
+    
+    return makeToken(lexer, type, offset, symbol);
 }
 
 TokenData LexerEngine::readNumber(Lexer& lexer) {
-    size_t start = lexer.current;
-    int line = lexer.line;
-    int column = lexer.column;
+    uint32_t offset = (uint32_t)lexer.current;
     bool isFloat = false;
     
     while (std::isdigit(peek(lexer))) {
@@ -129,65 +266,49 @@ TokenData LexerEngine::readNumber(Lexer& lexer) {
         }
     }
     
-    std::string value = lexer.source.substr(start, lexer.current - start);
-    Token type = isFloat ? FLOAT : INTEGER;
-    
-    return TokenData(type, value, line, column);
+    return makeToken(lexer, isFloat ? FLOAT : INTEGER, offset);
 }
 
 TokenData LexerEngine::readString(Lexer& lexer) {
-    int line = lexer.line;
-    int column = lexer.column;
+    uint32_t offset = (uint32_t)lexer.current;
     
     advance(lexer); // consume opening quote
     
-    std::string value;
-    while (peek(lexer) != '"' && peek(lexer) != '\0') {
-        value += advance(lexer);
-    }
+    lexer.current = Scan::findTerminator(lexer.source.data(), lexer.current, lexer.source.length(), '"');
     
     if (peek(lexer) == '"') {
         advance(lexer); // consume closing quote
-    } else {
-        g_errorHandler.addLexicalError("Unterminated string literal", line, column, 
+    } else if (lexer.errors) {
+        lexer.errors->addLexicalError("Unterminated string literal", offset, 
                                       "Add closing quote '\"' to end the string");
     }
     
-    return TokenData(STRING, value, line, column);
+    return makeToken(lexer, STRING, offset);
 }
 
 TokenData LexerEngine::readStdoutContent(Lexer& lexer) {
-    int line = lexer.line;
-    int column = lexer.column;
-    
+    uint32_t offset = (uint32_t)lexer.current;
     
     advance(lexer); // consume '['
     
-    std::string value;
-    while (peek(lexer) != ']' && peek(lexer) != '\0') {
-        value += advance(lexer);
-    }
+    lexer.current = Scan::findTerminator(lexer.source.data(), lexer.current, lexer.source.length(), ']');
     
     if (peek(lexer) == ']') {
         advance(lexer); // consume ']'
     }
     
-    return TokenData(STRING, value, line, column);
+    return makeToken(lexer, STRING, offset);
 }
 
 TokenData LexerEngine::readComment(Lexer& lexer) {
-    int startLine = lexer.line;
-    int startCol  = lexer.column;
-    std::string value;
+    uint32_t offset = (uint32_t)lexer.current;
 
     // // single-line comment
     if (peek(lexer) == '/' && peekNext(lexer) == '/') {
         advance(lexer); // '/'
         advance(lexer); // '/'
-        while (peek(lexer) != '\0' && peek(lexer) != '\n' && peek(lexer) != '\r') {
-            value += advance(lexer);
-        }
-        return TokenData(COMMENT, value, startLine, startCol);
+        lexer.current = Scan::findLineEnd(lexer.source.data(), lexer.current, lexer.source.length());
+        return makeToken(lexer, COMMENT, offset);
     }
 
     // ; comments
@@ -196,29 +317,46 @@ TokenData LexerEngine::readComment(Lexer& lexer) {
         if (peekNext(lexer) == ';') {
             advance(lexer); // ';'
             advance(lexer); // ';'
-            while (peek(lexer) != '\0' && peek(lexer) != '\n' && peek(lexer) != '\r') {
-                value += advance(lexer);
-            }
-            return TokenData(COMMENT, value, startLine, startCol);
+            lexer.current = Scan::findLineEnd(lexer.source.data(), lexer.current, lexer.source.length());
+            return makeToken(lexer, COMMENT, offset);
         }
 
         // ; ... ; multi-line comment (closes at next ';')
         advance(lexer); // consume opening ';'
-        while (peek(lexer) != '\0') {
-            if (peek(lexer) == ';') {
-                advance(lexer); // consume closing ';'
-                return TokenData(COMMENT, value, startLine, startCol);
-            }
-            value += advance(lexer);
+        lexer.current = Scan::findTerminator(lexer.source.data(), lexer.current, lexer.source.length(), ';');
+        if (peek(lexer) == ';') {
+            advance(lexer); // consume closing ';'
         }
-
-        // EOF reached without closing ';' — still return what we collected
-        // optionally emit a warning about unterminated comment
-        return TokenData(COMMENT, value, startLine, startCol);
+        // If EOF was reached without a closing ';' we still return what we
+        // collected; optionally emit a warning about unterminated comment
+        return makeToken(lexer, COMMENT, offset);
     }
 
     // Shouldn't get here — fallback
-    return TokenData(COMMENT, std::string(), startLine, startCol);
+    return makeToken(lexer, COMMENT, offset);
+}
+
+// Strips the delimiters that are part of a token's span but not of its value
+std::string_view LexerEngine::tokenText(const TokenData& token, std::string_view source) {
+    if (token.type == END_OF_FILE) return "EOF";
+    
+    std::string_view text = source.substr(token.offset, token.length);
+    if (text.empty()) return text;
+    
+    // STRING is also the `string` type keyword, which has no quotes
+    if (token.type == STRING && (text.front() == '"' || text.front() == '[')) {
+        char close = text.front() == '[' ? ']' : '"';
+        text.remove_prefix(1);
+        if (!text.empty() && text.back() == close) text.remove_suffix(1);
+    } else if (token.type == COMMENT) {
+        if (text.starts_with("//") || text.starts_with(";;")) {
+            text.remove_prefix(2);
+        } else {
+            text.remove_prefix(1);
+            if (!text.empty() && text.back() == ';') text.remove_suffix(1);
+        }
+    }
+    return text;
 }
 
 
@@ -226,12 +364,11 @@ TokenData LexerEngine::nextToken(Lexer& lexer) {
     skipWhitespace(lexer);
     
     if (lexer.current >= lexer.source.length()) {
-        return TokenData(END_OF_FILE, "EOF", lexer.line, lexer.column);
+        return makeToken(lexer, END_OF_FILE, (uint32_t)lexer.current);
     }
     
     char c = peek(lexer);
-    int line = lexer.line;
-    int column = lexer.column;
+    uint32_t offset = (uint32_t)lexer.current;
     
     // Handle comments
     if (c == '/' && peekNext(lexer) == '/') {
@@ -264,121 +401,139 @@ TokenData LexerEngine::nextToken(Lexer& lexer) {
             advance(lexer);
             if (peek(lexer) == '=') {
                 advance(lexer);
-                return TokenData(EQUAL, "==", line, column);
+                return makeToken(lexer, EQUAL, offset);
             } else {
-                return TokenData(ASSIGNMENT, "=", line, column);
+                return makeToken(lexer, ASSIGNMENT, offset);
             }
         case '!':
             advance(lexer);
             if (peek(lexer) == '=') {
                 advance(lexer);
-                return TokenData(NOT_EQUAL, "!=", line, column);
+                return makeToken(lexer, NOT_EQUAL, offset);
             } else {
-                return TokenData(UNKNOWN, "!", line, column);
+                return makeToken(lexer, UNKNOWN, offset);
             }
         case '>':
             advance(lexer);
             if (peek(lexer) == '=') {
                 advance(lexer);
-                return TokenData(GREATER_EQUAL, ">=", line, column);
+                return makeToken(lexer, GREATER_EQUAL, offset);
             } else {
-                return TokenData(GREATER, ">", line, column);
+                return makeToken(lexer, GREATER, offset);
             }
         case '<':
             advance(lexer);
             if (peek(lexer) == '=') {
                 advance(lexer);
-                return TokenData(LESSER_EQUAL, "<=", line, column);
+                return makeToken(lexer, LESSER_EQUAL, offset);
             } else {
-                return TokenData(LESSER, "<", line, column);
+                return makeToken(lexer, LESSER, offset);
             }
         case '+':
             advance(lexer);
-            return TokenData(ADD, "+", line, column);
+            return makeToken(lexer, ADD, offset);
         case '-':
             advance(lexer);
-            return TokenData(SUB, "-", line, column);
+            return makeToken(lexer, SUB, offset);
         case '*':
             advance(lexer);
-            return TokenData(MUL, "*", line, column);
+            return makeToken(lexer, MUL, offset);
         case '/':
             advance(lexer);
-            return TokenData(DIV, "/", line, column);
+            return makeToken(lexer, DIV, offset);
         case '%':
             advance(lexer);
-            return TokenData(MOD, "%", line, column);
+            return makeToken(lexer, MOD, offset);
         case '(':
             advance(lexer);
-            return TokenData(LPAREN, "(", line, column);
+            return makeToken(lexer, LPAREN, offset);
         case ')':
             advance(lexer);
-            return TokenData(RPAREN, ")", line, column);
+            return makeToken(lexer, RPAREN, offset);
         case '{':
             advance(lexer);
-            return TokenData(TYPE_OPEN, "{", line, column);
+            return makeToken(lexer, TYPE_OPEN, offset);
         case '}':
             advance(lexer);
-            return TokenData(TYPE_CLOSE, "}", line, column);
+            return makeToken(lexer, TYPE_CLOSE, offset);
         case '[':
             // Check if this is array literal or stdout content
             // For now, assume it's array literal if not after stdout
             advance(lexer);
-            return TokenData(ARRAY_OPEN, "[", line, column);
+            return makeToken(lexer, ARRAY_OPEN, offset);
         case ']':
             advance(lexer);
-            return TokenData(ARRAY_CLOSE, "]", line, column);
+            return makeToken(lexer, ARRAY_CLOSE, offset);
         case ',':
             advance(lexer);
-            return TokenData(COMMA, ",", line, column);
+            return makeToken(lexer, COMMA, offset);
         case '.':
             advance(lexer);
-            return TokenData(DOT, ".", line, column);
+            return makeToken(lexer, DOT, offset);
         case ':':
             advance(lexer);
-            return TokenData(COLON, ":", line, column);
+            return makeToken(lexer, COLON, offset);
         default:
             std::string suggestion = "Remove this character or check if it's part of a valid token";
             if (c == '@' || c == '#' || c == '$') {
                 suggestion = "This character is not valid in this language";
             }
-            g_errorHandler.addLexicalError("Unexpected character '" + std::string(1, c) + "'", 
-                                          line, column, suggestion);
+            if (lexer.errors) {
+                lexer.errors->addLexicalError("Unexpected character '" + std::string(1, c) + "'", 
+                                              offset, suggestion);
+            }
             advance(lexer);
-            return TokenData(UNKNOWN, std::string(1, c), line, column);
+            return makeToken(lexer, UNKNOWN, offset);
     }
 }
 
 // Parser Implementation
-void ParserEngine::initParser(Parser& parser, const std::vector<TokenData>& tokens) {
-    parser.tokens = tokens;
-    parser.token_count = tokens.size();
-    parser.current = 0;
-    if (!tokens.empty()) {
-        parser.line = tokens[0].line;
-        parser.col = tokens[0].column;
+
+// Returns the token at absolute stream position `index`, lexing up to it first
+// in streaming mode. Positions that already fell out of the window are gone.
+TokenData* ParserEngine::tokenAt(Parser& parser, int index) {
+    if (!parser.streaming) {
+        return index < parser.token_count ? &parser.tokens[index] : nullptr;
+    }
+    
+    if (index < parser.lexed - PARSER_WINDOW) {
+        return nullptr;
     }
+    while (parser.lexed <= index && parser.lexed < parser.token_count) {
+        TokenData& slot = parser.window[parser.lexed & (PARSER_WINDOW - 1)];
+        slot = LexerEngine::nextToken(parser.lexer);
+        parser.lexed++;
+        if (slot.type == END_OF_FILE) {
+            parser.token_count = parser.lexed;
+        }
+    }
+    if (index >= parser.token_count) {
+        return nullptr;
+    }
+    return &parser.window[index & (PARSER_WINDOW - 1)];
 }
 
 TokenData* ParserEngine::currentToken(Parser& parser) {
-    if (parser.current >= parser.token_count) {
-        return nullptr;
-    }
-    return &parser.tokens[parser.current];
+    return tokenAt(parser, parser.current);
 }
 
-TokenData* ParserEngine::peekToken(Parser& parser) {
-    if (parser.current + 1 >= parser.token_count) {
+// Returns the token `offset` positions after the current one, or nullptr past the end
+TokenData* ParserEngine::peekToken(Parser& parser, int offset) {
+    if (offset < 0 || (parser.streaming && offset >= PARSER_WINDOW)) {
         return nullptr;
     }
-    return &parser.tokens[parser.current + 1];
+    return tokenAt(parser, parser.current + offset);
+}
+
+std::string_view ParserEngine::tokenText(const Parser& parser, const TokenData* token) {
+    return LexerEngine::tokenText(*token, parser.lexer.source);
 }
 
 void ParserEngine::advanceParser(Parser& parser) {
     if (parser.current < parser.token_count) {
         parser.current++;
-        if (parser.current < parser.token_count) {
-            parser.line = parser.tokens[parser.current].line;
-            parser.col = parser.tokens[parser.current].column;
+        if (TokenData* token = tokenAt(parser, parser.current)) {
+            parser.offset = token->offset;
         }
     }
 }
@@ -399,12 +554,14 @@ bool ParserEngine::consumeToken(Parser& parser, Token expected) {
 void ParserEngine::parserError(Parser& parser, const std::string& message) {
     TokenData* token = currentToken(parser);
     if (token) {
-        std::string fullMessage = message + " (found '" + token->value + "')";
+        std::string_view text = tokenText(parser, token);
+        std::string fullMessage = message + " (found '" + std::string(text) + "')";
         std::string suggestion = getSuggestionForToken(token->type, message);
-        int endCol = token->column + (int)token->value.length() - 1;
-        g_errorHandler.addSyntaxError(fullMessage, token->line, token->column, suggestion, endCol);
-    } else {
-        g_errorHandler.addSyntaxError(message + " (at end of input)", parser.line, parser.col);
+        if (parser.lexer.errors) {
+            parser.lexer.errors->addSyntaxError(fullMessage, token->offset, suggestion, (uint32_t)text.length());
+        }
+    } else if (parser.lexer.errors) {
+        parser.lexer.errors->addSyntaxError(message + " (at end of input)", parser.offset);
     }
 }
 
@@ -1,9 +1,13 @@
 #pragma once
+#include <climits>
+#include <iosfwd>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "error.hpp"
+#include "interner.hpp"
 
-typedef enum Token {
+typedef enum Token : uint8_t {
     ASSIGNMENT,   // =
     EQUAL,        // ==
     NOT_EQUAL,    // !=
@@ -56,66 +60,121 @@ typedef enum Token {
     UNKNOWN,
 } Token;
 
+// A token is just its kind and the byte span [offset, offset + length) it
+// covers in the source buffer (see SourceBuffer); the text is read back from
+// the buffer with LexerEngine::tokenText, so tokens are only meaningful
+// together with that buffer. Positions resolve to line/column through a
+// LineTable (see lines.hpp) only when needed. Identifiers also carry their
+// interned SymbolId when the lexer has an interner.
 struct TokenData {
     Token type;
-    std::string value;
-    int line;
-    int column;
+    uint32_t offset;
+    uint32_t length;
+    SymbolId symbol;
     
-    TokenData() : type(UNKNOWN), value(""), line(0), column(0) {}
-    TokenData(Token t, const std::string& v, int l, int c) 
-        : type(t), value(v), line(l), column(c) {}
+    TokenData() : type(UNKNOWN), offset(0), length(0), symbol(NO_SYMBOL) {}
+    TokenData(Token t, uint32_t off, uint32_t len, SymbolId sym = NO_SYMBOL) 
+        : type(t), offset(off), length(len), symbol(sym) {}
 };
+static_assert(sizeof(TokenData) == 16, "TokenData should stay 16 bytes");
 
 struct Lexer {
-    std::string source;
+    std::string_view source;
+    StringInterner* interner;  // identifiers are interned here when set
+    ErrorHandler* errors;      // lexical and syntax errors go here when set
     size_t current;
-    int line;
-    int column;
     
-    Lexer(const std::string& src) : source(src), current(0), line(1), column(1) {}
+    Lexer(std::string_view src = std::string_view(), StringInterner* symbols = nullptr,
+          ErrorHandler* diagnostics = nullptr)
+        : source(src), interner(symbols), errors(diagnostics), current(0) {}
 };
 
+class FlatAST;
+
+// Binary operator (or '(' marker, with precedence 0) waiting on the operator
+// stack of ASTParser::parseExpression
+struct PendingOperator {
+    Token op;
+    uint8_t precedence;
+    uint32_t offset;
+};
+
+// Number of tokens a streaming parser keeps around (the current token plus
+// its lookahead). A TokenData* handed out by the parser stays valid until the
+// parser has looked PARSER_WINDOW tokens past it. Must be a power of two.
+constexpr int PARSER_WINDOW = 16;
+
+// A parser reads either from a fully materialized token vector or, in
+// streaming mode, pulls tokens from `lexer` on demand into `window`. In both
+// modes lexer.source is the buffer the tokens' text is read from.
 struct Parser {
     std::vector<TokenData> tokens;
-    int token_count;
+    Lexer lexer;
+    FlatAST* ast;     // where nodes parsed from this parser are appended
+    bool streaming;
+    TokenData window[PARSER_WINDOW];
+    int lexed;        // tokens pulled from the lexer so far (streaming mode)
+    int token_count;  // total tokens; unknown (INT_MAX) until the lexer hits EOF
     int current;
-    int line, col;
+    uint32_t offset;  // position of the last token reached, for errors at end of input
+    
+    // Scratch stacks for expression parsing, shared by nested expressions
+    std::vector<uint32_t> operands;  // NodeIds
+    std::vector<PendingOperator> operators;
+    // Entries of the child lists still being parsed, innermost last; a list
+    // is copied into FlatAST::lists in one piece once it is complete
+    std::vector<uint32_t> listItems;
     
-    Parser() : token_count(0), current(0), line(1), col(1) {}
-    Parser(const std::vector<TokenData>& toks) 
-        : tokens(toks), token_count(toks.size()), current(0), line(1), col(1) {}
+    Parser() : ast(nullptr), streaming(false), lexed(0), token_count(0), current(0), offset(0) {}
+    Parser(std::vector<TokenData> toks, std::string_view source) 
+        : tokens(std::move(toks)), lexer(source), ast(nullptr), streaming(false), lexed(0), token_count(tokens.size()), 
+          current(0), offset(0) {}
+    Parser(std::string_view source, StringInterner& symbols, ErrorHandler& errors)
+        : lexer(source, &symbols, &errors), ast(nullptr), streaming(true), lexed(0), token_count(INT_MAX), current(0), offset(0) {}
+    
+    // Copying would duplicate the whole token stream; look ahead with peekToken instead
+    Parser(const Parser&) = delete;
+    Parser& operator=(const Parser&) = delete;
 };
 
 // Lexer functions
 class LexerEngine {
 public:
-    static std::vector<TokenData> tokenize(const std::string& source);
-    static Token getKeywordToken(const std::string& word);
+    static std::vector<TokenData> tokenize(std::string_view source, StringInterner* interner = nullptr);
+    static Token getKeywordToken(std::string_view word);
+    // Times getKeywordToken against the unordered_map lookups it replaced on
+    // every identifier-shaped word of `source`, `rounds` times over
+    static void benchmarkKeywords(std::string_view source, long rounds, std::ostream& out);
     static std::string tokenTypeToString(Token type);
+    static TokenData nextToken(Lexer& lexer);
+    // The token's value: its source text without quotes or comment markers
+    static std::string_view tokenText(const TokenData& token, std::string_view source);
     
 private:
     static char peek(const Lexer& lexer);
     static char peekNext(const Lexer& lexer);
     static char advance(Lexer& lexer);
+    static TokenData makeToken(const Lexer& lexer, Token type, uint32_t start, SymbolId symbol = NO_SYMBOL);
     static void skipWhitespace(Lexer& lexer);
     static TokenData readIdentifier(Lexer& lexer);
     static TokenData readNumber(Lexer& lexer);
     static TokenData readString(Lexer& lexer);
     static TokenData readStdoutContent(Lexer& lexer);
     static TokenData readComment(Lexer& lexer);
-    static TokenData nextToken(Lexer& lexer);
 };
 
 // Parser functions
 class ParserEngine {
 public:
-    static void initParser(Parser& parser, const std::vector<TokenData>& tokens);
     static TokenData* currentToken(Parser& parser);
-    static TokenData* peekToken(Parser& parser);
+    static TokenData* peekToken(Parser& parser, int offset = 1);
+    static std::string_view tokenText(const Parser& parser, const TokenData* token);
     static void advanceParser(Parser& parser);
     static bool matchToken(Parser& parser, Token expected);
     static bool consumeToken(Parser& parser, Token expected);
     static void parserError(Parser& parser, const std::string& message);
     static std::string getSuggestionForToken(Token tokenType, const std::string& message);
+    
+private:
+    static TokenData* tokenAt(Parser& parser, int index);
 };
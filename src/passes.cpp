@@ -0,0 +1,320 @@
+#include "passes.hpp"
+#include "output.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+void makeConstant(IRInstruction& instr, uint64_t bits) {
+    instr.kind = IROp::CONST;
+    instr.operandCount = 0;
+    instr.bits = bits;
+}
+
+bool isConstant(const IRProgram& program, IRValue value) {
+    return program.values[value].kind == IROp::CONST;
+}
+
+Value constantValue(const IRProgram& program, IRValue value) {
+    Value result;
+    result.ref = program.values[value].bits;
+    return result;
+}
+
+// `order` is a three-way comparison; `group` the operator's position in EQ..GE
+int64_t compareResult(int order, int group) {
+    bool results[] = {order == 0, order != 0, order < 0, order <= 0, order > 0, order >= 0};
+    return results[group] ? 1 : 0;
+}
+
+template <typename T>
+int threeWay(T a, T b) {
+    return (a > b) - (a < b);
+}
+
+// False if the operation has to happen at run time (division by zero)
+bool evaluateBinary(IRProgram& program, Op op, Value a, Value b, Value& result) {
+    switch (op) {
+        case Op::ADD_I: result.i = (int64_t)((uint64_t)a.i + (uint64_t)b.i); return true;
+        case Op::SUB_I: result.i = (int64_t)((uint64_t)a.i - (uint64_t)b.i); return true;
+        case Op::MUL_I: result.i = (int64_t)((uint64_t)a.i * (uint64_t)b.i); return true;
+        case Op::DIV_I:
+            if (b.i == 0) return false;
+            result.i = b.i == -1 ? (int64_t)(0 - (uint64_t)a.i) : a.i / b.i;
+            return true;
+        case Op::MOD_I:
+            if (b.i == 0) return false;
+            result.i = b.i == -1 ? 0 : a.i % b.i;
+            return true;
+        case Op::ADD_F: result.f = a.f + b.f; return true;
+        case Op::SUB_F: result.f = a.f - b.f; return true;
+        case Op::MUL_F: result.f = a.f * b.f; return true;
+        case Op::DIV_F: result.f = a.f / b.f; return true;
+        case Op::MOD_F: result.f = std::fmod(a.f, b.f); return true;
+        case Op::CONCAT:
+            result.ref = program.addString(std::string(program.strings[a.ref]) + std::string(program.strings[b.ref]));
+            return true;
+        default:
+            break;
+    }
+
+    // Comparisons; NaN compares false like it does at run time
+    if (op >= Op::EQ_I && op <= Op::GE_I) {
+        result.i = compareResult(threeWay(a.i, b.i), (int)op - (int)Op::EQ_I);
+    } else if (op >= Op::EQ_F && op <= Op::GE_F) {
+        bool results[] = {a.f == b.f, a.f != b.f, a.f < b.f, a.f <= b.f, a.f > b.f, a.f >= b.f};
+        result.i = results[(int)op - (int)Op::EQ_F] ? 1 : 0;
+    } else if (op >= Op::EQ_S && op <= Op::GE_S) {
+        int order = program.strings[a.ref].compare(program.strings[b.ref]);
+        result.i = compareResult(order, (int)op - (int)Op::EQ_S);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Value evaluateConversion(IRProgram& program, Op op, Value a) {
+    Value result;
+    switch (op) {
+        case Op::INT_TO_FLOAT: result.f = (double)a.i; break;
+        case Op::INT_TO_STRING: result.ref = program.addString(std::to_string(a.i)); break;
+        case Op::FLOAT_TO_STRING: result.ref = program.addString(formatFloat(a.f)); break;
+        default: result.ref = program.addString(std::string(formatBool(a.i))); break;
+    }
+    return result;
+}
+
+// Arrays larger than this are printed at run time rather than stored as text
+constexpr uint64_t MAX_FOLDED_ARRAY = 4096;
+
+void appendConstant(const IRProgram& program, ValueType type, uint64_t bits, std::string& text) {
+    Value value;
+    value.ref = bits;
+    switch (type) {
+        case ValueType::FLOAT_TYPE: text += formatFloat(value.f); break;
+        case ValueType::BOOL_TYPE: text += formatBool(value.i); break;
+        case ValueType::STRING_TYPE: text += program.strings[value.ref]; break;
+        default: text += std::to_string(value.i); break;
+    }
+}
+
+// Appends what a write prints if that is known at compile time
+bool appendOutput(const IRProgram& program, IRValue value, std::string& text) {
+    const IRInstruction& instr = program.values[value];
+    switch (instr.kind) {
+        case IROp::WRITE_TEXT:
+            text += program.strings[instr.bits];
+            return true;
+        case IROp::WRITE_NEWLINE:
+            text += '\n';
+            return true;
+        case IROp::WRITE:
+            break;
+        default:
+            return false;
+    }
+
+    IRValue operand = program.operand(value, 0);
+    const IRInstruction& written = program.values[operand];
+    if (written.kind == IROp::CONST) {
+        appendConstant(program, written.type, written.bits, text);
+        return true;
+    }
+    if (written.kind != IROp::ARRAY_NEW || arraySize(written.bits) > MAX_FOLDED_ARRAY) {
+        return false;
+    }
+    for (uint32_t i = 0; i < written.operandCount; i++) {
+        if (program.values[program.operand(operand, i)].kind != IROp::CONST) return false;
+    }
+
+    // Items past the initializers are zero; a zero string is the empty string
+    ValueType elementType = arrayElementType(written.bits);
+    text += '[';
+    for (uint64_t i = 0; i < arraySize(written.bits); i++) {
+        if (i > 0) text += ", ";
+        if (i < written.operandCount) {
+            appendConstant(program, elementType, program.values[program.operand(operand, (uint32_t)i)].bits, text);
+        } else if (elementType != ValueType::STRING_TYPE) {
+            appendConstant(program, elementType, 0, text);
+        }
+    }
+    text += ']';
+    return true;
+}
+
+} // namespace
+
+// Operands are defined before their users within a block, so one forward
+// sweep sees every constant operand already folded
+void foldConstants(IRProgram& program) {
+    for (IRBlock& block : program.blocks) {
+        for (IRValue value : block.instructions) {
+            IRInstruction& instr = program.values[value];
+            switch (instr.kind) {
+                case IROp::COPY:
+                    if (isConstant(program, program.operand(value, 0))) {
+                        makeConstant(instr, program.values[program.operand(value, 0)].bits);
+                    }
+                    break;
+
+                case IROp::PHI: {
+                    bool same = instr.operandCount > 0;
+                    for (uint32_t i = 0; same && i < instr.operandCount; i++) {
+                        IRValue incoming = program.operand(value, i);
+                        same = isConstant(program, incoming) &&
+                               program.values[incoming].bits == program.values[program.operand(value, 0)].bits;
+                    }
+                    if (same) makeConstant(instr, program.values[program.operand(value, 0)].bits);
+                    break;
+                }
+
+                case IROp::BINARY: {
+                    IRValue left = program.operand(value, 0);
+                    IRValue right = program.operand(value, 1);
+                    Value result;
+                    if (isConstant(program, left) && isConstant(program, right) &&
+                        evaluateBinary(program, instr.op, constantValue(program, left), constantValue(program, right),
+                                       result)) {
+                        makeConstant(instr, result.ref);
+                    }
+                    break;
+                }
+
+                case IROp::CONVERT:
+                    if (isConstant(program, program.operand(value, 0))) {
+                        Value result = evaluateConversion(program, instr.op,
+                                                          constantValue(program, program.operand(value, 0)));
+                        makeConstant(instr, result.ref);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+void propagateCopies(IRProgram& program) {
+    auto source = [&program](IRValue value) {
+        while (program.values[value].kind == IROp::COPY) {
+            value = program.operand(value, 0);
+        }
+        return value;
+    };
+
+    for (IRBlock& block : program.blocks) {
+        for (IRValue value : block.instructions) {
+            IRInstruction& instr = program.values[value];
+            if (instr.kind == IROp::COPY) {
+                IRInstruction& copied = program.values[source(value)];
+                if (copied.variable == NO_VARIABLE) copied.variable = instr.variable;
+                continue;
+            }
+            for (uint32_t i = 0; i < instr.operandCount; i++) {
+                program.operand(value, i) = source(program.operand(value, i));
+            }
+        }
+    }
+}
+
+void foldOutput(IRProgram& program) {
+    for (IRBlock& block : program.blocks) {
+        IRValue first = NO_VALUE;  // write the current run is merged into
+        uint32_t merged = 0;
+        std::string text;
+
+        auto finishRun = [&]() {
+            if (first != NO_VALUE && (merged > 1 || program.values[first].kind != IROp::WRITE_TEXT)) {
+                IRInstruction& instr = program.values[first];
+                instr.kind = IROp::WRITE_TEXT;
+                instr.op = Op::WRITE_TEXT;
+                instr.operandCount = 0;
+                instr.bits = program.addString(text);
+                if (text.empty()) program.remove(first);
+            }
+            first = NO_VALUE;
+            merged = 0;
+            text.clear();
+        };
+
+        for (IRValue value : block.instructions) {
+            if (program.values[value].kind == IROp::NOP) continue;
+            if (appendOutput(program, value, text)) {
+                if (first == NO_VALUE) {
+                    first = value;
+                } else {
+                    program.remove(value);
+                }
+                merged++;
+            } else if (program.hasSideEffects(value)) {
+                finishRun();
+            }
+        }
+        finishRun();
+    }
+}
+
+void eliminateDeadStores(IRProgram& program) {
+    std::vector<uint32_t> uses = program.countUses();
+    std::vector<IRValue> worklist;
+
+    for (const IRBlock& block : program.blocks) {
+        for (IRValue value : block.instructions) {
+            const IRInstruction& instr = program.values[value];
+            if (instr.kind == IROp::NOP || program.hasSideEffects(value)) continue;
+            bool neverRead = instr.kind == IROp::COPY && !program.variables[instr.variable].read;
+            if (neverRead || uses[value] == 0) worklist.push_back(value);
+        }
+    }
+
+    // Removing an instruction can leave its operands unused in turn
+    while (!worklist.empty()) {
+        IRValue value = worklist.back();
+        worklist.pop_back();
+        if (program.values[value].kind == IROp::NOP) continue;
+
+        for (uint32_t i = 0; i < program.values[value].operandCount; i++) {
+            IRValue operand = program.operand(value, i);
+            if (--uses[operand] == 0 && !program.hasSideEffects(operand)) {
+                worklist.push_back(operand);
+            }
+        }
+        program.remove(value);
+    }
+}
+
+void PassManager::addStandardPipeline() {
+    add("constant-folding", foldConstants);
+    add("copy-propagation", propagateCopies);
+    add("output-folding", foldOutput);
+    add("dead-store-elimination", eliminateDeadStores);
+}
+
+void PassManager::run(IRProgram& program) {
+    using Clock = std::chrono::steady_clock;
+    for (const Entry& pass : passes) {
+        size_t before = program.instructionCount();
+        Clock::time_point start = Clock::now();
+        pass.run(program);
+        program.compact();
+        double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        statistics.push_back(PassStatistics{pass.name, milliseconds, before, program.instructionCount()});
+    }
+}
+
+void PassManager::record(std::string name, double milliseconds, size_t before, size_t after) {
+    statistics.push_back(PassStatistics{std::move(name), milliseconds, before, after});
+}
+
+std::string PassManager::report() const {
+    std::string out = "pass                          time      instructions\n";
+    char line[160];
+    for (const PassStatistics& pass : statistics) {
+        std::snprintf(line, sizeof(line), "%-24s %9.3f ms %10zu -> %zu\n", pass.name.c_str(), pass.milliseconds,
+                      pass.instructionsBefore, pass.instructionsAfter);
+        out += line;
+    }
+    return out;
+}
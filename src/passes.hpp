@@ -0,0 +1,66 @@
+#pragma once
+#include "ir.hpp"
+#include <string>
+#include <vector>
+
+// Optimization passes over IRProgram. Each rewrites the program in place
+// and leaves it in valid SSA form; removed instructions become NOPs.
+
+// Evaluates instructions whose operands are all constants, with the VM's
+// semantics (wrapping ints, the division rules, float formatting), and
+// turns copies of constants into constants so they propagate into every
+// use of the variable. Divisions by a constant zero are left to fail at
+// run time.
+void foldConstants(IRProgram& program);
+
+// Points every use of a COPY at the copied value. The value takes over the
+// variable's name if it had none.
+void propagateCopies(IRProgram& program);
+
+// Replaces writes whose output is known at compile time (text, newlines,
+// constants, arrays of constants) with text, and merges each run of them
+// into a single WRITE_TEXT. A run only ends at output that has to be
+// produced at run time or at a division that may fail, so everything
+// printed before a runtime error still is.
+void foldOutput(IRProgram& program);
+
+// Removes stores to variables that are never read (known from the semantic
+// analyzer) or whose every use was propagated away, then everything that
+// was only computed for them. Side effects always stay.
+void eliminateDeadStores(IRProgram& program);
+
+struct PassStatistics {
+    std::string name;
+    double milliseconds;
+    size_t instructionsBefore;
+    size_t instructionsAfter;
+};
+
+// Runs passes in the order they were added and records how long each took
+// and how many instructions it left
+class PassManager {
+private:
+    struct Entry {
+        const char* name;
+        void (*run)(IRProgram& program);
+    };
+
+    std::vector<Entry> passes;
+    std::vector<PassStatistics> statistics;
+
+public:
+    void add(const char* name, void (*run)(IRProgram& program)) { passes.push_back(Entry{name, run}); }
+
+    // Constant folding, copy propagation, output folding and dead-store
+    // elimination
+    void addStandardPipeline();
+
+    void run(IRProgram& program);
+
+    // Steps outside the manager (lowering, bytecode generation) can be
+    // reported next to the passes
+    void record(std::string name, double milliseconds, size_t before, size_t after);
+
+    const std::vector<PassStatistics>& getStatistics() const { return statistics; }
+    std::string report() const;
+};
@@ -0,0 +1,209 @@
+#include "scan.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define AW_SCAN_SIMD 1
+#include <immintrin.h>
+#define AW_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+// Each matcher flags the bytes that end a run. The SIMD variants return one
+// bit per byte of the block (bit i set = byte i ends the run).
+
+struct WhitespaceEnd {
+    bool scalar(unsigned char c) const {
+        return !(c == ' ' || (c >= '\t' && c <= '\r'));
+    }
+#ifdef AW_SCAN_SIMD
+    unsigned sse2(__m128i v) const {
+        __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        __m128i control = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                        _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+        return ~(unsigned)_mm_movemask_epi8(_mm_or_si128(space, control)) & 0xFFFFu;
+    }
+    AW_AVX2 unsigned avx2(__m256i v) const {
+        __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+        return ~(unsigned)_mm256_movemask_epi8(_mm256_or_si256(space, control));
+    }
+#endif
+};
+
+struct IdentifierEnd {
+    bool scalar(unsigned char c) const {
+        return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_');
+    }
+#ifdef AW_SCAN_SIMD
+    // Signed byte compares are fine here: every byte >= 0x80 is negative and
+    // therefore outside all of the ASCII ranges, just like with std::isalnum.
+    static __m128i inRange(__m128i v, char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+    }
+    AW_AVX2 static __m256i inRange(__m256i v, char lo, char hi) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+    }
+    unsigned sse2(__m128i v) const {
+        // Folding case with |0x20 maps 'A'-'Z' onto 'a'-'z'
+        __m128i letter = inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i word = _mm_or_si128(_mm_or_si128(letter, inRange(v, '0', '9')),
+                                    _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        return ~(unsigned)_mm_movemask_epi8(word) & 0xFFFFu;
+    }
+    AW_AVX2 unsigned avx2(__m256i v) const {
+        __m256i letter = inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i word = _mm256_or_si256(_mm256_or_si256(letter, inRange(v, '0', '9')),
+                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        return ~(unsigned)_mm256_movemask_epi8(word);
+    }
+#endif
+};
+
+struct TerminatorEnd {
+    char terminator;
+
+    bool scalar(unsigned char c) const {
+        return c == (unsigned char)terminator || c == '\0';
+    }
+#ifdef AW_SCAN_SIMD
+    unsigned sse2(__m128i v) const {
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(terminator)),
+                                   _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        return (unsigned)_mm_movemask_epi8(hit);
+    }
+    AW_AVX2 unsigned avx2(__m256i v) const {
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(terminator)),
+                                      _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        return (unsigned)_mm256_movemask_epi8(hit);
+    }
+#endif
+};
+
+struct LineEnd {
+    bool scalar(unsigned char c) const {
+        return c == '\n' || c == '\r' || c == '\0';
+    }
+#ifdef AW_SCAN_SIMD
+    unsigned sse2(__m128i v) const {
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+                                   _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        return (unsigned)_mm_movemask_epi8(hit);
+    }
+    AW_AVX2 unsigned avx2(__m256i v) const {
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+                                      _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        return (unsigned)_mm256_movemask_epi8(hit);
+    }
+#endif
+};
+
+template <typename Matcher>
+size_t scanScalar(const Matcher& matcher, const char* data, size_t pos, size_t end) {
+    while (pos < end && !matcher.scalar((unsigned char)data[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+#ifdef AW_SCAN_SIMD
+bool cpuHasAvx2() {
+    static const bool hasAvx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return hasAvx2;
+}
+
+template <typename Matcher>
+size_t scanSse2(const Matcher& matcher, const char* data, size_t pos, size_t end) {
+    while (pos + 16 <= end) {
+        unsigned stops = matcher.sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos)));
+        if (stops) return pos + __builtin_ctz(stops);
+        pos += 16;
+    }
+    return scanScalar(matcher, data, pos, end);
+}
+
+template <typename Matcher>
+AW_AVX2 size_t scanAvx2(const Matcher& matcher, const char* data, size_t pos, size_t end) {
+    while (pos + 32 <= end) {
+        unsigned stops = matcher.avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos)));
+        if (stops) return pos + __builtin_ctz(stops);
+        pos += 32;
+    }
+    return scanSse2(matcher, data, pos, end);
+}
+#endif
+
+template <typename Matcher>
+size_t scan(const Matcher& matcher, const char* data, size_t pos, size_t end) {
+#ifdef AW_SCAN_SIMD
+    // Most runs in real code are a handful of bytes; settle those without
+    // paying for a vector load
+    for (size_t stop = pos + 4 < end ? pos + 4 : end; pos < stop; pos++) {
+        if (matcher.scalar((unsigned char)data[pos])) return pos;
+    }
+    if (cpuHasAvx2()) return scanAvx2(matcher, data, pos, end);
+    return scanSse2(matcher, data, pos, end);
+#else
+    return scanScalar(matcher, data, pos, end);
+#endif
+}
+
+#ifdef AW_SCAN_SIMD
+void pushLineStarts(unsigned newlines, size_t pos, std::vector<uint32_t>& starts) {
+    while (newlines) {
+        starts.push_back((uint32_t)(pos + __builtin_ctz(newlines) + 1));
+        newlines &= newlines - 1;
+    }
+}
+
+AW_AVX2 size_t collectLineStartsAvx2(const char* data, size_t pos, size_t end, std::vector<uint32_t>& starts) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (pos + 32 <= end) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        pushLineStarts((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)), pos, starts);
+        pos += 32;
+    }
+    return pos;
+}
+#endif
+
+} // namespace
+
+size_t Scan::skipWhitespace(const char* data, size_t pos, size_t end) {
+    return scan(WhitespaceEnd{}, data, pos, end);
+}
+
+size_t Scan::skipIdentifier(const char* data, size_t pos, size_t end) {
+    return scan(IdentifierEnd{}, data, pos, end);
+}
+
+size_t Scan::findTerminator(const char* data, size_t pos, size_t end, char terminator) {
+    return scan(TerminatorEnd{terminator}, data, pos, end);
+}
+
+size_t Scan::findLineEnd(const char* data, size_t pos, size_t end) {
+    return scan(LineEnd{}, data, pos, end);
+}
+
+void Scan::collectLineStarts(const char* data, size_t pos, size_t end, std::vector<uint32_t>& starts) {
+#ifdef AW_SCAN_SIMD
+    if (cpuHasAvx2()) {
+        pos = collectLineStartsAvx2(data, pos, end, starts);
+    }
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (pos + 16 <= end) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        pushLineStarts((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)), pos, starts);
+        pos += 16;
+    }
+#endif
+    for (; pos < end; pos++) {
+        if (data[pos] == '\n') starts.push_back((uint32_t)(pos + 1));
+    }
+}
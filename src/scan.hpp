@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vectorized byte scanners used by the lexer. Each function looks at
+// data[pos, end) and returns the index of the first byte that ends the run,
+// or `end` if the run reaches it. On x86-64 they test 32 bytes per step with
+// AVX2 when the CPU supports it (checked once at runtime) and 16 with SSE2
+// otherwise; other targets use a plain byte loop.
+namespace Scan {
+    // First byte that is not ASCII whitespace (same set as std::isspace in the C locale)
+    size_t skipWhitespace(const char* data, size_t pos, size_t end);
+
+    // First byte that is not [A-Za-z0-9_]
+    size_t skipIdentifier(const char* data, size_t pos, size_t end);
+
+    // First occurrence of `terminator` or of a NUL byte
+    size_t findTerminator(const char* data, size_t pos, size_t end, char terminator);
+
+    // First '\n', '\r' or NUL byte
+    size_t findLineEnd(const char* data, size_t pos, size_t end);
+
+    // Appends i + 1 to `starts` for every '\n' at index i in data[pos, end)
+    void collectLineStarts(const char* data, size_t pos, size_t end, std::vector<uint32_t>& starts);
+}
@@ -1,11 +1,16 @@
 #include "semantic.hpp"
 
-bool SemanticAnalyzer::analyzeProgram(const ProgramNode *program) {
+bool SemanticAnalyzer::analyzeProgram(const FlatAST &program, ErrorHandler& diagnostics) {
   bool success = true;
+  ast = &program;
+  errors = &diagnostics;
+  symbolTable.assign(ast->symbols->size(), VariableInfo());
+  declarationOrder.clear();
+  nodeTypes.assign(ast->nodeCount(), ValueType::UNKNOWN_TYPE);
 
   // Analyze all statements
-  for (const auto &stmt : program->statements) {
-    if (!analyzeStatement(stmt.get())) {
+  for (size_t i = 0; i < ast->listSize(ast->root); i++) {
+    if (!analyzeStatement(ast->listItem(ast->root, i))) {
       success = false;
     }
   }
@@ -16,86 +21,80 @@ bool SemanticAnalyzer::analyzeProgram(const ProgramNode *program) {
   return success;
 }
 
-bool SemanticAnalyzer::analyzeStatement(const ASTNode *stmt) {
-  switch (stmt->type) {
+bool SemanticAnalyzer::analyzeStatement(NodeId stmt) {
+  uint32_t offset = ast->offsets[stmt];
+
+  switch (ast->kind(stmt)) {
   case ASTNodeType::VARIABLE_DECLARATION: {
-    const VariableDeclarationNode *varDecl =
-        static_cast<const VariableDeclarationNode *>(stmt);
+    SymbolId varName = ast->symbol(stmt);
 
     // Check if variable already exists
-    if (isVariableDeclared(varDecl->varName)) {
-      g_errorHandler.addSemanticError(
-          "Variable '" + varDecl->varName + "' is already declared", stmt->line,
-          stmt->column,
+    if (isVariableDeclared(varName)) {
+      errors->addSemanticError(
+          "Variable '" + std::string(ast->name(stmt)) + "' is already declared", offset,
           "Use a different variable name or remove the duplicate declaration");
       return false;
     }
 
     // Analyze the value expression
-    ValueType valueType = analyzeExpression(varDecl->value.get());
-    ValueType declaredType = tokenToValueType(varDecl->varType);
+    ValueType valueType = analyzeExpression(ast->b[stmt]);
+    ValueType declaredType = tokenToValueType((Token)ast->c[stmt]);
 
     // Check type compatibility
     if (valueType != ValueType::UNKNOWN_TYPE &&
         declaredType != ValueType::UNKNOWN_TYPE && valueType != declaredType) {
-      g_errorHandler.addSemanticError(
+      errors->addSemanticError(
           "Type mismatch: cannot assign " + valueTypeToString(valueType) +
               " to variable of type " + valueTypeToString(declaredType),
-          stmt->line, stmt->column,
+          offset,
           "Change the variable type or provide a value of the correct type");
       return false;
     }
 
     // Declare the variable
-    declareVariable(varDecl->varName, declaredType, false, stmt->line, stmt->column);
+    declareVariable(varName, declaredType, false, offset);
     return true;
   }
 
-  case ASTNodeType::STDOUT_STATEMENT: {
-    const StdoutStatementNode *stdoutStmt =
-        static_cast<const StdoutStatementNode *>(stmt);
-    return analyzeExpression(stdoutStmt->content.get()) !=
-           ValueType::UNKNOWN_TYPE;
-  }
+  case ASTNodeType::STDOUT_STATEMENT:
+    return analyzeExpression(ast->a[stmt]) != ValueType::UNKNOWN_TYPE;
 
   case ASTNodeType::ARRAY_DECLARATION: {
-    const ArrayDeclarationNode *arrayDecl =
-        static_cast<const ArrayDeclarationNode *>(stmt);
-
-    if (isVariableDeclared(arrayDecl->varName)) {
-      g_errorHandler.addSemanticError(
-          "Array '" + arrayDecl->varName + "' is already declared", stmt->line,
-          stmt->column, "Use a different array name");
+    SymbolId varName = ast->symbol(stmt);
+    const FlatArrayDecl &arrayDecl = ast->arrays[ast->c[stmt]];
+    NodeId initializer = ast->b[stmt];
+
+    if (isVariableDeclared(varName)) {
+      errors->addSemanticError(
+          "Array '" + std::string(ast->name(stmt)) + "' is already declared", offset,
+          "Use a different array name");
       return false;
     }
 
     ValueType elementType = ValueType::UNKNOWN_TYPE;
-    if (arrayDecl->hasType) {
-      elementType = tokenToValueType(arrayDecl->elementType);
+    if (arrayDecl.hasType) {
+      elementType = tokenToValueType(arrayDecl.elementType);
     }
 
     // If array has initializer, check element types and infer type if needed
-    if (arrayDecl->initializer) {
-      ValueType initType = analyzeExpression(arrayDecl->initializer.get());
+    if (initializer != NO_NODE) {
+      ValueType initType = analyzeExpression(initializer);
       if (initType != ValueType::ARRAY_TYPE) {
-        g_errorHandler.addSemanticError(
-            "Array initializer must be an array literal", stmt->line,
-            stmt->column,
+        errors->addSemanticError(
+            "Array initializer must be an array literal", offset,
             "Use [element1, element2, ...] syntax for array initialization");
         return false;
       }
       
       // Infer element type from first element if no explicit type provided
       if (elementType == ValueType::UNKNOWN_TYPE) {
-        const ArrayLiteralNode *arrayLit = static_cast<const ArrayLiteralNode *>(arrayDecl->initializer.get());
-        if (!arrayLit->elements.empty()) {
-          elementType = analyzeExpression(arrayLit->elements[0].get());
+        if (ast->listSize(initializer) > 0) {
+          elementType = analyzeExpression(ast->listItem(initializer, 0));
         }
       }
     }
 
-    declareVariable(arrayDecl->varName, elementType, true, stmt->line,
-                    stmt->column);
+    declareVariable(varName, elementType, true, offset);
     return true;
   }
 
@@ -104,8 +103,48 @@ bool SemanticAnalyzer::analyzeStatement(const ASTNode *stmt) {
   }
 }
 
-ValueType SemanticAnalyzer::analyzeExpression(const ASTNode *expr) {
-  switch (expr->type) {
+// Binary operator chains can be arbitrarily deep (a + b + ... is a left
+// spine), so they are walked in post-order with an explicit stack; every
+// other node is handled by analyzeOperand.
+ValueType SemanticAnalyzer::analyzeExpression(NodeId expr) {
+  if (ast->kind(expr) != ASTNodeType::BINARY_OPERATION) {
+    return recordType(expr, analyzeOperand(expr));
+  }
+
+  size_t walkBase = walkStack.size();
+  size_t typeBase = typeStack.size();
+  walkStack.push_back(PendingExpression{expr, false});
+
+  while (walkStack.size() > walkBase) {
+    PendingExpression &top = walkStack.back();
+    NodeId node = top.node;
+
+    if (ast->kind(node) != ASTNodeType::BINARY_OPERATION) {
+      walkStack.pop_back();
+      typeStack.push_back(recordType(node, analyzeOperand(node)));
+    } else if (!top.childrenDone) {
+      // Left is pushed last so it is analyzed first
+      top.childrenDone = true;
+      walkStack.push_back(PendingExpression{ast->b[node], false});
+      walkStack.push_back(PendingExpression{ast->a[node], false});
+    } else {
+      walkStack.pop_back();
+      ValueType rightType = typeStack.back();
+      typeStack.pop_back();
+      ValueType leftType = typeStack.back();
+      typeStack.back() = recordType(node, binaryResultType(node, leftType, rightType));
+    }
+  }
+
+  ValueType result = typeStack.back();
+  typeStack.resize(typeBase);
+  return result;
+}
+
+ValueType SemanticAnalyzer::analyzeOperand(NodeId expr) {
+  uint32_t offset = ast->offsets[expr];
+
+  switch (ast->kind(expr)) {
   case ASTNodeType::LITERAL_INT:
     return ValueType::INT_TYPE;
   case ASTNodeType::LITERAL_FLOAT:
@@ -116,99 +155,23 @@ ValueType SemanticAnalyzer::analyzeExpression(const ASTNode *expr) {
     return ValueType::BOOL_TYPE;
 
   case ASTNodeType::IDENTIFIER: {
-    const IdentifierNode *id = static_cast<const IdentifierNode *>(expr);
-    if (!isVariableDeclared(id->name)) {
-      g_errorHandler.addSemanticError("Undefined variable '" + id->name + "'",
-                                      expr->line, expr->column,
-                                      "Declare the variable before using it");
+    SymbolId name = ast->symbol(expr);
+    if (!isVariableDeclared(name)) {
+      errors->addSemanticError("Undefined variable '" + std::string(ast->name(expr)) + "'",
+                               offset,
+                               "Declare the variable before using it");
       return ValueType::UNKNOWN_TYPE;
     }
 
     // Mark variable as used
-    markVariableUsed(id->name);
-    return getVariableType(id->name);
-  }
-
-  case ASTNodeType::BINARY_OPERATION: {
-    const BinaryOperationNode *binOp =
-        static_cast<const BinaryOperationNode *>(expr);
-    ValueType leftType = analyzeExpression(binOp->left.get());
-    ValueType rightType = analyzeExpression(binOp->right.get());
-
-    // Type checking for arithmetic operations
-    if (binOp->op == ADD || binOp->op == SUB || binOp->op == MUL ||
-        binOp->op == DIV) {
-      // String concatenation with +
-      if (binOp->op == ADD && (leftType == ValueType::STRING_TYPE ||
-                               rightType == ValueType::STRING_TYPE)) {
-        return ValueType::STRING_TYPE;
-      }
-
-      // Arithmetic operations on strings (except +) are invalid
-      if (leftType == ValueType::STRING_TYPE ||
-          rightType == ValueType::STRING_TYPE) {
-        g_errorHandler.addSemanticError(
-            "Cannot perform arithmetic operations on strings", expr->line,
-            expr->column, "Use string concatenation (+) or convert to numbers");
-        return ValueType::UNKNOWN_TYPE;
-      }
-
-      // Type promotion: if either operand is float, result is float
-      if (leftType == ValueType::FLOAT_TYPE ||
-          rightType == ValueType::FLOAT_TYPE) {
-        return ValueType::FLOAT_TYPE;
-      }
-
-      // Both are integers
-      if (leftType == ValueType::INT_TYPE && rightType == ValueType::INT_TYPE) {
-        return ValueType::INT_TYPE;
-      }
-
-      // Type mismatch
-      g_errorHandler.addSemanticError(
-          "Type mismatch in arithmetic operation: " +
-              valueTypeToString(leftType) + " and " +
-              valueTypeToString(rightType),
-          expr->line, expr->column, "Ensure both operands are numbers");
-      return ValueType::UNKNOWN_TYPE;
-    }
-
-    // Comparison operations
-    if (binOp->op == EQUAL || binOp->op == NOT_EQUAL || binOp->op == GREATER ||
-        binOp->op == LESSER || binOp->op == GREATER_EQUAL ||
-        binOp->op == LESSER_EQUAL) {
-
-      // Can compare same types
-      if (leftType == rightType) {
-        return ValueType::BOOL_TYPE;
-      }
-
-      // Can compare int and float
-      if ((leftType == ValueType::INT_TYPE &&
-           rightType == ValueType::FLOAT_TYPE) ||
-          (leftType == ValueType::FLOAT_TYPE &&
-           rightType == ValueType::INT_TYPE)) {
-        return ValueType::BOOL_TYPE;
-      }
-
-      g_errorHandler.addSemanticError(
-          "Cannot compare " + valueTypeToString(leftType) + " with " +
-              valueTypeToString(rightType),
-          expr->line, expr->column,
-          "Ensure both operands are of compatible types");
-      return ValueType::UNKNOWN_TYPE;
-    }
-
-    return leftType; // Default return
+    markVariableUsed(name);
+    return getVariableType(name);
   }
 
   case ASTNodeType::STRING_INTERPOLATION: {
-    const StringInterpolationNode *strInterp =
-        static_cast<const StringInterpolationNode *>(expr);
-
     // Check all interpolated expressions
-    for (const auto &subExpr : strInterp->expressions) {
-      ValueType exprType = analyzeExpression(subExpr.get());
+    for (size_t i = 0; i < ast->listSize(expr); i++) {
+      ValueType exprType = analyzeExpression(ast->interpolationExpression(expr, i));
       if (exprType == ValueType::UNKNOWN_TYPE) {
         return ValueType::UNKNOWN_TYPE;
       }
@@ -218,20 +181,17 @@ ValueType SemanticAnalyzer::analyzeExpression(const ASTNode *expr) {
   }
 
   case ASTNodeType::ARRAY_LITERAL: {
-    const ArrayLiteralNode *arrayLit =
-        static_cast<const ArrayLiteralNode *>(expr);
-
-    if (arrayLit->elements.empty()) {
+    if (ast->listSize(expr) == 0) {
       return ValueType::ARRAY_TYPE;
     }
 
     // Check that all elements have the same type
-    ValueType firstElementType = analyzeExpression(arrayLit->elements[0].get());
-    for (size_t i = 1; i < arrayLit->elements.size(); i++) {
-      ValueType elementType = analyzeExpression(arrayLit->elements[i].get());
+    ValueType firstElementType = analyzeExpression(ast->listItem(expr, 0));
+    for (size_t i = 1; i < ast->listSize(expr); i++) {
+      ValueType elementType = analyzeExpression(ast->listItem(expr, i));
       if (elementType != firstElementType) {
-        g_errorHandler.addSemanticError(
-            "Array elements must have the same type", expr->line, expr->column,
+        errors->addSemanticError(
+            "Array elements must have the same type", offset,
             "Ensure all array elements are of type " +
                 valueTypeToString(firstElementType));
         return ValueType::UNKNOWN_TYPE;
@@ -246,21 +206,95 @@ ValueType SemanticAnalyzer::analyzeExpression(const ASTNode *expr) {
   }
 }
 
-void SemanticAnalyzer::declareVariable(const std::string &name, ValueType type,
-                                       bool isArray, int line, int col) {
-  symbolTable.emplace(name, VariableInfo(type, isArray, line, col));
+ValueType SemanticAnalyzer::binaryResultType(NodeId expr, ValueType leftType,
+                                           ValueType rightType) {
+  uint32_t offset = ast->offsets[expr];
+  Token op = (Token)ast->c[expr];
+
+  // Type checking for arithmetic operations
+  if (op == ADD || op == SUB || op == MUL ||
+      op == DIV || op == MOD) {
+    // String concatenation with +
+    if (op == ADD && (leftType == ValueType::STRING_TYPE ||
+                             rightType == ValueType::STRING_TYPE)) {
+      return ValueType::STRING_TYPE;
+    }
+
+    // Arithmetic operations on strings (except +) are invalid
+    if (leftType == ValueType::STRING_TYPE ||
+        rightType == ValueType::STRING_TYPE) {
+      errors->addSemanticError(
+          "Cannot perform arithmetic operations on strings", offset,
+          "Use string concatenation (+) or convert to numbers");
+      return ValueType::UNKNOWN_TYPE;
+    }
+
+    // Type promotion: if either operand is float, result is float
+    if (leftType == ValueType::FLOAT_TYPE ||
+        rightType == ValueType::FLOAT_TYPE) {
+      return ValueType::FLOAT_TYPE;
+    }
+
+    // Both are integers
+    if (leftType == ValueType::INT_TYPE && rightType == ValueType::INT_TYPE) {
+      return ValueType::INT_TYPE;
+    }
+
+    // Type mismatch
+    errors->addSemanticError(
+        "Type mismatch in arithmetic operation: " +
+            valueTypeToString(leftType) + " and " +
+            valueTypeToString(rightType),
+        offset, "Ensure both operands are numbers");
+    return ValueType::UNKNOWN_TYPE;
+  }
+
+  // Comparison operations
+  if (op == EQUAL || op == NOT_EQUAL || op == GREATER ||
+      op == LESSER || op == GREATER_EQUAL ||
+      op == LESSER_EQUAL) {
+
+    // Can compare same types
+    if (leftType == rightType) {
+      return ValueType::BOOL_TYPE;
+    }
+
+    // Can compare int and float
+    if ((leftType == ValueType::INT_TYPE &&
+         rightType == ValueType::FLOAT_TYPE) ||
+        (leftType == ValueType::FLOAT_TYPE &&
+         rightType == ValueType::INT_TYPE)) {
+      return ValueType::BOOL_TYPE;
+    }
+
+    errors->addSemanticError(
+        "Cannot compare " + valueTypeToString(leftType) + " with " +
+            valueTypeToString(rightType),
+        offset,
+        "Ensure both operands are of compatible types");
+    return ValueType::UNKNOWN_TYPE;
+  }
+
+  return leftType; // Default return
 }
 
-bool SemanticAnalyzer::isVariableDeclared(const std::string &name) {
-  return symbolTable.find(name) != symbolTable.end();
+void SemanticAnalyzer::declareVariable(SymbolId name, ValueType type,
+                                       bool isArray, uint32_t offset) {
+  VariableInfo &info = symbolTable[name];
+  info.type = type;
+  info.isArray = isArray;
+  info.declared = true;
+  info.offset = offset;
+  declarationOrder.push_back(name);
 }
 
-ValueType SemanticAnalyzer::getVariableType(const std::string &name) {
-  auto it = symbolTable.find(name);
-  if (it != symbolTable.end()) {
-    return it->second.type;
-  }
-  return ValueType::UNKNOWN_TYPE;
+bool SemanticAnalyzer::isVariableDeclared(SymbolId name) {
+  return symbolTable[name].declared;
+}
+
+ValueType SemanticAnalyzer::getVariableType(SymbolId name) {
+  const VariableInfo &info = symbolTable[name];
+  return info.declared ? info.type : ValueType::UNKNOWN_TYPE;
 }
 
 ValueType SemanticAnalyzer::tokenToValueType(Token token) {
@@ -296,20 +330,19 @@ std::string SemanticAnalyzer::valueTypeToString(ValueType type) {
     return "unknown";
   }
 }
-void SemanticAnalyzer::markVariableUsed(const std::string &name) {
-  usedVariables[name] = true;
+void SemanticAnalyzer::markVariableUsed(SymbolId name) {
+  symbolTable[name].used = true;
 }
 
 void SemanticAnalyzer::checkUnusedVariables() {
-  for (const auto &var : symbolTable) {
-    const std::string &varName = var.first;
-    const VariableInfo &info = var.second;
+  for (SymbolId name : declarationOrder) {
+    const VariableInfo &info = symbolTable[name];
 
     // Check if variable was never used
-    if (usedVariables.find(varName) == usedVariables.end()) {
-      g_errorHandler.addError(
-          ErrorType::WARNING, "Unused variable '" + varName + "'", info.line,
-          info.column, "Remove this variable or use it in your code");
+    if (!info.used) {
+      errors->addError(
+          ErrorType::WARNING, "Unused variable '" + std::string(ast->symbols->name(name)) + "'", info.offset,
+          "Remove this variable or use it in your code");
     }
   }
 }
@@ -1,7 +1,8 @@
 #pragma once
-#include "ast.hpp"
-#include <unordered_map>
+#include "error.hpp"
+#include "flat_ast.hpp"
 #include <string>
+#include <vector>
 
 enum class ValueType {
     STRING_TYPE,
@@ -15,30 +16,52 @@ enum class ValueType {
 struct VariableInfo {
     ValueType type;
     bool isArray;
-    int line;
-    int column;
+    bool declared;
+    bool used;
+    uint32_t offset;  // source byte offset of the declaration
     
-    VariableInfo(ValueType t, bool arr, int l, int c) 
-        : type(t), isArray(arr), line(l), column(c) {}
+    VariableInfo() 
+        : type(ValueType::UNKNOWN_TYPE), isArray(false), declared(false), used(false), offset(0) {}
+};
+
+// Node waiting on the explicit stack of SemanticAnalyzer::analyzeExpression
+struct PendingExpression {
+    NodeId node;
+    bool childrenDone;
 };
 
 class SemanticAnalyzer {
 private:
-    std::unordered_map<std::string, VariableInfo> symbolTable;
-    std::unordered_map<std::string, bool> usedVariables; // Track variable usage
+    const FlatAST* ast = nullptr;  // program being analyzed
+    ErrorHandler* errors = nullptr;  // where the program's diagnostics go
+    std::vector<VariableInfo> symbolTable;   // indexed by SymbolId
+    std::vector<SymbolId> declarationOrder;  // for reporting in source order
+    std::vector<ValueType> nodeTypes;        // type of every analyzed expression, by NodeId
+    
+    // Scratch stacks for walking binary operator chains
+    std::vector<PendingExpression> walkStack;
+    std::vector<ValueType> typeStack;
     
     void checkUnusedVariables();
     bool isCompatibleType(ValueType from, ValueType to);
+    ValueType analyzeOperand(NodeId expr);
+    ValueType binaryResultType(NodeId expr, ValueType leftType, ValueType rightType);
+    ValueType recordType(NodeId expr, ValueType type) { nodeTypes[expr] = type; return type; }
     
 public:
-    bool analyzeProgram(const ProgramNode* program);
-    bool analyzeStatement(const ASTNode* stmt);
-    ValueType analyzeExpression(const ASTNode* expr);
+    bool analyzeProgram(const FlatAST& program, ErrorHandler& diagnostics);
+    bool analyzeStatement(NodeId stmt);
+    ValueType analyzeExpression(NodeId expr);
+    
+    void declareVariable(SymbolId name, ValueType type, bool isArray, uint32_t offset);
+    void markVariableUsed(SymbolId name);
+    bool isVariableDeclared(SymbolId name);
+    ValueType getVariableType(SymbolId name);
     
-    void declareVariable(const std::string& name, ValueType type, bool isArray, int line, int col);
-    void markVariableUsed(const std::string& name);
-    bool isVariableDeclared(const std::string& name);
-    ValueType getVariableType(const std::string& name);
+    // Results for the backends, valid after analyzeProgram succeeded
+    const VariableInfo& getVariableInfo(SymbolId name) const { return symbolTable[name]; }
+    const std::vector<SymbolId>& getDeclarationOrder() const { return declarationOrder; }
+    ValueType getNodeType(NodeId node) const { return nodeTypes[node]; }
     
     static ValueType tokenToValueType(Token token);
     static std::string valueTypeToString(ValueType type);
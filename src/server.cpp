@@ -0,0 +1,582 @@
+#include "server.hpp"
+#include "ast.hpp"
+#include "codegen.hpp"
+#include "flat_ast.hpp"
+#include "ir.hpp"
+#include "parser.hpp"
+#include "passes.hpp"
+#include "semantic.hpp"
+#include "session.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Requests larger than this are refused and their connection closed; a
+// request is buffered only as fast as its bytes arrive, so a client never
+// makes the server reserve more than it actually sent
+constexpr uint32_t MAX_REQUEST = 64u << 20;
+
+// Responses carry IR dumps, which can be several times their source
+constexpr uint32_t MAX_RESPONSE = 1u << 30;
+
+// A worker gives up on a client that stops reading its response for this long
+constexpr int SEND_TIMEOUT_SECONDS = 10;
+
+// A worker's interner is emptied before a request once it holds more names
+// than this, so symbol ids stay dense for the per-symbol tables of the
+// analyzer and the IR builder
+constexpr size_t WARM_SYMBOL_LIMIT = 4096;
+
+// Everything a worker thread reuses from one request to the next: the AST
+// columns' capacity, the names it has interned and the analyzer's, IR
+// builder's and bytecode compiler's tables
+struct Workspace {
+    FlatAST ast;
+    StringInterner symbols;
+    SemanticAnalyzer analyzer;
+    IRBuilder irBuilder;
+    BytecodeCompiler bytecodeCompiler;
+};
+
+thread_local Workspace workspace;
+
+// Messages are built with room for their length in front, filled in once
+// the payload is complete
+void putU32(std::string& message, uint32_t value) {
+    message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putField(std::string& message, std::string_view text) {
+    putU32(message, (uint32_t)text.size());
+    message.append(text);
+}
+
+void sealMessage(std::string& message) {
+    uint32_t size = (uint32_t)(message.size() - sizeof(uint32_t));
+    std::memcpy(message.data(), &size, sizeof(size));
+}
+
+bool readByte(std::string_view message, size_t& position, uint8_t& value) {
+    if (position >= message.size()) return false;
+    value = (uint8_t)message[position++];
+    return true;
+}
+
+bool readField(std::string_view message, size_t& position, std::string& text) {
+    uint32_t size;
+    if (message.size() - position < sizeof(size)) return false;
+    std::memcpy(&size, message.data() + position, sizeof(size));
+    position += sizeof(size);
+    if (message.size() - position < size) return false;
+    text.assign(message.data() + position, size);
+    position += size;
+    return true;
+}
+
+std::string encodeRequest(const CompileRequest& request) {
+    std::string message;
+    putU32(message, 0);
+    message += (char)request.kind;
+    message += (char)((request.optimize ? 0 : 1) | ((uint8_t)request.emit << 1));
+    putField(message, request.name);
+    putField(message, request.text);
+    sealMessage(message);
+    return message;
+}
+
+bool decodeRequest(std::string_view message, CompileRequest& request) {
+    size_t position = 0;
+    uint8_t kind, flags;
+    if (!readByte(message, position, kind) || !readByte(message, position, flags)) return false;
+    if (kind != CompileRequest::PATH && kind != CompileRequest::SOURCE && kind != CompileRequest::STOP) return false;
+    if ((flags >> 1) > (uint8_t)EmitKind::BYTECODE) return false;
+    request.kind = (CompileRequest::Kind)kind;
+    request.optimize = (flags & 1) == 0;
+    request.emit = (EmitKind)(flags >> 1);
+    return readField(message, position, request.name) && readField(message, position, request.text);
+}
+
+std::string encodeResponse(const CompileResponse& response) {
+    std::string message;
+    message.reserve(response.diagnostics.size() + response.output.size() + 16);
+    putU32(message, 0);
+    message += (char)response.status;
+    putField(message, response.diagnostics);
+    putField(message, response.output);
+    sealMessage(message);
+    return message;
+}
+
+bool decodeResponse(std::string_view message, CompileResponse& response) {
+    size_t position = 0;
+    return readByte(message, position, response.status) && readField(message, position, response.diagnostics) &&
+           readField(message, position, response.output);
+}
+
+// Runs the front end and the passes like `main.exe <file>` does, without
+// writing anything; false if the program has errors
+bool compileSession(CompilationSession& session, const CompileRequest& request, std::string& output) {
+    ErrorHandler& errors = session.errors();
+    std::string_view content = session.content();
+
+    if (workspace.symbols.size() > WARM_SYMBOL_LIMIT) workspace.symbols.clear();
+    workspace.ast.clear();
+
+    Parser parser(content, workspace.symbols, errors);
+    FlatAST& flatAst = workspace.ast;
+    ASTParser::parseProgram(parser, flatAst);
+    if (errors.hasAnyErrors()) return false;
+
+    SemanticAnalyzer& analyzer = workspace.analyzer;
+    if (!analyzer.analyzeProgram(flatAst, errors) || errors.hasAnyErrors()) return false;
+
+    IRProgram ir;
+    if (!workspace.irBuilder.buildProgram(flatAst, analyzer, ir, errors) || errors.hasAnyErrors()) return false;
+
+    PassManager passes;
+    if (request.optimize) passes.addStandardPipeline();
+    passes.run(ir);
+
+    Bytecode bytecode;
+    workspace.bytecodeCompiler.compileProgram(ir, bytecode);
+
+    switch (request.emit) {
+        case EmitKind::LEXER:
+            for (const TokenData& token : LexerEngine::tokenize(content)) {
+                output += LexerEngine::tokenTypeToString(token.type);
+                output += ' ';
+                output += LexerEngine::tokenText(token, content);
+                output += '\n';
+            }
+            break;
+        case EmitKind::AST: output = flatAst.toString(flatAst.root, 0); break;
+        case EmitKind::SSA: output = ir.toString(); break;
+        case EmitKind::BYTECODE: output = bytecode.toString(); break;
+        case EmitKind::NONE: break;
+    }
+    return true;
+}
+
+// Unlike the command line, which only shows warnings next to errors, the
+// server always returns them: editors want them for files that compile too
+void compileRequest(const CompileRequest& request, CompileResponse& response) {
+    response = CompileResponse();
+    CompilationSession session;
+    if (request.kind == CompileRequest::SOURCE) {
+        session.openText(request.name, request.text);
+    } else if (!session.open(request.text, request.name)) {
+        response.status = 1;
+        response.diagnostics = "\033[31m\033[1merror\033[0m: could not read `" + request.name + "`\n";
+        return;
+    }
+
+    bool compiled = compileSession(session, request, response.output);
+    response.status = compiled ? 0 : 1;
+    if (session.errors().hasAnyErrors() || session.errors().hasAnyWarnings()) {
+        std::ostringstream diagnostics;
+        session.errors().printErrors(diagnostics);
+        response.diagnostics = diagnostics.str();
+    } else if (!compiled) {
+        response.diagnostics = "\033[31m\033[1m✗ Compilation of `" + request.name + "` failed!\033[0m\n";
+    }
+}
+
+#ifndef _WIN32
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+bool sendAll(int fd, const std::string& data) {
+    const char* cursor = data.data();
+    size_t remaining = data.size();
+    while (remaining > 0) {
+        ssize_t sent = ::send(fd, cursor, remaining, SEND_FLAGS);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        cursor += sent;
+        remaining -= (size_t)sent;
+    }
+    return true;
+}
+
+bool receiveAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t received = ::recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        data += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+
+bool receiveMessage(int fd, std::string& message) {
+    uint32_t size;
+    if (!receiveAll(fd, reinterpret_cast<char*>(&size), sizeof(size)) || size > MAX_RESPONSE) return false;
+    message.resize(size);
+    return receiveAll(fd, message.data(), size);
+}
+
+// A client connection on the server, with the bytes of its next request
+// received so far
+struct Connection {
+    int fd;
+    std::string pending;
+};
+
+// Appends whatever the peer has sent so far to `pending`, without waiting
+// for more. False once the peer has closed the connection or it failed.
+bool receiveAvailable(int fd, std::string& pending) {
+    char chunk[16 * 1024];
+    while (pending.size() < sizeof(uint32_t) + MAX_REQUEST) {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (received > 0) {
+            pending.append(chunk, (size_t)received);
+        } else if (received < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    return true;
+}
+
+// Takes the first request off `pending` once all of it has arrived.
+// Returns 1 if it did, 0 if more bytes are needed and -1 if they cannot be
+// a request.
+int takeRequest(std::string& pending, CompileRequest& request) {
+    uint32_t size;
+    if (pending.size() < sizeof(size)) return 0;
+    std::memcpy(&size, pending.data(), sizeof(size));
+    if (size > MAX_REQUEST) return -1;
+    if (pending.size() - sizeof(size) < size) return 0;
+    bool valid = decodeRequest(std::string_view(pending).substr(sizeof(size), size), request);
+    pending.erase(0, sizeof(size) + size);
+    return valid ? 1 : -1;
+}
+
+// The user on the other end of a connected Unix socket
+bool peerUser(int fd, uid_t& user) {
+#ifdef SO_PEERCRED
+    ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) return false;
+    user = credentials.uid;
+    return true;
+#else
+    gid_t group;
+    return getpeereid(fd, &user, &group) == 0;
+#endif
+}
+
+bool isOwnPeer(int fd) {
+    uid_t user;
+    return peerUser(fd, user) && user == getuid();
+}
+
+// A socket file that another user created could be anyone's server
+bool isOwnSocket(const std::string& path) {
+    struct stat info;
+    return lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode) && info.st_uid == getuid();
+}
+
+// The directory of the default socket when there is no $XDG_RUNTIME_DIR:
+// it must be ours and closed to everyone else, and is created that way
+bool ensurePrivateDirectory(const std::string& directory) {
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) return false;
+    struct stat info;
+    return lstat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode) && info.st_uid == getuid() &&
+           (info.st_mode & 077) == 0;
+}
+
+bool socketAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.data(), path.size());
+    return true;
+}
+
+int connectTo(const std::string& path) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#endif
+
+} // namespace
+
+std::string defaultSocketPath() {
+#ifndef _WIN32
+    const char* runtimeDirectory = std::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDirectory && *runtimeDirectory) return std::string(runtimeDirectory) + "/awlang.sock";
+    return "/tmp/awlang-" + std::to_string(getuid()) + "/awlang.sock";
+#else
+    return "awlang.sock";
+#endif
+}
+
+bool CompileServer::serve() {
+#ifndef _WIN32
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        std::cerr << "error: socket path `" << socketPath << "` is too long" << std::endl;
+        return false;
+    }
+
+    if (socketPath == defaultSocketPath() && !std::getenv("XDG_RUNTIME_DIR")) {
+        std::string directory = socketPath.substr(0, socketPath.find_last_of('/'));
+        if (!ensurePrivateDirectory(directory)) {
+            std::cerr << "error: `" << directory << "` is not a private directory of this user" << std::endl;
+            return false;
+        }
+    }
+
+    // A socket file nobody answers on was left behind by a server that did
+    // not shut down; one that answers belongs to a running server
+    int existing = connectTo(socketPath);
+    if (existing >= 0) {
+        close(existing);
+        std::cerr << "error: a compile server is already listening on `" << socketPath << "`" << std::endl;
+        return false;
+    }
+    if (isOwnSocket(socketPath)) unlink(socketPath.c_str());
+
+    // Only this user may connect: the socket is created without group or
+    // other permissions, and every peer's uid is checked on accept
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    int wakePipe[2] = {-1, -1};
+    mode_t previousMask = umask(077);
+    bool bound = listener >= 0 && bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    umask(previousMask);
+    if (!bound || listen(listener, 128) != 0 || pipe(wakePipe) != 0) {
+        std::cerr << "error: could not listen on `" << socketPath << "`: " << std::strerror(errno) << std::endl;
+        if (listener >= 0) close(listener);
+        return false;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "Listening on " << socketPath << std::endl;
+
+    // Connections waiting for their next request are polled here, and the
+    // request is read on this thread as its bytes arrive. Only a complete
+    // request goes to a worker, which answers it and hands the connection
+    // back through `returned`, so neither idle nor slow clients hold a worker.
+    std::vector<Connection> idle;
+    std::vector<Connection> returned;
+    std::mutex returnedMutex;
+    std::atomic<bool> stopping{false};
+    std::vector<pollfd> polled;
+
+    {
+        ThreadPool pool(threadCount);
+        auto handOver = [&](Connection connection, CompileRequest request) {
+            pool.submit([&, connection, request]() mutable {
+                CompileResponse response;
+                if (request.kind == CompileRequest::STOP) {
+                    stopping = true;
+                } else {
+                    compileRequest(request, response);
+                }
+                if (!sendAll(connection.fd, encodeResponse(response))) {
+                    close(connection.fd);
+                } else {
+                    std::lock_guard<std::mutex> lock(returnedMutex);
+                    returned.push_back(std::move(connection));
+                }
+                char wake = 0;
+                while (write(wakePipe[1], &wake, 1) < 0 && errno == EINTR) {}
+            });
+        };
+
+        // Starts on the connection's next request if all of it is buffered,
+        // or waits for more; a malformed request closes the connection
+        auto dispatch = [&](Connection& connection) {
+            CompileRequest request;
+            int taken = takeRequest(connection.pending, request);
+            if (taken > 0) {
+                handOver(std::move(connection), std::move(request));
+            } else if (taken < 0) {
+                close(connection.fd);
+            } else {
+                idle.push_back(std::move(connection));
+            }
+        };
+
+        while (!stopping) {
+            polled.clear();
+            polled.push_back(pollfd{listener, POLLIN, 0});
+            polled.push_back(pollfd{wakePipe[0], POLLIN, 0});
+            for (const Connection& connection : idle) polled.push_back(pollfd{connection.fd, POLLIN, 0});
+            if (poll(polled.data(), polled.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            std::vector<Connection> waiting;
+            waiting.swap(idle);
+            for (size_t i = 0; i < waiting.size(); i++) {
+                Connection& connection = waiting[i];
+                if (!polled[i + 2].revents) {
+                    idle.push_back(std::move(connection));
+                } else if (!receiveAvailable(connection.fd, connection.pending)) {
+                    close(connection.fd);
+                } else {
+                    dispatch(connection);
+                }
+            }
+            if (polled[1].revents) {
+                char drained[64];
+                (void)!read(wakePipe[0], drained, sizeof(drained));
+                std::vector<Connection> answered;
+                {
+                    std::lock_guard<std::mutex> lock(returnedMutex);
+                    answered.swap(returned);
+                }
+                // A client may have sent its next request before the answer
+                for (Connection& connection : answered) dispatch(connection);
+            }
+            if (polled[0].revents) {
+                int client = accept(listener, nullptr, nullptr);
+                if (client >= 0 && !isOwnPeer(client)) {
+                    close(client);
+                } else if (client >= 0) {
+                    timeval timeout{SEND_TIMEOUT_SECONDS, 0};
+                    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                    idle.push_back(Connection{client, std::string()});
+                }
+            }
+        }
+    }
+
+    for (const Connection& connection : idle) close(connection.fd);
+    for (const Connection& connection : returned) close(connection.fd);
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    close(listener);
+    unlink(socketPath.c_str());
+    return true;
+#else
+    std::cerr << "error: the compile server needs Unix domain sockets" << std::endl;
+    return false;
+#endif
+}
+
+CompileClient::~CompileClient() {
+#ifndef _WIN32
+    if (fd >= 0) close(fd);
+#endif
+}
+
+bool CompileClient::connect(const std::string& socketPath) {
+#ifndef _WIN32
+    // Sources go only to a server run by the same user
+    if (!isOwnSocket(socketPath)) return false;
+    fd = connectTo(socketPath);
+    if (fd >= 0 && !isOwnPeer(fd)) {
+        close(fd);
+        fd = -1;
+    }
+    return fd >= 0;
+#else
+    (void)socketPath;
+    return false;
+#endif
+}
+
+bool CompileClient::send(const CompileRequest& request, CompileResponse& response) {
+#ifndef _WIN32
+    std::string message;
+    return fd >= 0 && sendAll(fd, encodeRequest(request)) && receiveMessage(fd, message) &&
+           decodeResponse(message, response);
+#else
+    (void)request;
+    (void)response;
+    return false;
+#endif
+}
+
+bool benchmarkServer(const std::string& socketPath, const CompileRequest& request, size_t total,
+                     size_t connections) {
+    using Clock = std::chrono::steady_clock;
+    connections = std::max<size_t>(1, std::min(connections, total));
+    std::vector<std::vector<double>> latencies(connections);
+    std::atomic<bool> failed{false};
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < connections; c++) {
+        threads.emplace_back([&, c] {
+            CompileClient client;
+            if (!client.connect(socketPath)) {
+                failed = true;
+                return;
+            }
+            size_t count = total / connections + (c < total % connections ? 1 : 0);
+            latencies[c].reserve(count);
+            CompileResponse response;
+            for (size_t i = 0; i < count; i++) {
+                Clock::time_point sent = Clock::now();
+                if (!client.send(request, response)) {
+                    failed = true;
+                    return;
+                }
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent).count());
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (failed) {
+        std::cerr << "error: could not reach a compile server on `" << socketPath << "`" << std::endl;
+        return false;
+    }
+
+    std::vector<double> all;
+    for (const auto& list : latencies) all.insert(all.end(), list.begin(), list.end());
+    std::sort(all.begin(), all.end());
+    // Nearest-rank percentiles
+    auto percentile = [&all](double p) {
+        size_t rank = (size_t)std::max(1.0, std::ceil(p * all.size()));
+        return all[std::min(rank, all.size()) - 1];
+    };
+    std::cout << std::fixed << std::setprecision(3) << all.size() << " requests over " << connections
+              << " connections: p50 " << percentile(0.50) << " ms, p99 " << percentile(0.99) << " ms, max "
+              << all.back() << " ms, " << std::setprecision(0) << all.size() / seconds << " requests/s"
+              << std::endl;
+    return true;
+}
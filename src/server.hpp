@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Compile server: a long-running process that checks sources sent to it
+// over a Unix domain socket, so editors and build tools don't pay process
+// startup and cold allocations on every file. Connections are served on a
+// ThreadPool; each worker keeps its AST columns and identifier interner warm
+// from one request to the next. A connection can carry any number of
+// requests, one after the other. Requests are read on the polling thread
+// as their bytes arrive and only complete ones reach a worker, so a client
+// that goes quiet mid-request never holds one. The socket is closed to
+// other users, and both ends check that the peer runs as the same user.
+//
+// Every message is a 32-bit length followed by that many bytes. A request
+// is a kind byte, a flags byte, then the file name and the path or source
+// text, each as a 32-bit length and bytes. A response is the exit status
+// byte, then the diagnostics and the output, each as a 32-bit length and
+// bytes. Integers are in host byte order; both ends are on one machine.
+
+// What the server produces besides diagnostics: the text of one IR file
+enum class EmitKind : uint8_t {
+    NONE,
+    LEXER,
+    AST,
+    SSA,
+    BYTECODE
+};
+
+struct CompileRequest {
+    enum Kind : uint8_t {
+        PATH = 'P',    // the server reads `text` as a file path
+        SOURCE = 'S',  // `text` is the source itself
+        STOP = 'Q'     // shut the server down once running requests finish
+    };
+
+    Kind kind = PATH;
+    bool optimize = true;
+    EmitKind emit = EmitKind::NONE;
+    std::string name;  // shown in diagnostics
+    std::string text;
+};
+
+struct CompileResponse {
+    uint8_t status = 0;       // what `main.exe` would have exited with
+    std::string diagnostics;  // errors and warnings as printed to stderr
+    std::string output;       // the requested IR
+};
+
+// $XDG_RUNTIME_DIR/awlang.sock, or awlang.sock in the private directory
+// /tmp/awlang-<uid>, which the server creates with mode 0700
+std::string defaultSocketPath();
+
+class CompileServer {
+private:
+    std::string socketPath;
+    size_t threadCount;
+
+public:
+    CompileServer(std::string path, size_t threads) : socketPath(std::move(path)), threadCount(threads) {}
+
+    // Listens until a STOP request arrives; returns false if the socket
+    // could not be set up
+    bool serve();
+};
+
+// One connection to a server. Requests on it are answered in order.
+class CompileClient {
+private:
+    int fd = -1;
+
+public:
+    CompileClient() = default;
+    ~CompileClient();
+
+    CompileClient(const CompileClient&) = delete;
+    CompileClient& operator=(const CompileClient&) = delete;
+
+    // Fails unless the socket file and the server belong to this user
+    bool connect(const std::string& socketPath);
+    bool send(const CompileRequest& request, CompileResponse& response);
+};
+
+// Load generator: sends `total` copies of `request` over `connections`
+// concurrent connections and prints the latency percentiles and throughput.
+// Returns false if the server could not be reached.
+bool benchmarkServer(const std::string& socketPath, const CompileRequest& request, size_t total,
+                     size_t connections);
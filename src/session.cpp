@@ -0,0 +1,39 @@
+#include "session.hpp"
+
+namespace {
+
+// Past MAX_SOURCE_SIZE offsets would wrap and point at the wrong text, so
+// such a source is compiled as empty and the error explains why
+void limitSize(std::string_view& contents, ErrorHandler& diagnostics, const std::string& filename) {
+    size_t size = contents.size();
+    if (size <= CompilationSession::MAX_SOURCE_SIZE) {
+        diagnostics.setSourceContent(contents, filename);
+        return;
+    }
+    contents = std::string_view();
+    diagnostics.setSourceContent(contents, filename);
+    diagnostics.addLexicalError("source is " + std::to_string(size) +
+                                    " bytes, more than the 4 GiB the compiler can address",
+                                0, "Split the program into smaller files");
+}
+
+} // namespace
+
+bool CompilationSession::open(const std::string& path, const std::string& name) {
+    filename = name.empty() ? path : name;
+    text.clear();
+    contents = std::string_view();
+    diagnostics.clear();
+    if (!source.open(path.c_str())) return false;
+    contents = source.view();
+    limitSize(contents, diagnostics, filename);
+    return true;
+}
+
+void CompilationSession::openText(const std::string& name, std::string sourceText) {
+    filename = name;
+    text = std::move(sourceText);
+    contents = text;
+    diagnostics.clear();
+    limitSize(contents, diagnostics, filename);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "error.hpp"
+#include "source.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// One compilation of one source file: its text, its name and the
+// diagnostics reported against it. Every stage gets the session, or just
+// its ErrorHandler, passed in, so compilations share nothing and any number
+// of them can run at once on different threads of one process. Reporting a
+// diagnostic is a plain append to the session's own list, with no locks:
+// a session is only ever used by the thread compiling it. A driver checking
+// many files merges their reports afterwards in its own order.
+class CompilationSession {
+public:
+    // Tokens and diagnostics hold 32-bit offsets into the source
+    static constexpr size_t MAX_SOURCE_SIZE = UINT32_MAX;
+
+private:
+    std::string filename;
+    SourceBuffer source;  // backs every token and diagnostic
+    std::string text;     // or this, for source handed over in memory
+    std::string_view contents;
+    ErrorHandler diagnostics;
+
+public:
+    // Reads the file and points the diagnostics at it, naming it `name` in
+    // messages (the path itself when empty). Returns false if the file could
+    // not be read. A source over MAX_SOURCE_SIZE is replaced by an empty one
+    // with an error reported against it.
+    bool open(const std::string& path, const std::string& name = "");
+
+    // Compiles `sourceText` as if it had been read from a file called `name`
+    void openText(const std::string& name, std::string sourceText);
+
+    const std::string& getFilename() const { return filename; }
+    std::string_view content() const { return contents; }
+
+    ErrorHandler& errors() { return diagnostics; }
+    const ErrorHandler& errors() const { return diagnostics; }
+};
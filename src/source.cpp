@@ -0,0 +1,88 @@
+#include "source.hpp"
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SourceBuffer::~SourceBuffer() {
+    close();
+}
+
+bool SourceBuffer::open(const char* filename) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // Only a regular file's size can be trusted: pipes, FIFOs and /proc
+    // files report 0 however much they hold. mmap refuses zero-length
+    // mappings, so an empty file is just an empty view.
+    if (S_ISREG(st.st_mode) && st.st_size == 0) {
+        ::close(fd);
+        data = "";
+        length = 0;
+        return true;
+    }
+    if (S_ISREG(st.st_mode)) {
+        void* region = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (region != MAP_FAILED) {
+            madvise(region, (size_t)st.st_size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(region);
+            length = (size_t)st.st_size;
+            mapped = true;
+            ::close(fd);
+            return true;
+        }
+    }
+
+    // Fallback: read until end of input into owned storage
+    char chunk[64 * 1024];
+    for (;;) {
+        ssize_t received = ::read(fd, chunk, sizeof(chunk));
+        if (received > 0) {
+            fallback.append(chunk, (size_t)received);
+        } else if (received == 0) {
+            break;
+        } else if (errno != EINTR) {
+            ::close(fd);
+            fallback.clear();
+            return false;
+        }
+    }
+    ::close(fd);
+#else
+    // Fallback: read the whole file once into owned storage
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) return false;
+    fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+#endif
+
+    data = fallback.data();
+    length = fallback.size();
+    return true;
+}
+
+void SourceBuffer::close() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<char*>(data), length);
+    }
+#endif
+    fallback.clear();
+    data = nullptr;
+    length = 0;
+    mapped = false;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Read-only contents of a source file, kept alive for the whole compilation.
+// Tokens and diagnostics hold views into this buffer instead of copies, so it
+// must outlive everything produced from it.
+class SourceBuffer {
+private:
+    const char* data;
+    size_t length;
+    bool mapped;             // true when `data` is an mmap'd region
+    std::string fallback;    // backing storage when mapping is not possible
+
+public:
+    SourceBuffer() : data(nullptr), length(0), mapped(false) {}
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    // Maps a regular file read-only; pipes and other special files, and
+    // every file on platforms without mmap, are read to the end instead.
+    // Returns false if the file could not be opened or read.
+    bool open(const char* filename);
+    void close();
+
+    std::string_view view() const { return std::string_view(data, length); }
+    size_t size() const { return length; }
+};
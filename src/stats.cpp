@@ -0,0 +1,166 @@
+#include "stats.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Set once, before any thread exists, and only read afterwards
+bool allocationCounting = false;
+
+struct AllocationCounter {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+thread_local AllocationCounter threadAllocations = {0, 0};
+
+double threadCpuMilliseconds() {
+#ifndef _WIN32
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+#else
+    return std::clock() * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+long peakResidentKb() {
+#ifndef _WIN32
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes there, kilobytes on Linux
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+void appendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+// The standard array and nothrow forms all come through here
+void* operator new(std::size_t size) {
+    if (allocationCounting) {
+        threadAllocations.allocations++;
+        threadAllocations.bytes += size;
+    }
+    if (size == 0) size = 1;
+    for (;;) {
+        if (void* memory = std::malloc(size)) return memory;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void CompileStatistics::countAllocations() {
+    allocationCounting = true;
+}
+
+void CompileStatistics::start(const char* name) {
+    phaseName = name;
+    peakStart = peakResidentKb();
+    allocationsStart = threadAllocations.allocations;
+    bytesStart = threadAllocations.bytes;
+    cpuStart = threadCpuMilliseconds();
+    wallStart = Clock::now();
+}
+
+void CompileStatistics::finish(std::initializer_list<std::pair<const char*, uint64_t>> counts) {
+    double wall = std::chrono::duration<double, std::milli>(Clock::now() - wallStart).count();
+    double cpu = threadCpuMilliseconds() - cpuStart;
+    if (!phaseName) return;
+    phases.push_back(PhaseStatistics{phaseName, wall, cpu, peakResidentKb() - peakStart,
+                                     threadAllocations.allocations - allocationsStart,
+                                     threadAllocations.bytes - bytesStart, counts});
+    phaseName = nullptr;
+}
+
+std::string CompileStatistics::report() const {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-12s %8s    %7s    %11s %9s %11s  %s\n", "phase", "wall", "cpu", "peak rss",
+                  "allocs", "alloc KiB", "items");
+    std::string out = line;
+    PhaseStatistics total{"total", 0, 0, 0, 0, 0, {}};
+    auto append = [&](const PhaseStatistics& phase) {
+        std::snprintf(line, sizeof(line), "%-12s %8.3f ms %7.3f ms %+7ld KiB %9llu %11.1f", phase.name.c_str(),
+                      phase.wallMilliseconds, phase.cpuMilliseconds, phase.peakResidentGrowthKb,
+                      (unsigned long long)phase.allocations, phase.allocatedBytes / 1024.0);
+        out += line;
+        for (size_t i = 0; i < phase.counts.size(); i++) {
+            std::snprintf(line, sizeof(line), "%s%s=%llu", i == 0 ? "  " : " ", phase.counts[i].first,
+                          (unsigned long long)phase.counts[i].second);
+            out += line;
+        }
+        out += '\n';
+    };
+    for (const PhaseStatistics& phase : phases) {
+        append(phase);
+        total.wallMilliseconds += phase.wallMilliseconds;
+        total.cpuMilliseconds += phase.cpuMilliseconds;
+        total.peakResidentGrowthKb += phase.peakResidentGrowthKb;
+        total.allocations += phase.allocations;
+        total.allocatedBytes += phase.allocatedBytes;
+    }
+    append(total);
+    return out;
+}
+
+std::string CompileStatistics::json(std::string_view file) const {
+    std::string out = "{\"file\":";
+    appendJsonString(out, file);
+    out += ",\"phases\":[";
+    char number[160];
+    for (size_t i = 0; i < phases.size(); i++) {
+        const PhaseStatistics& phase = phases[i];
+        if (i > 0) out += ',';
+        out += "{\"name\":";
+        appendJsonString(out, phase.name);
+        std::snprintf(number, sizeof(number),
+                      ",\"wall_ms\":%.6f,\"cpu_ms\":%.6f,\"peak_rss_growth_kb\":%ld,\"allocations\":%llu,"
+                      "\"allocated_bytes\":%llu,\"counts\":{",
+                      phase.wallMilliseconds, phase.cpuMilliseconds, phase.peakResidentGrowthKb,
+                      (unsigned long long)phase.allocations, (unsigned long long)phase.allocatedBytes);
+        out += number;
+        for (size_t j = 0; j < phase.counts.size(); j++) {
+            if (j > 0) out += ',';
+            appendJsonString(out, phase.counts[j].first);
+            out += ':' + std::to_string(phase.counts[j].second);
+        }
+        out += "}}";
+    }
+    out += "]}\n";
+    return out;
+}
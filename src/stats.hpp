@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct PhaseStatistics {
+    std::string name;
+    double wallMilliseconds;
+    double cpuMilliseconds;      // of the compiling thread
+    long peakResidentGrowthKb;   // how far the process's peak RSS rose
+    uint64_t allocations;        // operator new calls on the compiling thread
+    uint64_t allocatedBytes;
+    std::vector<std::pair<const char*, uint64_t>> counts;
+};
+
+// Per-phase measurements of one compilation for --stats. A disabled
+// instance does nothing but test a flag in begin() and end(), and the
+// allocation counter in operator new is a single untaken branch unless
+// countAllocations() was called. Phases run one after another on the
+// thread that created the instance. The peak RSS is the whole process's,
+// so with several files compiling at once it is only a rough guide.
+class CompileStatistics {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool enabled;
+    std::vector<PhaseStatistics> phases;
+
+    // Readings when the current phase began
+    const char* phaseName = nullptr;
+    Clock::time_point wallStart;
+    double cpuStart = 0;
+    long peakStart = 0;
+    uint64_t allocationsStart = 0;
+    uint64_t bytesStart = 0;
+
+    void start(const char* name);
+    void finish(std::initializer_list<std::pair<const char*, uint64_t>> counts);
+
+public:
+    explicit CompileStatistics(bool enable) : enabled(enable) {}
+
+    bool isEnabled() const { return enabled; }
+
+    // Brackets one phase; `counts` are the items it produced (tokens,
+    // nodes, ...). A phase left without end() is not reported.
+    void begin(const char* name) {
+        if (enabled) start(name);
+    }
+    void end(std::initializer_list<std::pair<const char*, uint64_t>> counts = {}) {
+        if (enabled) finish(counts);
+    }
+
+    const std::vector<PhaseStatistics>& getPhases() const { return phases; }
+
+    // A table with a total row, or one line of JSON naming `file`
+    std::string report() const;
+    std::string json(std::string_view file) const;
+
+    // Turns on counting in operator new for the rest of the process; call
+    // before starting any threads
+    static void countAllocations();
+};
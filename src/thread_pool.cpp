@@ -0,0 +1,74 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    for (size_t i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    Queue& queue = *queues[nextQueue];
+    nextQueue = (nextQueue + 1) % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::take(size_t worker, std::function<void()>& task) {
+    // Oldest first from our own deque, newest first from everyone else's
+    for (size_t i = 0; i < queues.size(); i++) {
+        Queue& queue = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t worker) {
+    std::function<void()> task;
+    for (;;) {
+        if (take(worker, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        // The count can run ahead of the deques for a moment while a task is
+        // being pushed, in which case this just looks again
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return queued > 0 || stopping; });
+        if (stopping && queued <= 0) return;
+    }
+}
+
+size_t ThreadPool::defaultThreadCount() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads with one task deque each. Submitted tasks
+// are dealt round-robin; a worker takes the oldest task of its own deque
+// and, once that is empty, steals the newest from the others', so tasks
+// start roughly in submission order (nothing queued is starved by a stream
+// of newer work) and a few slow tasks never leave the rest of the pool
+// idle. Destruction waits for every queued task to finish.
+class ThreadPool {
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    size_t nextQueue = 0;
+
+    // Idle workers sleep until a task is queued or the pool stops
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<long> queued{0};
+    bool stopping = false;
+
+    bool take(size_t worker, std::function<void()>& task);
+    void workerLoop(size_t worker);
+
+public:
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    size_t size() const { return threads.size(); }
+
+    // One worker per hardware thread
+    static size_t defaultThreadCount();
+};
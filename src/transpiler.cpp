@@ -0,0 +1,454 @@
+#include "transpiler.hpp"
+#include "error.hpp"
+#include "native.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// Deeper expressions are split into temporaries so the host compiler never
+// sees pathological nesting
+constexpr uint32_t MAX_EXPRESSION_DEPTH = 48;
+
+// Statements per generated function
+constexpr uint32_t PART_SIZE = 256;
+
+const char* cType(ValueType type) {
+    switch (type) {
+        case ValueType::FLOAT_TYPE: return "double";
+        case ValueType::STRING_TYPE: return "aw_string";
+        default: return "int64_t";
+    }
+}
+
+// Body of a C string literal. Octal escapes are always three digits so a
+// following digit cannot extend them, and '?' is escaped against trigraphs.
+std::string escapeC(std::string_view text) {
+    std::string escaped;
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\' || c == '?') {
+            escaped += '\\';
+            escaped += (char)c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else if (c < 32 || c >= 127) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\%03o", c);
+            escaped += buffer;
+        } else {
+            escaped += (char)c;
+        }
+    }
+    return escaped;
+}
+
+std::string intLiteral(int64_t value) {
+    if (value == INT64_MIN) return "(-INT64_C(9223372036854775807) - 1)";
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        return value < 0 ? "(" + std::to_string(value) + ")" : std::to_string(value);
+    }
+    std::string literal = "INT64_C(" + std::to_string(value) + ")";
+    return value < 0 ? "(" + literal + ")" : literal;
+}
+
+// %.17g round-trips every double exactly
+std::string floatLiteral(double value) {
+    if (std::isinf(value)) return value < 0 ? "(-HUGE_VAL)" : "HUGE_VAL";
+    if (std::isnan(value)) return std::signbit(value) ? "(-NAN)" : "NAN";  // printf shows the sign
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    std::string literal = buffer;
+    if (literal.find_first_of(".e") == std::string::npos) literal += ".0";
+    return value < 0 ? "(" + literal + ")" : literal;
+}
+
+// Condition of a comparison opcode, by position in the EQ..GE groups
+const char* const COMPARISONS[] = {"==", "!=", "<", "<=", ">", ">="};
+
+} // namespace
+
+bool CTranspiler::compileProgram(const Bytecode& bytecode, CompilationSession& compilation, std::string& source) {
+    program = &bytecode;
+    session = &compilation;
+    stack.clear();
+    slotTypes.assign(bytecode.slotNames.size(), ValueType::UNKNOWN_TYPE);
+    slotArrays.assign(bytecode.slotNames.size(), UINT32_MAX);
+    arrays.clear();
+    errorMessages.clear();
+    printText.clear();
+    printFormat.clear();
+    printArguments.clear();
+    temporaries = 0;
+    parts = 0;
+    body.clear();
+
+    startPart();
+    if (!lower()) {
+        return false;
+    }
+    body += "}\n";
+
+    source = "/* Generated by the AwLang C backend from " + escapeC(session->getFilename()) + " */\n";
+    source += runtimeSource();
+    source += declarations();
+    source += body;
+    source += "\nint main(void) {\n    setvbuf(stdout, NULL, _IONBF, 0);\n";
+    for (uint32_t i = 0; i < parts; i++) {
+        source += "    aw_part_" + std::to_string(i) + "();\n";
+    }
+    source += "    aw_flush();\n    return 0;\n}\n";
+    body.clear();
+    return true;
+}
+
+void CTranspiler::startPart() {
+    if (parts > 0) {
+        body += "}\n";
+    }
+    body += "\nstatic void aw_part_" + std::to_string(parts++) + "(void) {\n";
+    partStatements = 0;
+}
+
+void CTranspiler::printLiteral(std::string_view text) {
+    printText += text;
+    for (char c : text) {
+        if (c == '%') printFormat += "%%";
+        else if (c == '\0') printFormat += "%0";
+        else printFormat += c;
+    }
+}
+
+void CTranspiler::printValue(const char* code, const std::string& value) {
+    printFormat += code;
+    printArguments += ", " + value;
+}
+
+void CTranspiler::flushPrint() {
+    if (printFormat.empty()) return;
+    if (printArguments.empty()) {
+        body += "    aw_write(\"" + escapeC(printText) + "\", " + std::to_string(printText.size()) + ");\n";
+    } else {
+        body += "    aw_print(\"" + escapeC(printFormat) + "\"" + printArguments + ");\n";
+    }
+    partStatements++;
+    printText.clear();
+    printFormat.clear();
+    printArguments.clear();
+}
+
+// Pending output goes out first, so output and runtime errors keep the
+// order the program has
+void CTranspiler::statement(const std::string& text) {
+    flushPrint();
+    body += "    " + text + "\n";
+    partStatements++;
+}
+
+void CTranspiler::push(std::string text, ValueType type, uint32_t depth) {
+    stack.push_back(CValue{std::move(text), type, depth, UINT32_MAX, -1});
+    if (depth > MAX_EXPRESSION_DEPTH) {
+        stack.back() = temporary(stack.back());
+    }
+}
+
+CTranspiler::CValue CTranspiler::pop() {
+    CValue value = std::move(stack.back());
+    stack.pop_back();
+    return value;
+}
+
+CTranspiler::CValue CTranspiler::temporary(const CValue& value) {
+    std::string name = "t" + std::to_string(temporaries++);
+    statement("const " + std::string(cType(value.type)) + " " + name + " = " + value.text + ";");
+    return CValue{name, value.type, 0, UINT32_MAX, -1};
+}
+
+// `format` holds the operands as %a and %b
+void CTranspiler::binary(const char* format, ValueType type) {
+    CValue right = pop();
+    CValue left = pop();
+    std::string text;
+    for (const char* c = format; *c; c++) {
+        if (c[0] == '%' && c[1] == 'a') {
+            text += left.text;
+            c++;
+        } else if (c[0] == '%' && c[1] == 'b') {
+            text += right.text;
+            c++;
+        } else {
+            text += *c;
+        }
+    }
+    push(std::move(text), type, std::max(left.depth, right.depth) + 1);
+}
+
+void CTranspiler::call(const char* routine, const CValue& argument, ValueType type) {
+    push(std::string(routine) + "(" + argument.text + ")", type, argument.depth + 1);
+}
+
+// Source names are ASCII identifiers, so a prefix keeps them clear of C
+// keywords and the runtime's aw_ names; temporaries (%<n>) become t_<n>
+std::string CTranspiler::variable(uint32_t slot) const {
+    const std::string& name = program->slotNames[slot];
+    if (name[0] == '%') return "t_" + name.substr(1);
+    return "v_" + name;
+}
+
+uint32_t CTranspiler::runtimeError(const std::string& message, uint32_t offset) {
+    SourceLocation where = session->errors().locate(offset);
+    std::string text = "error: " + message + "\n  --> " + session->getFilename() + ":" +
+                       std::to_string(where.line) + ":" + std::to_string(where.column) + "\n";
+    auto it = std::find(errorMessages.begin(), errorMessages.end(), text);
+    if (it != errorMessages.end()) {
+        return (uint32_t)(it - errorMessages.begin());
+    }
+    errorMessages.push_back(text);
+    return (uint32_t)(errorMessages.size() - 1);
+}
+
+// Replays the bytecode's stack effects with C expressions in place of
+// values. Straight-line code uses every pushed value exactly once, so an
+// expression is only named when it has side effects (a checked division)
+// or grows too deep.
+bool CTranspiler::lower() {
+    const std::vector<uint32_t>& code = program->code;
+
+    for (size_t pc = 0; pc < code.size(); pc++) {
+        // Functions only break between statements, where no temporary is live
+        if (partStatements >= PART_SIZE && stack.empty()) {
+            startPart();
+        }
+
+        uint32_t word = code[pc];
+        Op op = Bytecode::opcode(word);
+        uint32_t arg = Bytecode::argument(word);
+
+        switch (op) {
+            case Op::PUSH_INT:
+                push(intLiteral(Bytecode::immediate(word)), ValueType::INT_TYPE, 0);
+                break;
+            case Op::PUSH_CONST: {
+                Value value = program->constants[arg];
+                ValueType type = program->constantTypes[arg];
+                if (type == ValueType::FLOAT_TYPE) {
+                    push(floatLiteral(value.f), type, 0);
+                } else if (type == ValueType::STRING_TYPE) {
+                    push("aw_s" + std::to_string(value.ref), type, 0);
+                    stack.back().literal = (int32_t)value.ref;
+                } else {
+                    push(intLiteral(value.i), type, 0);
+                }
+                break;
+            }
+            case Op::LOAD:
+                if (slotTypes[arg] == ValueType::ARRAY_TYPE) {
+                    push("", ValueType::ARRAY_TYPE, 0);
+                    stack.back().array = slotArrays[arg];
+                } else {
+                    push(variable(arg), slotTypes[arg], 0);
+                }
+                break;
+            case Op::STORE: {
+                CValue value = pop();
+                if (value.type == ValueType::ARRAY_TYPE) {
+                    slotArrays[arg] = value.array;
+                } else {
+                    statement(variable(arg) + " = " + value.text + ";");
+                }
+                slotTypes[arg] = value.type;
+                break;
+            }
+
+            // Int arithmetic wraps around instead of being undefined
+            case Op::ADD_I: binary("aw_add(%a, %b)", ValueType::INT_TYPE); break;
+            case Op::SUB_I: binary("aw_sub(%a, %b)", ValueType::INT_TYPE); break;
+            case Op::MUL_I: binary("aw_mul(%a, %b)", ValueType::INT_TYPE); break;
+            case Op::DIV_I: case Op::MOD_I: {
+                std::string error = "aw_error_" + std::to_string(runtimeError("Division by zero", program->offsets[pc]));
+                binary(((op == Op::DIV_I ? "aw_div(%a, %b, " : "aw_mod(%a, %b, ") + error + ")").c_str(),
+                       ValueType::INT_TYPE);
+                if (stack.back().depth > 0) {
+                    stack.back() = temporary(stack.back());
+                }
+                break;
+            }
+
+            case Op::ADD_F: binary("(%a + %b)", ValueType::FLOAT_TYPE); break;
+            case Op::SUB_F: binary("(%a - %b)", ValueType::FLOAT_TYPE); break;
+            case Op::MUL_F: binary("(%a * %b)", ValueType::FLOAT_TYPE); break;
+            case Op::DIV_F: binary("(%a / %b)", ValueType::FLOAT_TYPE); break;
+            case Op::MOD_F: binary("fmod(%a, %b)", ValueType::FLOAT_TYPE); break;
+
+            case Op::EQ_I: case Op::NE_I: case Op::LT_I: case Op::LE_I: case Op::GT_I: case Op::GE_I:
+            case Op::EQ_F: case Op::NE_F: case Op::LT_F: case Op::LE_F: case Op::GT_F: case Op::GE_F: {
+                int group = (int)op - (op >= Op::EQ_F ? (int)Op::EQ_F : (int)Op::EQ_I);
+                binary((std::string("(%a ") + COMPARISONS[group] + " %b)").c_str(), ValueType::BOOL_TYPE);
+                break;
+            }
+            case Op::EQ_S: case Op::NE_S: case Op::LT_S: case Op::LE_S: case Op::GT_S: case Op::GE_S: {
+                int group = (int)op - (int)Op::EQ_S;
+                binary((std::string("(aw_compare(%a, %b) ") + COMPARISONS[group] + " 0)").c_str(), ValueType::BOOL_TYPE);
+                break;
+            }
+
+            case Op::INT_TO_FLOAT: {
+                CValue value = pop();
+                push("((double)" + value.text + ")", ValueType::FLOAT_TYPE, value.depth + 1);
+                break;
+            }
+            case Op::INT_TO_STRING: call("aw_int_to_string", pop(), ValueType::STRING_TYPE); break;
+            case Op::FLOAT_TO_STRING: call("aw_float_to_string", pop(), ValueType::STRING_TYPE); break;
+            case Op::BOOL_TO_STRING: {
+                CValue value = pop();
+                push("(" + value.text + " ? aw_true : aw_false)", ValueType::STRING_TYPE, value.depth + 1);
+                break;
+            }
+            case Op::CONCAT: binary("aw_concat(%a, %b)", ValueType::STRING_TYPE); break;
+
+            // Each ARRAY_NEW runs once, so its array can be static storage
+            case Op::ARRAY_NEW: case Op::ARRAY_CONST: {
+                CArray array{(ValueType)arg, 0, 0, 0};
+                if (op == Op::ARRAY_CONST) {
+                    array.firstConstant = code[pc + 1];
+                    array.constantCount = code[pc + 2];
+                    array.size = Bytecode::wide(&code[pc + 3]);
+                } else {
+                    array.size = Bytecode::wide(&code[pc + 2]);
+                }
+                uint32_t count = op == Op::ARRAY_NEW ? code[pc + 1] : 0;
+                std::string name = "a" + std::to_string(arrays.size());
+                if (array.lazy()) {
+                    uint32_t error = runtimeError(arrayAllocationError(array.size), program->offsets[pc]);
+                    statement(name + " = aw_array_alloc(" + std::to_string(array.size) + ", sizeof(*" + name + "), " +
+                              (array.constantCount > 0 ? name + "_init" : "NULL") + ", " +
+                              std::to_string(array.constantCount) + ", aw_error_" + std::to_string(error) + ");");
+                }
+                pc += Bytecode::extraWords(op);
+                arrays.push_back(array);
+
+                size_t first = stack.size() - count;
+                for (uint32_t i = 0; i < count; i++) {
+                    statement(name + "[" + std::to_string(i) + "] = " + stack[first + i].text + ";");
+                }
+                stack.resize(first);
+                push("", ValueType::ARRAY_TYPE, 0);
+                stack.back().array = (uint32_t)(arrays.size() - 1);
+                break;
+            }
+
+            case Op::WRITE_TEXT:
+                printLiteral(program->strings[arg]);
+                break;
+            // Literals and comparisons are plain ints in C, and aw_print reads int64_t
+            case Op::WRITE_INT: printValue("%d", "(int64_t)" + pop().text); break;
+            case Op::WRITE_FLOAT: printValue("%f", pop().text); break;
+            case Op::WRITE_BOOL: printValue("%b", "(int64_t)" + pop().text); break;
+            case Op::WRITE_STRING: {
+                CValue value = pop();
+                if (value.literal >= 0) {
+                    printLiteral(program->strings[value.literal]);
+                } else {
+                    printValue("%s", value.text);
+                }
+                break;
+            }
+            case Op::WRITE_ARRAY: {
+                uint32_t index = pop().array;
+                const char* kind = "int";
+                switch (arrays[index].elementType) {
+                    case ValueType::FLOAT_TYPE: kind = "float"; break;
+                    case ValueType::BOOL_TYPE: kind = "bool"; break;
+                    case ValueType::STRING_TYPE: kind = "string"; break;
+                    default: break;
+                }
+                statement(std::string("aw_write_") + kind + "_array(a" + std::to_string(index) + ", " +
+                          std::to_string(arrays[index].size) + ");");
+                break;
+            }
+            case Op::WRITE_NEWLINE:
+                printLiteral("\n");
+                break;
+            case Op::HALT:
+                flushPrint();
+                break;
+
+            default:
+                session->errors().addCodegenError(std::string("C backend cannot lower ") + Bytecode::opName(op),
+                                                  program->offsets[pc]);
+                return false;
+        }
+    }
+    return true;
+}
+
+// Variables, arrays, the string literals the program uses as values, and
+// runtime error messages
+std::string CTranspiler::declarations() const {
+    std::string text;
+    for (size_t slot = 0; slot < slotTypes.size(); slot++) {
+        if (slotTypes[slot] == ValueType::ARRAY_TYPE || slotTypes[slot] == ValueType::UNKNOWN_TYPE) continue;
+        text += "static " + std::string(cType(slotTypes[slot])) + " " + variable((uint32_t)slot) + ";\n";
+    }
+    // Array initializers are written out in place, not through aw_s
+    std::vector<bool> initializer(program->constants.size(), false);
+    for (size_t i = 0; i < arrays.size(); i++) {
+        const CArray& array = arrays[i];
+        std::string type = cType(array.elementType);
+        std::string name = "a" + std::to_string(i);
+        std::fill_n(initializer.begin() + array.firstConstant, array.constantCount, true);
+        if (array.lazy()) {
+            text += "static " + type + "* " + name + ";\n";
+            if (array.constantCount > 0) {
+                text += "static const " + type + " " + name + "_init[] = {" + arrayConstants(array) + "};\n";
+            }
+        } else {
+            text += "static " + type + " " + name + "[" + std::to_string(std::max<uint64_t>(array.size, 1)) + "]";
+            if (array.constantCount > 0) text += " = {" + arrayConstants(array) + "}";
+            text += ";\n";
+        }
+    }
+    std::vector<bool> used(program->strings.size(), false);
+    for (size_t i = 0; i < program->constants.size(); i++) {
+        if (program->constantTypes[i] == ValueType::STRING_TYPE && !initializer[i]) {
+            used[program->constants[i].ref] = true;
+        }
+    }
+    for (size_t i = 0; i < used.size(); i++) {
+        if (!used[i]) continue;
+        std::string_view literal = program->strings[i];
+        text += "static const aw_string aw_s" + std::to_string(i) + " = {\"" + escapeC(literal) + "\", " +
+                std::to_string(literal.size()) + "};\n";
+    }
+    for (size_t i = 0; i < errorMessages.size(); i++) {
+        text += "static const char aw_error_" + std::to_string(i) + "[] = \"" + escapeC(errorMessages[i]) + "\";\n";
+    }
+    return text;
+}
+
+std::string CTranspiler::arrayConstants(const CArray& array) const {
+    std::string text;
+    for (uint32_t i = 0; i < array.constantCount; i++) {
+        Value value = program->constants[array.firstConstant + i];
+        if (i > 0) text += i % 16 == 0 ? ",\n    " : ", ";
+        switch (array.elementType) {
+            case ValueType::FLOAT_TYPE: text += floatLiteral(value.f); break;
+            case ValueType::STRING_TYPE: {
+                std::string_view literal = program->strings[value.ref];
+                text += "{\"" + escapeC(literal) + "\", " + std::to_string(literal.size()) + "}";
+                break;
+            }
+            default: text += intLiteral(value.i); break;
+        }
+    }
+    return text;
+}
+
+bool CTranspiler::compileC(const std::string& sourcePath, const std::string& executablePath) {
+    const char* compiler = std::getenv("CC");
+    if (compiler == nullptr || *compiler == '\0') {
+        compiler = "cc";
+    }
+    return runTool({compiler, "-O2", "-std=c11", "-o", executablePath, sourcePath, "-lm"});
+}
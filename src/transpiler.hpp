@@ -0,0 +1,88 @@
+#pragma once
+#include "codegen.hpp"
+#include "session.hpp"
+#include <string>
+#include <vector>
+
+// C11 backend. Lowers the checked program, through its bytecode like the
+// native backend, to one self-contained translation unit and leaves the
+// optimizing to the host compiler:
+//   - every stack value becomes a C expression, so each statement comes out
+//     as a single expression over named variables
+//   - variables and arrays are file-scope statics and the statements are
+//     split over functions of bounded size, since host compilers slow down
+//     badly on one huge main
+//   - each stdout statement becomes one call with a format string built at
+//     compile time from its text parts and value kinds (plain text becomes
+//     a write with a precomputed length), going through a buffered writer
+//     in the prelude; one call instead of one per part also keeps the host
+//     compiler fast on output-heavy programs
+//   - the output depends only on the program and its file name, so it can
+//     be cached by content
+class CTranspiler {
+private:
+    // A value on the replayed bytecode stack
+    struct CValue {
+        std::string text;  // C expression, parenthesized unless atomic
+        ValueType type;
+        uint32_t depth;    // expression nesting
+        uint32_t array;    // ARRAY_TYPE: index into arrays
+        int32_t literal;   // string literal: index into Bytecode::strings
+    };
+
+    // Static, initialized in place when it starts with constants; lazy
+    // arrays are pointers to calloc'd memory (mmap'd by the C library at
+    // this size) with the constants copied in from a `_init` table
+    struct CArray {
+        ValueType elementType;
+        uint64_t size;
+        uint32_t firstConstant;
+        uint32_t constantCount;
+
+        bool lazy() const { return size >= LAZY_ARRAY_ITEMS; }
+    };
+
+    const Bytecode* program = nullptr;
+    CompilationSession* session = nullptr;  // source name and diagnostics
+
+    std::vector<CValue> stack;
+    std::vector<ValueType> slotTypes;
+    std::vector<uint32_t> slotArrays;
+    std::vector<CArray> arrays;
+    std::vector<std::string> errorMessages;
+    // Output waiting to be written: its raw text, the same as an aw_print
+    // format, and the values for the format
+    std::string printText;
+    std::string printFormat;
+    std::string printArguments;
+    uint32_t temporaries = 0;
+    uint32_t parts = 0;
+    uint32_t partStatements = 0;
+    std::string body;
+
+    bool lower();
+    void statement(const std::string& text);
+    void printLiteral(std::string_view text);
+    void printValue(const char* code, const std::string& value);
+    void flushPrint();
+    void startPart();
+    void push(std::string text, ValueType type, uint32_t depth);
+    CValue pop();
+    CValue temporary(const CValue& value);
+    void binary(const char* format, ValueType type);
+    void call(const char* routine, const CValue& argument, ValueType type);
+    std::string variable(uint32_t slot) const;
+    uint32_t runtimeError(const std::string& message, uint32_t offset);
+    std::string declarations() const;
+    std::string arrayConstants(const CArray& array) const;
+
+public:
+    bool compileProgram(const Bytecode& bytecode, CompilationSession& compilation, std::string& source);
+
+    // Runs the host C compiler ($CC, or `cc`) with -O2 on a generated file
+    static bool compileC(const std::string& sourcePath, const std::string& executablePath);
+
+    // Prelude shared by every generated program: value types, the buffered
+    // writer and the runtime helpers
+    static const char* runtimeSource();
+};
@@ -0,0 +1,194 @@
+#include "transpiler.hpp"
+
+// Prelude of every generated C program. Conventions:
+//   - ints and bools are int64_t (bools 0/1), floats double, strings a
+//     {data, size} pair; a zeroed aw_string is the empty string, which
+//     zero-initialized string arrays rely on
+//   - stdout goes through one 64 KiB buffer (stdio's own buffering is
+//     switched off), flushed on exit and before a runtime error
+//   - strings built at run time are never freed; programs are short-lived
+const char* CTranspiler::runtimeSource() {
+    return R"(#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* data;
+    size_t size;
+} aw_string;
+
+static const aw_string aw_true = {"true", 4};
+static const aw_string aw_false = {"false", 5};
+
+static char aw_out[1 << 16];
+static size_t aw_out_size;
+
+static void aw_flush(void) {
+    if (aw_out_size > 0) fwrite(aw_out, 1, aw_out_size, stdout);
+    aw_out_size = 0;
+}
+
+static void aw_write(const char* data, size_t size) {
+    if (size > sizeof(aw_out) - aw_out_size) {
+        aw_flush();
+        if (size > sizeof(aw_out)) {
+            fwrite(data, 1, size, stdout);
+            return;
+        }
+    }
+    if (size > 0) memcpy(aw_out + aw_out_size, data, size);
+    aw_out_size += size;
+}
+
+static void aw_fail(const char* message) {
+    aw_flush();
+    fputs(message, stderr);
+    exit(1);
+}
+
+/* Big arrays: calloc maps them fresh, so pages never touched are never
+   cleared */
+static void* aw_array_alloc(size_t size, size_t item, const void* items, size_t count, const char* error) {
+    void* memory = calloc(size, item);
+    if (memory == NULL) aw_fail(error);
+    if (count > 0) memcpy(memory, items, count * item);
+    return memory;
+}
+
+static void* aw_alloc(size_t size) {
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL) aw_fail("error: Out of memory\n");
+    return memory;
+}
+
+static inline int64_t aw_add(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }
+static inline int64_t aw_sub(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }
+static inline int64_t aw_mul(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }
+
+static inline int64_t aw_div(int64_t a, int64_t b, const char* error) {
+    if (b == 0) aw_fail(error);
+    return b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b;
+}
+
+static inline int64_t aw_mod(int64_t a, int64_t b, const char* error) {
+    if (b == 0) aw_fail(error);
+    return b == -1 ? 0 : a % b;
+}
+
+/* Digits of value ending at `end`; returns the first character */
+static char* aw_format_int(char* end, int64_t value) {
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    do {
+        *--end = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) *--end = '-';
+    return end;
+}
+
+/* Six decimals like %f, minus trailing zeros; at least one decimal stays */
+static size_t aw_format_float(char* buffer, double value) {
+    int length = snprintf(buffer, 512, "%.6f", value);
+    if (length <= 0) return 0;
+    if (memchr(buffer, '.', (size_t)length) == NULL) return (size_t)length;
+    while (buffer[length - 1] == '0') length--;
+    if (buffer[length - 1] == '.') buffer[length++] = '0';
+    return (size_t)length;
+}
+
+static aw_string aw_copy(const char* data, size_t size) {
+    char* copy = aw_alloc(size);
+    if (size > 0) memcpy(copy, data, size);
+    return (aw_string){copy, size};
+}
+
+static aw_string aw_int_to_string(int64_t value) {
+    char buffer[24];
+    char* start = aw_format_int(buffer + sizeof(buffer), value);
+    return aw_copy(start, (size_t)(buffer + sizeof(buffer) - start));
+}
+
+static aw_string aw_float_to_string(double value) {
+    char buffer[512];
+    return aw_copy(buffer, aw_format_float(buffer, value));
+}
+
+static aw_string aw_concat(aw_string a, aw_string b) {
+    char* data = aw_alloc(a.size + b.size);
+    if (a.size > 0) memcpy(data, a.data, a.size);
+    if (b.size > 0) memcpy(data + a.size, b.data, b.size);
+    return (aw_string){data, a.size + b.size};
+}
+
+static int aw_compare(aw_string a, aw_string b) {
+    size_t common = a.size < b.size ? a.size : b.size;
+    int order = common > 0 ? memcmp(a.data, b.data, common) : 0;
+    if (order != 0) return order;
+    return (a.size > b.size) - (a.size < b.size);
+}
+
+static void aw_write_int(int64_t value) {
+    char buffer[24];
+    char* start = aw_format_int(buffer + sizeof(buffer), value);
+    aw_write(start, (size_t)(buffer + sizeof(buffer) - start));
+}
+
+static void aw_write_float(double value) {
+    char buffer[512];
+    aw_write(buffer, aw_format_float(buffer, value));
+}
+
+static void aw_write_bool(int64_t value) {
+    if (value) aw_write("true", 4);
+    else aw_write("false", 5);
+}
+
+static void aw_write_string(aw_string value) {
+    aw_write(value.data, value.size);
+}
+
+/* Writes `format` with each %d (int64_t), %f (double), %b (bool as int64_t)
+   and %s (aw_string) replaced by the next argument; %% writes a percent
+   sign and %0 a NUL byte */
+static void aw_print(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    for (;;) {
+        const char* mark = strchr(format, '%');
+        if (mark == NULL) {
+            aw_write(format, strlen(format));
+            break;
+        }
+        aw_write(format, (size_t)(mark - format));
+        switch (mark[1]) {
+            case 'd': aw_write_int(va_arg(args, int64_t)); break;
+            case 'f': aw_write_float(va_arg(args, double)); break;
+            case 'b': aw_write_bool(va_arg(args, int64_t)); break;
+            case 's': aw_write_string(va_arg(args, aw_string)); break;
+            case '0': aw_write("", 1); break;
+            default: aw_write("%", 1); break;
+        }
+        format = mark + 2;
+    }
+    va_end(args);
+}
+
+#define AW_WRITE_ARRAY(kind, type) \
+    static void aw_write_##kind##_array(const type* items, size_t size) { \
+        aw_write("[", 1); \
+        for (size_t i = 0; i < size; i++) { \
+            if (i > 0) aw_write(", ", 2); \
+            aw_write_##kind(items[i]); \
+        } \
+        aw_write("]", 1); \
+    }
+AW_WRITE_ARRAY(int, int64_t)
+AW_WRITE_ARRAY(float, double)
+AW_WRITE_ARRAY(bool, int64_t)
+AW_WRITE_ARRAY(string, aw_string)
+
+)";
+}
@@ -0,0 +1,252 @@
+#include "vm.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+void writeElement(OutputBuffer& out, ValueType type, Value value, const std::vector<std::string>& strings) {
+    switch (type) {
+        case ValueType::FLOAT_TYPE: out.writeFloat(value.f); break;
+        case ValueType::BOOL_TYPE: out.writeBool(value.i); break;
+        case ValueType::STRING_TYPE: out.write(strings[value.ref]); break;
+        default: out.writeInt(value.i); break;
+    }
+}
+
+ArrayHeap::~ArrayHeap() {
+    for (auto [memory, bytes] : mappings) {
+#ifdef _WIN32
+        std::free(memory);
+#else
+        munmap(memory, bytes);
+#endif
+    }
+}
+
+uint64_t ArrayHeap::create(ValueType elementType, uint64_t size, const Value* initializers, uint32_t count) {
+    size_t bytes = (size_t)std::max<uint64_t>(size, 1) * sizeof(Value);
+    Value* items;
+    if (size < LAZY_ARRAY_ITEMS) {
+        items = static_cast<Value*>(arena.allocate(bytes, alignof(Value)));
+        std::memset(items + count, 0, (size - count) * sizeof(Value));
+    } else {
+#ifdef _WIN32
+        void* memory = std::calloc(size, sizeof(Value));
+        if (memory == nullptr) return UINT64_MAX;
+#else
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return UINT64_MAX;
+#endif
+        mappings.emplace_back(memory, bytes);
+        items = static_cast<Value*>(memory);
+    }
+    if (count > 0) std::memcpy(items, initializers, count * sizeof(Value));
+    arrays.push_back(ArrayObject{elementType, size, items});
+    return arrays.size() - 1;
+}
+
+namespace {
+
+int compareStrings(const std::vector<std::string>& strings, Value left, Value right) {
+    return strings[left.ref].compare(strings[right.ref]);
+}
+
+// The dispatch loop. Handlers are written once as switch cases that also
+// carry a label; NEXT() fetches the next word and either jumps through the
+// label table (Threaded) or goes back to the switch.
+template <bool Threaded>
+bool execute(const Bytecode& program, RuntimeError& error) {
+#ifdef AW_COMPUTED_GOTO
+    static const void* const labels[] = {
+#define AW_OPCODE_LABEL(name) &&op_##name,
+        AW_OPCODES(AW_OPCODE_LABEL)
+#undef AW_OPCODE_LABEL
+    };
+#define CASE(name) case Op::name: op_##name:
+#define NEXT() do { word = *pc++; if constexpr (Threaded) goto *labels[word & 0xFF]; goto dispatch; } while (0)
+#else
+#define CASE(name) case Op::name:
+#define NEXT() do { word = *pc++; goto dispatch; } while (0)
+#endif
+
+#define ARG() Bytecode::argument(word)
+#define BINARY_I(expr) do { sp[-2].i = (expr); sp--; NEXT(); } while (0)
+#define BINARY_F(expr) do { sp[-2].f = (expr); sp--; NEXT(); } while (0)
+#define COMPARE(expr) do { sp[-2].i = (expr) ? 1 : 0; sp--; NEXT(); } while (0)
+
+    // Heap: string constants first, then strings built at run time
+    std::vector<std::string> strings(program.strings.begin(), program.strings.end());
+    ArrayHeap arrays;
+    uint64_t arraySize = 0;
+    OutputBuffer& out = OutputBuffer::standardOutput();
+
+    std::vector<Value> stack(program.maxStack + 1);
+    std::vector<Value> slots(program.slotNames.size());
+    const Value* constants = program.constants.data();
+    const uint32_t* code = program.code.data();
+    const uint32_t* pc = code;
+    Value* sp = stack.data();
+    uint32_t word;
+
+    NEXT();
+
+dispatch:
+    switch (Bytecode::opcode(word)) {
+        CASE(PUSH_INT) { sp->i = Bytecode::immediate(word); sp++; NEXT(); }
+        CASE(PUSH_CONST) { *sp++ = constants[ARG()]; NEXT(); }
+        CASE(LOAD) { *sp++ = slots[ARG()]; NEXT(); }
+        CASE(STORE) { slots[ARG()] = *--sp; NEXT(); }
+
+        // Int arithmetic wraps around instead of being undefined
+        CASE(ADD_I) { BINARY_I((int64_t)((uint64_t)sp[-2].i + (uint64_t)sp[-1].i)); }
+        CASE(SUB_I) { BINARY_I((int64_t)((uint64_t)sp[-2].i - (uint64_t)sp[-1].i)); }
+        CASE(MUL_I) { BINARY_I((int64_t)((uint64_t)sp[-2].i * (uint64_t)sp[-1].i)); }
+        CASE(DIV_I) {
+            if (sp[-1].i == 0) goto divisionByZero;
+            BINARY_I(sp[-1].i == -1 ? (int64_t)(0 - (uint64_t)sp[-2].i) : sp[-2].i / sp[-1].i);
+        }
+        CASE(MOD_I) {
+            if (sp[-1].i == 0) goto divisionByZero;
+            BINARY_I(sp[-1].i == -1 ? 0 : sp[-2].i % sp[-1].i);
+        }
+
+        CASE(ADD_F) { BINARY_F(sp[-2].f + sp[-1].f); }
+        CASE(SUB_F) { BINARY_F(sp[-2].f - sp[-1].f); }
+        CASE(MUL_F) { BINARY_F(sp[-2].f * sp[-1].f); }
+        CASE(DIV_F) { BINARY_F(sp[-2].f / sp[-1].f); }
+        CASE(MOD_F) { BINARY_F(std::fmod(sp[-2].f, sp[-1].f)); }
+
+        CASE(EQ_I) { COMPARE(sp[-2].i == sp[-1].i); }
+        CASE(NE_I) { COMPARE(sp[-2].i != sp[-1].i); }
+        CASE(LT_I) { COMPARE(sp[-2].i < sp[-1].i); }
+        CASE(LE_I) { COMPARE(sp[-2].i <= sp[-1].i); }
+        CASE(GT_I) { COMPARE(sp[-2].i > sp[-1].i); }
+        CASE(GE_I) { COMPARE(sp[-2].i >= sp[-1].i); }
+
+        CASE(EQ_F) { COMPARE(sp[-2].f == sp[-1].f); }
+        CASE(NE_F) { COMPARE(sp[-2].f != sp[-1].f); }
+        CASE(LT_F) { COMPARE(sp[-2].f < sp[-1].f); }
+        CASE(LE_F) { COMPARE(sp[-2].f <= sp[-1].f); }
+        CASE(GT_F) { COMPARE(sp[-2].f > sp[-1].f); }
+        CASE(GE_F) { COMPARE(sp[-2].f >= sp[-1].f); }
+
+        CASE(EQ_S) { COMPARE(compareStrings(strings, sp[-2], sp[-1]) == 0); }
+        CASE(NE_S) { COMPARE(compareStrings(strings, sp[-2], sp[-1]) != 0); }
+        CASE(LT_S) { COMPARE(compareStrings(strings, sp[-2], sp[-1]) < 0); }
+        CASE(LE_S) { COMPARE(compareStrings(strings, sp[-2], sp[-1]) <= 0); }
+        CASE(GT_S) { COMPARE(compareStrings(strings, sp[-2], sp[-1]) > 0); }
+        CASE(GE_S) { COMPARE(compareStrings(strings, sp[-2], sp[-1]) >= 0); }
+
+        CASE(INT_TO_FLOAT) { sp[-1].f = (double)sp[-1].i; NEXT(); }
+        CASE(INT_TO_STRING) {
+            strings.push_back(std::to_string(sp[-1].i));
+            sp[-1].ref = strings.size() - 1;
+            NEXT();
+        }
+        CASE(FLOAT_TO_STRING) {
+            strings.push_back(formatFloat(sp[-1].f));
+            sp[-1].ref = strings.size() - 1;
+            NEXT();
+        }
+        CASE(BOOL_TO_STRING) {
+            strings.emplace_back(formatBool(sp[-1].i));
+            sp[-1].ref = strings.size() - 1;
+            NEXT();
+        }
+        CASE(CONCAT) {
+            strings.push_back(strings[sp[-2].ref] + strings[sp[-1].ref]);
+            sp[-2].ref = strings.size() - 1;
+            sp--;
+            NEXT();
+        }
+
+        CASE(ARRAY_NEW) {
+            uint32_t count = pc[0];
+            arraySize = Bytecode::wide(pc + 1);
+            pc += 3;
+            sp -= count;
+            sp->ref = arrays.create((ValueType)ARG(), arraySize, sp, count);
+            if (sp->ref == UINT64_MAX) goto outOfMemory;
+            sp++;
+            NEXT();
+        }
+        CASE(ARRAY_CONST) {
+            arraySize = Bytecode::wide(pc + 2);
+            sp->ref = arrays.create((ValueType)ARG(), arraySize, constants + pc[0], pc[1]);
+            pc += 4;
+            if (sp->ref == UINT64_MAX) goto outOfMemory;
+            sp++;
+            NEXT();
+        }
+
+        CASE(WRITE_TEXT) { out.write(program.strings[ARG()]); NEXT(); }
+        CASE(WRITE_INT) { out.writeInt((--sp)->i); NEXT(); }
+        CASE(WRITE_FLOAT) { out.writeFloat((--sp)->f); NEXT(); }
+        CASE(WRITE_BOOL) { out.writeBool((--sp)->i); NEXT(); }
+        CASE(WRITE_STRING) { out.write(strings[(--sp)->ref]); NEXT(); }
+        CASE(WRITE_ARRAY) {
+            const ArrayObject& array = arrays[(--sp)->ref];
+            out.put('[');
+            for (uint64_t i = 0; i < array.size; i++) {
+                if (i > 0) out.write(", ");
+                writeElement(out, array.elementType, array.items[i], strings);
+            }
+            out.put(']');
+            NEXT();
+        }
+        CASE(WRITE_NEWLINE) { out.put('\n'); NEXT(); }
+
+        CASE(HALT) {
+            out.flush();
+            return true;
+        }
+
+        default:
+            break;
+    }
+
+    out.flush();
+    error.message = "Invalid opcode " + std::to_string(word & 0xFF);
+    error.offset = program.offsets[pc - 1 - code];
+    return false;
+
+divisionByZero:
+    out.flush();
+    error.message = "Division by zero";
+    error.offset = program.offsets[pc - 1 - code];
+    return false;
+
+// The instruction's extra words carry its offset too
+outOfMemory:
+    out.flush();
+    error.message = arrayAllocationError(arraySize);
+    error.offset = program.offsets[pc - 1 - code];
+    return false;
+
+#undef CASE
+#undef NEXT
+#undef ARG
+#undef BINARY_I
+#undef BINARY_F
+#undef COMPARE
+}
+
+} // namespace
+
+bool VirtualMachine::run(const Bytecode& program, RuntimeError& error, Dispatch dispatch) {
+    if (dispatch == Dispatch::THREADED) {
+        return execute<true>(program, error);
+    }
+    return execute<false>(program, error);
+}
+
+VirtualMachine::Dispatch VirtualMachine::defaultDispatch() {
+#ifdef AW_COMPUTED_GOTO
+    return Dispatch::THREADED;
+#else
+    return Dispatch::SWITCH;
+#endif
+}
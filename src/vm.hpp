@@ -0,0 +1,70 @@
+#pragma once
+#include "arena.hpp"
+#include "codegen.hpp"
+#include "output.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__)
+#define AW_COMPUTED_GOTO 1
+#endif
+
+struct RuntimeError {
+    std::string message;
+    uint32_t offset = 0;  // source byte offset of the failing instruction
+};
+
+// Array object on the VM heap. Items past the initializers start zeroed
+// (0, 0.0, false or string handle 0, the empty string).
+struct ArrayObject {
+    ValueType elementType;
+    uint64_t size;
+    Value* items;
+};
+
+// Arrays of one run, shared by the VM and the JIT. Items of arrays with at
+// least LAZY_ARRAY_ITEMS items are mapped pages the kernel zeroes on first
+// touch, so they are never cleared up front; smaller ones are carved out of
+// an arena. Initializers are copied in with one memcpy. Everything is
+// released with the heap.
+class ArrayHeap {
+private:
+    Arena arena;
+    std::vector<ArrayObject> arrays;
+    std::vector<std::pair<void*, size_t>> mappings;
+
+public:
+    ArrayHeap() = default;
+    ArrayHeap(const ArrayHeap&) = delete;
+    ArrayHeap& operator=(const ArrayHeap&) = delete;
+    ~ArrayHeap();
+
+    // Returns the new array's handle, or UINT64_MAX if there is no memory
+    // for it
+    uint64_t create(ValueType elementType, uint64_t size, const Value* initializers, uint32_t count);
+
+    const ArrayObject& operator[](uint64_t handle) const { return arrays[handle]; }
+};
+
+
+// Value printing shared by the VM and the JIT. Strings are handles into
+// `strings`.
+void writeElement(OutputBuffer& out, ValueType type, Value value, const std::vector<std::string>& strings);
+
+// Runs Bytecode on a value stack sized from Bytecode::maxStack. Two dispatch
+// loops are compiled from the same handlers: a plain switch, and threaded
+// dispatch where every handler jumps straight to the next one through a
+// table of label addresses (GCC/Clang computed goto). The threaded loop is
+// the default wherever the compiler supports it.
+class VirtualMachine {
+public:
+    enum class Dispatch {
+        SWITCH,
+        THREADED
+    };
+
+    // Returns false and fills `error` if the program stopped on a runtime error
+    static bool run(const Bytecode& program, RuntimeError& error, Dispatch dispatch = defaultDispatch());
+    static Dispatch defaultDispatch();
+};
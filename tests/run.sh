@@ -0,0 +1,42 @@
+#!/bin/sh
+# Checks the samples in this directory that come with expected output.
+#
+# For every <name>.expected next to a <name>.aw, the program is run with
+# `main.exe run` on the VM (threaded and switch dispatch), the JIT and at
+# -O0, and each time its stdout, stderr and exit status must match the
+# file exactly. For a <name>.awast AST image, `main.exe ast --dump` must
+# print the expected tree or error the same way.
+#
+# Usage: tests/run.sh [path/to/main.exe]
+
+EXE=$(cd "$(dirname "${1:-build/main.exe}")" && pwd)/$(basename "${1:-build/main.exe}")
+cd "$(dirname "$0")" || exit 1
+
+failed=0
+checked=0
+for expected in *.expected; do
+    name=${expected%.expected}
+    if [ -f "$name.awast" ]; then
+        actual=$("$EXE" ast --dump "$name.awast" 2>&1; echo "exit=$?")
+        checked=$((checked + 1))
+        if [ "$actual" != "$(cat "$expected")" ]; then
+            echo "FAIL $name.awast (ast --dump)"
+            printf '%s\n' "$actual" | diff "$expected" - | head -20
+            failed=$((failed + 1))
+        fi
+        continue
+    fi
+    [ -f "$name.aw" ] || continue
+    for mode in "" "--dispatch=switch" "--jit" "-O0"; do
+        actual=$("$EXE" run $mode "$name.aw" 2>&1; echo "exit=$?")
+        checked=$((checked + 1))
+        if [ "$actual" != "$(cat "$expected")" ]; then
+            echo "FAIL $name.aw (run $mode)"
+            printf '%s\n' "$actual" | diff "$expected" - | head -20
+            failed=$((failed + 1))
+        fi
+    done
+done
+
+echo "$checked checks, $failed failed"
+[ "$failed" -eq 0 ]